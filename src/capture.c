@@ -71,7 +71,15 @@ int main(int argc, char *argv[])
 		{ 0 , "reload",			"GLC_RELOAD_HOTKEY",		NULL},
 		{'n', "lock-fps",		"GLC_LOCK_FPS",			 "1"},
 		{ 0 , "pbo",			"GLC_TRY_PBO",			 "1"},
+		{ 0 , "pbo-depth",		"GLC_PBO_DEPTH",		NULL},
+		{ 0 , "gpu-convert",		"GLC_GPU_CONVERT",		 "1"},
+		{ 0 , "readback-thread",	"GLC_READBACK_THREAD",		 "1"},
+		{ 0 , "direct-convert",		"GLC_DIRECT_CONVERT",		 "1"},
+		{ 0 , "skip-duplicates",	"GLC_SKIP_DUPLICATES",		 "1"},
 		{'z', "compression",		"GLC_COMPRESS",			NULL},
+		{ 0 , "delta-keyframe",		"GLC_DELTA_KEYFRAME",		NULL},
+		{ 0 , "compress-chunks",	"GLC_COMPRESS_CHUNKS",		NULL},
+		{ 0 , "compress-latency",	"GLC_COMPRESS_LATENCY",		NULL},
 		{ 0 , "sync",			"GLC_SYNC",			 "1"},
 		{ 0 , "byte-aligned",		"GLC_CAPTURE_DWORD_ALIGNED",	 "0"},
 		{'i', "draw-indicator",		"GLC_INDICATOR",		 "1"},
@@ -86,6 +94,12 @@ int main(int argc, char *argv[])
 		{ 0 , "uncompressed",		"GLC_UNCOMPRESSED_BUFFER_SIZE",	NULL},
 		{ 0 , "unscaled",		"GLC_UNSCALED_BUFFER_SIZE",	NULL},
 		{'P', "rtprio",                 "GLC_RTPRIO",                   NULL},
+		{ 0 , "slice-threads",		"GLC_SLICE_THREADS",		NULL},
+		{ 0 , "affinity",		"GLC_AFFINITY",			NULL},
+		{ 0 , "sched",			"GLC_SCHED",			NULL},
+		{ 0 , "stats-interval",		"GLC_STATS_INTERVAL",		NULL},
+		{ 0 , "stats-socket",		"GLC_STATS_SOCKET",		NULL},
+		{ 0 , "trace",			"GLC_TRACE",			NULL},
 		{ 0 , "pipe",                   "GLC_PIPE",                     NULL},
 		{ 0 , "pipe_invert",            "GLC_PIPE_INVERT",               "1"},
 		{ 0 , "pipe_delay",		"GLC_PIPE_DELAY",		 "0"},
@@ -185,9 +199,23 @@ usage:
 	       "                               default reload key is '<Shift>F9'\n"
 	       "  -n, --lock-fps             lock fps when capturing\n"
 	       "      --pbo                  use GL_ARB_pixel_buffer_object if available\n"
+	       "      --pbo-depth=N          number of PBO transfers in flight, default is 3\n"
+	       "      --gpu-convert          convert to '420jpeg' and resize on the GPU\n"
+	       "      --readback-thread      collect PBO transfers in a separate thread\n"
+	       "      --direct-convert       convert to '420jpeg' while collecting frames\n"
+	       "      --skip-duplicates      send a repeat message for unchanged frames\n"
 	       "  -z, --compression=METHOD   compress stream using METHOD\n"
-	       "                               'none', 'quicklz' and 'lzo' are supported\n"
+	       "                               'none', 'quicklz', 'lzo', 'lzjb', 'lz4',\n"
+	       "                               'lz4hc[:LEVEL]' and 'zstd[:LEVEL[:long]]'\n"
+	       "                               are supported\n"
 	       "                               'quicklz' is used by default\n"
+	       "      --delta-keyframe=N     only compress changed tiles of video frames,\n"
+	       "                               sending a whole frame every N frames\n"
+	       "      --compress-chunks=N    compress big video frames in N chunks\n"
+	       "                               on N threads\n"
+	       "      --compress-latency=MS  use faster compression, down to none,\n"
+	       "                               when frames take longer than MS ms\n"
+	       "                               to get through compression\n"
 	       "      --sync                 force synchronized write mode\n"
 	       "      --byte-aligned         use GL_PACK_ALIGNMENT 1 instead of 8\n"
 	       "  -i, --draw-indicator       draw indicator when capturing\n"
@@ -213,6 +241,18 @@ usage:
 	       "      --unscaled=SIZE        unscaled picture stream buffer size in MiB,\n"
 	       "                               default is 25 MiB\n"
 	       "  -P, --rtprio               use rt priority for alsa threads\n"
+	       "      --slice-threads=N      split the rows of each frame across N threads\n"
+	       "                               when converting, default is 1\n"
+	       "      --affinity=SPEC        pin glc threads to cpus, per stage\n"
+	       "                               ie: pack:4-7,sink:3,audio:2\n"
+	       "      --sched=SPEC           scheduling policy per stage\n"
+	       "                               ie: pack:nice=5,audio:rr=10\n"
+	       "      --stats-interval=SEC   log stage timings every SEC seconds\n"
+	       "                               with --log=2, default is only at exit\n"
+	       "      --stats-socket=PATH    serve live statistics on a UNIX socket,\n"
+	       "                               read them with glc-stat\n"
+	       "      --trace=FILE           write a Chrome trace of every frame to FILE\n"
+	       "                               at exit\n"
 	       "      --pipe=rhs_cmd         pipe the video stream to an ext. app (ie: ffmpeg)\n"
 	       "                               The external program will be invoked with 4 args:\n"
 	       "                                 1. video_size (wxh)\n"
@@ -45,6 +45,7 @@
 #include <glc/common/log.h>
 #include <glc/common/state.h>
 #include <glc/common/util.h>
+#include <glc/common/trace.h>
 #include <glc/common/optimization.h>
 
 #include "alsa_capture.h"
@@ -135,6 +136,7 @@ int alsa_capture_init(alsa_capture_t *alsa_capture, glc_t *glc, alsa_real_api_t
 	(*alsa_capture)->interrupt_pipe[0] = -1;
 	(*alsa_capture)->interrupt_pipe[1] = -1;
 	(*alsa_capture)->thread.ask_rt = 1;
+	(*alsa_capture)->thread.name   = "audio";
 
 	return 0;
 }
@@ -582,6 +584,7 @@ int alsa_capture_read_pcm(alsa_capture_t alsa_capture, char *dma)
 int alsa_capture_process_pcm(alsa_capture_t alsa_capture, ps_packet_t *packet)
 {
 	snd_pcm_sframes_t avail;
+	glc_utime_t begin;
 	int ret = 0;
 	char *dma;
 	unsigned short revents;
@@ -606,6 +609,7 @@ int alsa_capture_process_pcm(alsa_capture_t alsa_capture, ps_packet_t *packet)
 		if (likely(alsa_capture->delay_nsec <= alsa_capture->hdr.time))
 			alsa_capture->hdr.time -= alsa_capture->delay_nsec;
 
+		begin = glc_trace_begin(alsa_capture->glc);
 		if (unlikely((ret = ps_packet_open(packet, PS_PACKET_WRITE))))
 			goto cancel;
 		if (unlikely((ret = ps_packet_write(packet, &alsa_capture->msg_hdr,
@@ -629,6 +633,8 @@ int alsa_capture_process_pcm(alsa_capture_t alsa_capture, ps_packet_t *packet)
 
 		if (unlikely((ret = ps_packet_close(packet))))
 			goto cancel;
+		glc_trace_end(alsa_capture->glc, "audio", begin, alsa_capture->hdr.time);
+		glc_trace_instant(alsa_capture->glc, "commit", alsa_capture->hdr.time);
 
 		/* just check for xrun */
 		return -alsa_capture_xrun(alsa_capture, alsa_capture_pcm_error(alsa_capture));
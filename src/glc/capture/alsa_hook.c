@@ -48,6 +48,8 @@
 #include <glc/common/log.h>
 #include <glc/common/state.h>
 #include <glc/common/util.h>
+#include <glc/common/trace.h>
+#include <glc/common/probe.h>
 #include <glc/common/optimization.h>
 
 #include "alsa_hook.h"
@@ -287,6 +289,7 @@ int alsa_hook_get_stream(alsa_hook_t alsa_hook, snd_pcm_t *pcm, struct alsa_hook
 
 		find->alsa_hook     = alsa_hook;
 		find->thread.ask_rt = 1;
+		find->thread.name   = "audio";
 		find->next          = alsa_hook->stream;
 		alsa_hook->stream = find;
 	}
@@ -305,6 +308,7 @@ void *alsa_hook_thread(void *argptr)
 	struct alsa_hook_stream_s *stream = (struct alsa_hook_stream_s *) argptr;
 	glc_audio_data_header_t hdr;
 	glc_message_header_t msg_hdr;
+	glc_utime_t begin;
 	int ret = 0;
 
 	msg_hdr.type = GLC_MESSAGE_AUDIO_DATA;
@@ -326,6 +330,7 @@ void *alsa_hook_thread(void *argptr)
 		hdr.time = stream->capture_time;
 		hdr.size = stream->capture_size;
 
+		begin = glc_trace_begin(stream->alsa_hook->glc);
 		if (unlikely((ret = ps_packet_open(&stream->packet, PS_PACKET_WRITE))))
 			break;
 		if (unlikely((ret = ps_packet_setsize(&stream->packet, hdr.size
@@ -343,6 +348,9 @@ void *alsa_hook_thread(void *argptr)
 			break;
 		if (unlikely((ret = ps_packet_close(&stream->packet))))
 			break;
+		glc_trace_end(stream->alsa_hook->glc, "audio", begin, hdr.time);
+		glc_trace_instant(stream->alsa_hook->glc, "commit", hdr.time);
+		GLC_PROBE3(audio_handoff, hdr.id, hdr.time, hdr.size);
 
 		if (!(stream->mode & SND_PCM_ASYNC))
 			sem_post(&stream->capture_empty);
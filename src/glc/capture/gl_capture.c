@@ -52,7 +52,11 @@
 #include <glc/common/state.h>
 #include <glc/common/util.h>
 #include <glc/common/rational.h>
+#include <glc/common/thread.h>
+#include <glc/common/trace.h>
+#include <glc/common/probe.h>
 #include <glc/common/optimization.h>
+#include <glc/core/ycbcr.h>
 
 #include "gl_capture.h"
 
@@ -63,43 +67,26 @@
 #define GL_CAPTURE_CROP            0x10
 #define GL_CAPTURE_LOCK_FPS        0x20
 #define GL_CAPTURE_IGNORE_TIME     0x40
+#define GL_CAPTURE_USE_SYNC        0x80
+#define GL_CAPTURE_TRY_CONVERT    0x100
+#define GL_CAPTURE_USE_CONVERT    0x200
+#define GL_CAPTURE_TRY_SCALE      0x400
+#define GL_CAPTURE_USE_SCALE      0x800
+#define GL_CAPTURE_TRY_THREAD    0x1000
+#define GL_CAPTURE_USE_THREAD    0x2000
+#define GL_CAPTURE_SKIP_DUPLICATES 0x4000
 
-/*
- * The next functions come from:
- * http://locklessinc.com/articles/locks/
- */
-
-/* Compile read-write barrier */
-#define barrier() asm volatile("": : :"memory")
-
-/* Pause instruction to prevent excess processor bus usage */
-#define cpu_relax() asm volatile("pause\n": : :"memory")
+/* upper bound for the number of PBO in flight per video stream */
+#define GL_CAPTURE_MAX_PBO            16
 
-static inline uint32_t xchg_32(volatile void *ptr, uint32_t x)
-{
-	__asm__ __volatile__("xchgl %0,%1"
-				:"=r" ((uint32_t) x)
-				:"m" (*(volatile uint32_t *)ptr), "0" (x)
-				:"memory");
-	return x;
-}
+/* window size is polled at this interval until a ConfigureNotify is seen */
+#define GL_CAPTURE_GEOMETRY_POLL      1000000000
 
-#define SPINBUSY 1
-typedef volatile uint32_t spinlock_t;
-
-static void spin_lock(spinlock_t *lock)
-{
-	do {
-		if (likely(!xchg_32(lock, SPINBUSY))) return;
-		while (*lock) cpu_relax();
-	} while(1);
-}
+/* per-swap cost histogram, bucket n holds [2^n, 2^(n+1)) nsec */
+#define GL_CAPTURE_COST_BUCKETS       32
 
-static void spin_unlock(spinlock_t *lock)
-{
-	barrier();
-	*lock = 0;
-}
+/* buckets in the (dpy, drawable) stream lookup table, power of 2 */
+#define GL_CAPTURE_VIDEO_HASH         64
 
 typedef void (*FuncPtr)(void);
 typedef FuncPtr (*GLXGetProcAddressProc)(const GLubyte *procName);
@@ -116,6 +103,132 @@ typedef void (*glBindBufferProc)(GLenum target,
 typedef GLvoid *(*glMapBufferProc)(GLenum target,
                                    GLenum access);
 typedef GLboolean (*glUnmapBufferProc)(GLenum target);
+typedef GLsync (*glFenceSyncProc)(GLenum condition,
+                                  GLbitfield flags);
+typedef GLenum (*glClientWaitSyncProc)(GLsync sync,
+                                       GLbitfield flags,
+                                       GLuint64 timeout);
+typedef void (*glDeleteSyncProc)(GLsync sync);
+typedef GLuint (*glCreateShaderProc)(GLenum type);
+typedef void (*glShaderSourceProc)(GLuint shader,
+                                   GLsizei count,
+                                   const GLchar **string,
+                                   const GLint *length);
+typedef void (*glCompileShaderProc)(GLuint shader);
+typedef void (*glGetShaderivProc)(GLuint shader,
+                                  GLenum pname,
+                                  GLint *params);
+typedef void (*glDeleteShaderProc)(GLuint shader);
+typedef GLuint (*glCreateProgramProc)(void);
+typedef void (*glAttachShaderProc)(GLuint program,
+                                   GLuint shader);
+typedef void (*glLinkProgramProc)(GLuint program);
+typedef void (*glGetProgramivProc)(GLuint program,
+                                   GLenum pname,
+                                   GLint *params);
+typedef void (*glUseProgramProc)(GLuint program);
+typedef void (*glDeleteProgramProc)(GLuint program);
+typedef GLint (*glGetUniformLocationProc)(GLuint program,
+                                          const GLchar *name);
+typedef void (*glUniform1iProc)(GLint location,
+                                GLint v0);
+typedef void (*glActiveTextureProc)(GLenum texture);
+typedef void (*glGenFramebuffersProc)(GLsizei n,
+                                      GLuint *framebuffers);
+typedef void (*glDeleteFramebuffersProc)(GLsizei n,
+                                         const GLuint *framebuffers);
+typedef void (*glBindFramebufferProc)(GLenum target,
+                                      GLuint framebuffer);
+typedef void (*glFramebufferTexture2DProc)(GLenum target,
+                                           GLenum attachment,
+                                           GLenum textarget,
+                                           GLuint texture,
+                                           GLint level);
+typedef GLenum (*glCheckFramebufferStatusProc)(GLenum target);
+typedef void (*glBlitFramebufferProc)(GLint srcX0, GLint srcY0,
+                                      GLint srcX1, GLint srcY1,
+                                      GLint dstX0, GLint dstY0,
+                                      GLint dstX1, GLint dstY1,
+                                      GLbitfield mask, GLenum filter);
+
+/*
+ * GPU side Y'CbCr conversion. The quad is drawn upside down so that
+ * the planes come out of glReadPixels() top row first, like the
+ * output of ycbcr_bgr_to_jpeg420(). Coefficients are the ones used
+ * by ycbcr.c so that both paths produce the same stream.
+ */
+static const GLchar *gl_capture_convert_vertex =
+	"varying vec2 tc;\n"
+	"void main()\n"
+	"{\n"
+	"	tc = gl_MultiTexCoord0.xy;\n"
+	"	gl_Position = gl_Vertex;\n"
+	"}\n";
+
+static const GLchar *gl_capture_convert_y =
+	"uniform sampler2D src;\n"
+	"varying vec2 tc;\n"
+	"void main()\n"
+	"{\n"
+	"	vec3 c = texture2D(src, tc).rgb;\n"
+	"	float y = dot(c, vec3(306.0, 601.0, 117.0) / 1024.0);\n"
+	"	gl_FragColor = vec4(y, 0.0, 0.0, 1.0);\n"
+	"}\n";
+
+/* sampled at the center of each 2x2 block, linear filter does the average */
+static const GLchar *gl_capture_convert_cbcr =
+	"uniform sampler2D src;\n"
+	"varying vec2 tc;\n"
+	"void main()\n"
+	"{\n"
+	"	vec3 c = texture2D(src, tc).rgb;\n"
+	"	float cb = 128.0 / 255.0 - dot(c, vec3(173.0, 339.0, -512.0) / 1024.0);\n"
+	"	float cr = 128.0 / 255.0 + dot(c, vec3(512.0, -429.0, -83.0) / 1024.0);\n"
+	"	gl_FragColor = vec4(cb, cr, 0.0, 1.0);\n"
+	"}\n";
+
+/* one in-flight asynchronous readback */
+struct gl_capture_pbo_s {
+	GLuint pbo;
+	GLsync fence;
+	glc_utime_t time;
+};
+
+/*
+ * Readback thread. It owns a GLX context sharing objects with the
+ * application context, waits on the PBO fences and writes the frames
+ * so that the swap only pays for starting the transfer. The context
+ * lives on a private X connection, so the application Display is never
+ * used from the thread and XInitThreads() is not needed.
+ */
+struct gl_capture_readback_s {
+	gl_capture_t gl_capture;
+	glc_simple_thread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;	/* signaled when a PBO is queued or freed */
+
+	Display *dpy;		/* private connection */
+	GLXContext ctx;
+	GLXPbuffer pbuffer;
+	ps_packet_t packet;
+	int ready;		/* 1 once the context is current, -1 on failure */
+	int quit;
+};
+
+/*
+ * Read state of an application context, kept up to date from the calls
+ * the hook sees, so readbacks don't have to query it.
+ */
+struct gl_capture_context_s {
+	GLXContext ctx;
+	GLuint read_framebuffer;	/* bound by the application */
+	GLint read_buffer;		/* of the default framebuffer, 0 until known */
+
+	struct gl_capture_context_s *next;
+};
+
+/* context current in this thread, NULL when not tracked */
+static __thread struct gl_capture_context_s *gl_capture_current_context = NULL;
 
 struct gl_capture_video_stream_s {
 	glc_state_video_t state_video;
@@ -127,11 +240,29 @@ struct gl_capture_video_stream_s {
 	int screen;
 	GLXDrawable drawable;
 	Window attribWin;
+
+	/* last size reported by gl_capture_resize_window(), width << 32 | height */
+	volatile uint64_t window_geometry;
+	glc_utime_t geometry_polled;
+
+	/* application read buffer, put back after each readback */
+	GLint read_buffer;
 	ps_packet_t packet;
-	glc_utime_t last, pbo_time;
+	glc_utime_t last;
 
 	unsigned int w, h;
 	unsigned int cw, ch, row, cx, cy;
+	unsigned int ow, oh;	/* size of the frames written to the stream */
+	size_t size;		/* frame size in bytes */
+
+	/* frames read back as BGR(A) are converted by ycbcr on the way out */
+	int cpu_convert;
+	size_t frame_size;	/* converted frame size */
+	char *scratch;		/* readback area when PBO are not used */
+	size_t scratch_size;
+
+	/* hash of the last frame written, 0 when there is none */
+	uint64_t last_hash;
 
 	float brightness, contrast;
 	float gamma_red, gamma_green, gamma_blue;
@@ -139,22 +270,56 @@ struct gl_capture_video_stream_s {
 	int indicator_list;
 
 	struct gl_capture_video_stream_s *next;
+	struct gl_capture_video_stream_s *hash_next;
 
-	GLuint pbo;
-	int pbo_active;
+	/*
+	 * PBO ring. Transfers are started at pbo_head and collected
+	 * in order from pbo_tail once their fence has signaled.
+	 */
+	struct gl_capture_pbo_s pbo[GL_CAPTURE_MAX_PBO];
+	unsigned int pbo_head, pbo_tail;
+	volatile unsigned int pbo_pending;
+	int pbo_created;
+
+	/* PBO are collected by this thread when set */
+	struct gl_capture_readback_s *readback;
+	int readback_failed;
+
+	/* GPU colorspace conversion objects */
+	GLuint src_tex, y_tex, c_tex;
+	GLuint src_fbo, y_fbo, c_fbo;
+	GLuint y_program, c_program;
+	int convert_created;
+	int use_convert;	/* cleared if the shaders fail for this stream */
+
+	/* GPU scaling target when frames are read back as BGR(A) */
+	GLuint scale_tex, scale_fbo;
+	int use_scale;		/* cleared if the FBO fails for this stream */
 
 	/* stats related vars */
 	unsigned num_frames;
+	unsigned num_frames_started;
 	unsigned num_captured_frames;
+	unsigned num_repeated_frames;
+	glc_utime_t first_frame;
 	uint64_t capture_time_ns;
 	int      gather_stats;
+	unsigned swap_cost[GL_CAPTURE_COST_BUCKETS];
 };
 
 struct gl_capture_s {
 	glc_t *glc;
-	spinlock_t capture_spinlock;
 	glc_flags_t flags;
 
+	/*
+	 * gl_capture_frame() calls in progress. gl_capture_stop() waits
+	 * on quiesce_cond for this to drop to zero.
+	 */
+	volatile unsigned int active_frames;
+	volatile int stopping;
+	pthread_mutex_t quiesce_mutex;
+	pthread_cond_t quiesce_cond;
+
 	GLenum capture_buffer;   /* GL_FRONT or GL_BACK */
 	glc_utime_t fps_period;  /* time in ns between 2 frames */
 
@@ -166,14 +331,19 @@ struct gl_capture_s {
 	unsigned fps_rem_period; /* period in frames which fps_rem is applied */
 
 	struct gl_capture_video_stream_s *video;
+	struct gl_capture_video_stream_s *video_hash[GL_CAPTURE_VIDEO_HASH];
 
 	ps_buffer_t *to;
 
 	pthread_mutex_t mutex;
+	struct gl_capture_context_s *context; /* protected by mutex */
 
 	unsigned int bpp;
 	GLenum format;
 	GLint pack_alignment;
+	unsigned int pbo_depth;
+	double scale;
+	ycbcr_t ycbcr;
 
 	unsigned int crop_x, crop_y;
 	unsigned int crop_w, crop_h;
@@ -186,6 +356,30 @@ struct gl_capture_s {
 	glBindBufferProc      glBindBuffer;
 	glMapBufferProc       glMapBuffer;
 	glUnmapBufferProc     glUnmapBuffer;
+	glFenceSyncProc       glFenceSync;
+	glClientWaitSyncProc  glClientWaitSync;
+	glDeleteSyncProc      glDeleteSync;
+
+	glCreateShaderProc           glCreateShader;
+	glShaderSourceProc           glShaderSource;
+	glCompileShaderProc          glCompileShader;
+	glGetShaderivProc            glGetShaderiv;
+	glDeleteShaderProc           glDeleteShader;
+	glCreateProgramProc          glCreateProgram;
+	glAttachShaderProc           glAttachShader;
+	glLinkProgramProc            glLinkProgram;
+	glGetProgramivProc           glGetProgramiv;
+	glUseProgramProc             glUseProgram;
+	glDeleteProgramProc          glDeleteProgram;
+	glGetUniformLocationProc     glGetUniformLocation;
+	glUniform1iProc              glUniform1i;
+	glActiveTextureProc          glActiveTexture;
+	glGenFramebuffersProc        glGenFramebuffers;
+	glDeleteFramebuffersProc     glDeleteFramebuffers;
+	glBindFramebufferProc        glBindFramebuffer;
+	glFramebufferTexture2DProc   glFramebufferTexture2D;
+	glCheckFramebufferStatusProc glCheckFramebufferStatus;
+	glBlitFramebufferProc        glBlitFramebuffer;
 };
 
 static int gl_capture_get_video_stream(gl_capture_t gl_capture,
@@ -197,8 +391,11 @@ static int gl_capture_write_video_format_message(gl_capture_t gl_capture,
 				struct gl_capture_video_stream_s *video,
 				unsigned int w, unsigned int h);
 static int gl_capture_update_video_stream(gl_capture_t gl_capture,
-				   struct gl_capture_video_stream_s *video);
+				   struct gl_capture_video_stream_s *video,
+				   glc_utime_t now);
 static int gl_capture_clear_video_streams(gl_capture_t gl_capture);
+static inline int gl_capture_enter_frame(gl_capture_t gl_capture);
+static void gl_capture_leave_frame(gl_capture_t gl_capture);
 
 static void gl_capture_error(gl_capture_t gl_capture, int err);
 
@@ -213,20 +410,76 @@ static int gl_capture_update_color(gl_capture_t gl_capture,
 				struct gl_capture_video_stream_s *video,
 				ps_packet_t *packet);
 
+static void gl_capture_save_pixel_state(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video);
+static void gl_capture_restore_pixel_state(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video);
 static int gl_capture_get_pixels(gl_capture_t gl_capture,
 				struct gl_capture_video_stream_s *video, char *to);
+static int gl_capture_read_pixels(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video, char *to);
 static int gl_capture_gen_indicator_list(gl_capture_t gl_capture,
 				struct gl_capture_video_stream_s *video);
 
+static int gl_capture_init_libgl(gl_capture_t gl_capture);
 static int gl_capture_init_pbo(gl_capture_t gl);
+static int gl_capture_init_sync(gl_capture_t gl_capture);
 static int gl_capture_create_pbo(gl_capture_t gl_capture,
 				struct gl_capture_video_stream_s *video);
 static int gl_capture_destroy_pbo(gl_capture_t gl_capture,
 				struct gl_capture_video_stream_s *video);
+static void gl_capture_discard_pbo(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video);
 static int gl_capture_start_pbo(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video,
+				glc_utime_t now);
+static int gl_capture_pbo_ready(gl_capture_t gl_capture,
 				struct gl_capture_video_stream_s *video);
 static int gl_capture_read_pbo(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video,
+				ps_packet_t *packet, glc_utime_t now, int try);
+static int gl_capture_flush_pbo(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video,
+				glc_utime_t now, int wait);
+
+static uint64_t gl_capture_hash_frame(const void *data, size_t size);
+static int gl_capture_is_repeat(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video,
+				const char *frame);
+static int gl_capture_write_repeat(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video,
+				ps_packet_t *packet, glc_utime_t time, int try);
+
+static int gl_capture_create_readback(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video);
+static int gl_capture_destroy_readback(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video);
+static void gl_capture_wait_readback(struct gl_capture_video_stream_s *video,
+				unsigned int pending);
+static void gl_capture_free_readback(struct gl_capture_readback_s *readback);
+static void *gl_capture_readback_loop(void *argptr);
+
+static void gl_capture_account_swap(struct gl_capture_video_stream_s *video,
+				glc_utime_t cost);
+static void gl_capture_print_swap_cost(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video);
+
+static int gl_capture_init_fbo(gl_capture_t gl_capture);
+static int gl_capture_init_convert(gl_capture_t gl_capture);
+static int gl_capture_create_scale(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video);
+static int gl_capture_destroy_scale(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video);
+static int gl_capture_scale_pixels(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video, char *to);
+static int gl_capture_create_program(gl_capture_t gl_capture,
+				const GLchar *fragment, GLuint *program);
+static int gl_capture_create_convert(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video);
+static int gl_capture_destroy_convert(gl_capture_t gl_capture,
 				struct gl_capture_video_stream_s *video);
+static int gl_capture_convert_pixels(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video, char *to);
 
 int gl_capture_init(gl_capture_t *gl_capture, glc_t *glc)
 {
@@ -240,8 +493,12 @@ int gl_capture_init(gl_capture_t *gl_capture, glc_t *glc)
 	(*gl_capture)->format = GL_BGRA;		/* capture as BGRA data by default */
 	(*gl_capture)->bpp = 4;				/* since we use BGRA */
 	(*gl_capture)->capture_buffer = GL_FRONT;	/* front buffer is default */
+	(*gl_capture)->pbo_depth = 3;			/* PBO transfers in flight */
+	(*gl_capture)->scale = 1.0;			/* no GPU scaling */
 
 	pthread_mutex_init(&(*gl_capture)->mutex, NULL);
+	pthread_mutex_init(&(*gl_capture)->quiesce_mutex, NULL);
+	pthread_cond_init(&(*gl_capture)->quiesce_cond, NULL);
 
 	return 0;
 }
@@ -330,6 +587,111 @@ int gl_capture_try_pbo(gl_capture_t gl_capture, int try_pbo)
 	return 0;
 }
 
+int gl_capture_set_pbo_depth(gl_capture_t gl_capture, unsigned int depth)
+{
+	if (unlikely((depth < 1) || (depth > GL_CAPTURE_MAX_PBO))) {
+		glc_log(gl_capture->glc, GLC_ERROR, "gl_capture",
+			 "invalid PBO depth %u (1-%d)", depth, GL_CAPTURE_MAX_PBO);
+		return EINVAL;
+	}
+
+	if (unlikely(gl_capture->flags & GL_CAPTURE_USE_PBO)) {
+		glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
+			 "can't change PBO depth; PBO is in use");
+		return EAGAIN;
+	}
+
+	glc_log(gl_capture->glc, GLC_INFO, "gl_capture",
+		 "using up to %u PBO transfers in flight", depth);
+	gl_capture->pbo_depth = depth;
+	return 0;
+}
+
+int gl_capture_convert_ycbcr(gl_capture_t gl_capture, int convert)
+{
+	if (convert) {
+		gl_capture->flags |= GL_CAPTURE_TRY_CONVERT;
+	} else {
+		if (unlikely(gl_capture->flags & GL_CAPTURE_USE_CONVERT)) {
+			glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
+				 "can't disable GPU conversion; it is in use");
+			return EAGAIN;
+		}
+
+		gl_capture->flags &= ~GL_CAPTURE_TRY_CONVERT;
+	}
+
+	return 0;
+}
+
+int gl_capture_set_scale(gl_capture_t gl_capture, double scale)
+{
+	if (unlikely((scale <= 0.0) || (scale > 1.0))) {
+		glc_log(gl_capture->glc, GLC_ERROR, "gl_capture",
+			 "invalid scale factor %f", scale);
+		return EINVAL;
+	}
+
+	if (unlikely(gl_capture->flags & GL_CAPTURE_USE_SCALE)) {
+		glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
+			 "can't change scale factor; GPU scaling is in use");
+		return EAGAIN;
+	}
+
+	gl_capture->scale = scale;
+	if (scale == 1.0)
+		gl_capture->flags &= ~GL_CAPTURE_TRY_SCALE;
+	else
+		gl_capture->flags |= GL_CAPTURE_TRY_SCALE;
+
+	return 0;
+}
+
+int gl_capture_set_ycbcr(gl_capture_t gl_capture, ycbcr_t ycbcr)
+{
+	if (unlikely(gl_capture->flags & GL_CAPTURE_CAPTURING)) {
+		glc_log(gl_capture->glc, GLC_ERROR, "gl_capture",
+			 "ycbcr can't be changed while capturing");
+		return EAGAIN;
+	}
+
+	gl_capture->ycbcr = ycbcr;
+	return 0;
+}
+
+int gl_capture_readback_thread(gl_capture_t gl_capture, int thread)
+{
+	if (thread) {
+		gl_capture->flags |= GL_CAPTURE_TRY_THREAD;
+	} else {
+		if (unlikely(gl_capture->flags & GL_CAPTURE_USE_THREAD)) {
+			glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
+				 "can't disable readback thread; it is in use");
+			return EAGAIN;
+		}
+
+		gl_capture->flags &= ~GL_CAPTURE_TRY_THREAD;
+	}
+
+	return 0;
+}
+
+int gl_capture_skip_duplicates(gl_capture_t gl_capture, int skip)
+{
+	if (unlikely(gl_capture->flags & GL_CAPTURE_CAPTURING)) {
+		glc_log(gl_capture->glc, GLC_ERROR, "gl_capture",
+			 "duplicate skipping can't be changed while capturing");
+		return EAGAIN;
+	}
+
+	if (skip)
+		gl_capture->flags |= GL_CAPTURE_SKIP_DUPLICATES;
+	else
+		gl_capture->flags &= ~GL_CAPTURE_SKIP_DUPLICATES;
+
+	return 0;
+}
+
 int gl_capture_set_pixel_format(gl_capture_t gl_capture, GLenum format)
 {
 	if (format == GL_BGRA) {
@@ -422,12 +784,12 @@ int gl_capture_start(gl_capture_t gl_capture)
 int gl_capture_stop(gl_capture_t gl_capture)
 {
 	if (gl_capture->flags & GL_CAPTURE_CAPTURING) {
-		spin_lock(&gl_capture->capture_spinlock);
-		gl_capture->flags &= ~GL_CAPTURE_CAPTURING;
-		spin_unlock(&gl_capture->capture_spinlock);
+		gl_capture->stopping = 1;
+		__sync_and_and_fetch(&gl_capture->flags, ~GL_CAPTURE_CAPTURING);
 		glc_log(gl_capture->glc, GLC_INFO, "gl_capture",
 			 "stopping capturing");
 		gl_capture_clear_video_streams(gl_capture);
+		gl_capture->stopping = 0;
 	} else
 		glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
 			 "capturing is already stopped");
@@ -458,22 +820,47 @@ int gl_capture_destroy(gl_capture_t gl_capture)
 		del = gl_capture->video;
 		gl_capture->video = gl_capture->video->next;
 
+		/* remaining frames are written before the thread exits */
+		if (del->readback)
+			gl_capture_destroy_readback(gl_capture, del);
+
 		glc_log(gl_capture->glc, GLC_PERF, "gl_capture",
 			"captured %u frames in %" PRIu64 " nsec",
 			del->num_captured_frames, del->capture_time_ns);
+		if (del->num_repeated_frames)
+			glc_log(gl_capture->glc, GLC_PERF, "gl_capture",
+				"%u frames were repeats of the previous one",
+				del->num_repeated_frames);
+		if (del->gather_stats)
+			gl_capture_print_swap_cost(gl_capture, del);
 
 		/* we might be in wrong thread */
 		if (del->indicator_list)
 			glDeleteLists(del->indicator_list, 1);
 
-		if (del->pbo)
+		if (del->pbo_created)
 			gl_capture_destroy_pbo(gl_capture, del);
 
+		if (del->convert_created)
+			gl_capture_destroy_convert(gl_capture, del);
+
+		if (del->scale_fbo)
+			gl_capture_destroy_scale(gl_capture, del);
+
+		free(del->scratch);
 		ps_packet_destroy(&del->packet);
 		free(del);
 	}
 
+	while (gl_capture->context != NULL) {
+		struct gl_capture_context_s *context = gl_capture->context;
+		gl_capture->context = context->next;
+		free(context);
+	}
+
 	pthread_mutex_destroy(&gl_capture->mutex);
+	pthread_cond_destroy(&gl_capture->quiesce_cond);
+	pthread_mutex_destroy(&gl_capture->quiesce_mutex);
 
 	if (gl_capture->libGL_handle)
 		dlclose(gl_capture->libGL_handle);
@@ -543,27 +930,99 @@ int gl_capture_calc_geometry(gl_capture_t gl_capture,
 		 "calculated capture area for video %d is %ux%u+%u+%u",
 		 video->id, video->cw, video->ch, video->cx, video->cy);
 
-	video->row = video->cw * gl_capture->bpp;
-	if (unlikely(video->row % gl_capture->pack_alignment != 0))
-		video->row += gl_capture->pack_alignment -
-			      video->row % gl_capture->pack_alignment;
+	if (video->use_scale) {
+		video->ow = video->cw * gl_capture->scale;
+		video->oh = video->ch * gl_capture->scale;
+	} else {
+		video->ow = video->cw;
+		video->oh = video->ch;
+	}
+
+	if (video->use_convert) {
+		/* same rounding as ycbcr, the last odd row/column is dropped */
+		video->ow -= video->ow % 2;
+		video->oh -= video->oh % 2;
+		video->size = video->ow * video->oh +
+			      2 * ((video->ow / 2) * (video->oh / 2));
+	} else {
+		video->row = video->ow * gl_capture->bpp;
+		if (unlikely(video->row % gl_capture->pack_alignment != 0))
+			video->row += gl_capture->pack_alignment -
+				      video->row % gl_capture->pack_alignment;
+		video->size = video->row * video->oh;
+	}
 	return 0;
 }
 
+/*
+ * Pixel store state, including the GL_PIXEL_PACK_BUFFER binding since
+ * OpenGL 2.1, lives on the client attribute stack which never reaches
+ * the server. The read buffer comes from the state tracked for the
+ * current context. GL_READ_BUFFER is only queried the first time a
+ * context is captured, or while the application has its own read
+ * framebuffer bound.
+ */
+void gl_capture_save_pixel_state(gl_capture_t gl_capture,
+				 struct gl_capture_video_stream_s *video)
+{
+	struct gl_capture_context_s *context = gl_capture_current_context;
+
+	glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+
+	if (likely((context) && (!context->read_framebuffer) &&
+		   (context->read_buffer))) {
+		video->read_buffer = context->read_buffer;
+		return;
+	}
+
+	glGetIntegerv(GL_READ_BUFFER, &video->read_buffer);
+	if ((context) && (!context->read_framebuffer))
+		context->read_buffer = video->read_buffer;
+}
+
+void gl_capture_restore_pixel_state(gl_capture_t gl_capture,
+				    struct gl_capture_video_stream_s *video)
+{
+	struct gl_capture_context_s *context = gl_capture_current_context;
+
+	glPopClientAttrib();
+	if ((GLenum) video->read_buffer != gl_capture->capture_buffer)
+		glReadBuffer(video->read_buffer);
+
+	/* our own glReadBuffer() calls went through the hook as well */
+	if ((context) && (!context->read_framebuffer))
+		context->read_buffer = video->read_buffer;
+}
+
 int gl_capture_get_pixels(gl_capture_t gl_capture,
 			  struct gl_capture_video_stream_s *video, char *to)
 {
-	glPushAttrib(GL_PIXEL_MODE_BIT);
-	glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+	int ret;
+
+	gl_capture_save_pixel_state(gl_capture, video);
+	ret = gl_capture_read_pixels(gl_capture, video, to);
+	gl_capture_restore_pixel_state(gl_capture, video);
+
+	return ret;
+}
+
+/*
+ * to is either client memory or an offset into the bound PBO.
+ * Pixel state must be saved by the caller.
+ */
+int gl_capture_read_pixels(gl_capture_t gl_capture,
+			   struct gl_capture_video_stream_s *video, char *to)
+{
+	if (video->use_convert)
+		return gl_capture_convert_pixels(gl_capture, video, to);
+	else if (video->use_scale)
+		return gl_capture_scale_pixels(gl_capture, video, to);
 
 	glReadBuffer(gl_capture->capture_buffer);
 	glPixelStorei(GL_PACK_ALIGNMENT, gl_capture->pack_alignment);
 	glReadPixels(video->cx, video->cy, video->cw, video->ch,
 		gl_capture->format, GL_UNSIGNED_BYTE, to);
 
-	glPopClientAttrib();
-	glPopAttrib();
-
 	return 0;
 }
 
@@ -598,6 +1057,24 @@ int gl_capture_gen_indicator_list(gl_capture_t gl_capture,
 	return 0;
 }
 
+int gl_capture_init_libgl(gl_capture_t gl_capture)
+{
+	if (gl_capture->glXGetProcAddress)
+		return 0;
+
+	if (!gl_capture->libGL_handle)
+		gl_capture->libGL_handle = dlopen("libGL.so.1", RTLD_LAZY);
+	if (unlikely(!gl_capture->libGL_handle))
+		return ENOTSUP;
+	gl_capture->glXGetProcAddress =
+		(GLXGetProcAddressProc)
+		dlsym(gl_capture->libGL_handle, "glXGetProcAddressARB");
+	if (unlikely(!gl_capture->glXGetProcAddress))
+		return ENOTSUP;
+
+	return 0;
+}
+
 int gl_capture_init_pbo(gl_capture_t gl_capture)
 {
 	const char *gl_extensions = (const char *) glGetString(GL_EXTENSIONS);
@@ -608,13 +1085,7 @@ int gl_capture_init_pbo(gl_capture_t gl_capture)
 	if (unlikely(!strstr(gl_extensions, "GL_ARB_pixel_buffer_object")))
 		return ENOTSUP;
 
-	gl_capture->libGL_handle = dlopen("libGL.so.1", RTLD_LAZY);
-	if (unlikely(!gl_capture->libGL_handle))
-		return ENOTSUP;
-	gl_capture->glXGetProcAddress =
-		(GLXGetProcAddressProc)
-		dlsym(gl_capture->libGL_handle, "glXGetProcAddressARB");
-	if (unlikely(!gl_capture->glXGetProcAddress))
+	if (unlikely(gl_capture_init_libgl(gl_capture)))
 		return ENOTSUP;
 	gl_capture->glGenBuffers =
 		(glGenBuffersProc)
@@ -650,6 +1121,41 @@ int gl_capture_init_pbo(gl_capture_t gl_capture)
 	glc_log(gl_capture->glc, GLC_INFO, "gl_capture",
 		 "using GL_ARB_pixel_buffer_object");
 
+	if (!gl_capture_init_sync(gl_capture))
+		gl_capture->flags |= GL_CAPTURE_USE_SYNC;
+	else
+		glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
+			 "GL_ARB_sync not available, PBO reads may block");
+
+	return 0;
+}
+
+int gl_capture_init_sync(gl_capture_t gl_capture)
+{
+	const char *gl_extensions = (const char *) glGetString(GL_EXTENSIONS);
+
+	if (unlikely(!strstr(gl_extensions, "GL_ARB_sync")))
+		return ENOTSUP;
+
+	gl_capture->glFenceSync =
+		(glFenceSyncProc)
+		gl_capture->glXGetProcAddress((const GLubyte *) "glFenceSync");
+	if (unlikely(!gl_capture->glFenceSync))
+		return ENOTSUP;
+	gl_capture->glClientWaitSync =
+		(glClientWaitSyncProc)
+		gl_capture->glXGetProcAddress((const GLubyte *) "glClientWaitSync");
+	if (unlikely(!gl_capture->glClientWaitSync))
+		return ENOTSUP;
+	gl_capture->glDeleteSync =
+		(glDeleteSyncProc)
+		gl_capture->glXGetProcAddress((const GLubyte *) "glDeleteSync");
+	if (unlikely(!gl_capture->glDeleteSync))
+		return ENOTSUP;
+
+	glc_log(gl_capture->glc, GLC_INFO, "gl_capture",
+		 "using GL_ARB_sync");
+
 	return 0;
 }
 
@@ -657,122 +1163,1062 @@ int gl_capture_create_pbo(gl_capture_t gl_capture,
 			  struct gl_capture_video_stream_s *video)
 {
 	GLint binding;
+	unsigned int i;
 
-	glc_log(gl_capture->glc, GLC_DEBUG, "gl_capture", "creating PBO");
+	glc_log(gl_capture->glc, GLC_DEBUG, "gl_capture", "creating %u PBO",
+		 gl_capture->pbo_depth);
 
 	glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING_ARB, &binding);
 	glPushAttrib(GL_ALL_ATTRIB_BITS);
 
-	gl_capture->glGenBuffers(1, &video->pbo);
-	gl_capture->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, video->pbo);
-	gl_capture->glBufferData(GL_PIXEL_PACK_BUFFER_ARB, video->row * video->ch,
-				NULL, GL_STREAM_READ);
+	for (i = 0; i < gl_capture->pbo_depth; i++) {
+		gl_capture->glGenBuffers(1, &video->pbo[i].pbo);
+		gl_capture->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, video->pbo[i].pbo);
+		gl_capture->glBufferData(GL_PIXEL_PACK_BUFFER_ARB, video->size,
+					NULL, GL_STREAM_READ);
+	}
 
 	glPopAttrib();
 	gl_capture->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, binding);
+
+	video->pbo_head = video->pbo_tail = video->pbo_pending = 0;
+	video->pbo_created = 1;
 	return 0;
 }
 
 int gl_capture_destroy_pbo(gl_capture_t gl_capture,
 			   struct gl_capture_video_stream_s *video)
 {
+	unsigned int i;
+
 	glc_log(gl_capture->glc, GLC_DEBUG, "gl_capture", "destroying PBO");
-	gl_capture->glDeleteBuffers(1, &video->pbo);
+	gl_capture_discard_pbo(gl_capture, video);
+
+	for (i = 0; i < gl_capture->pbo_depth; i++)
+		gl_capture->glDeleteBuffers(1, &video->pbo[i].pbo);
+	video->pbo_created = 0;
 	return 0;
 }
 
-int gl_capture_start_pbo(gl_capture_t gl_capture, struct gl_capture_video_stream_s *video)
+/* forget every transfer in flight, ie: when the geometry changes */
+void gl_capture_discard_pbo(gl_capture_t gl_capture,
+			    struct gl_capture_video_stream_s *video)
 {
-	GLint binding;
-
-	glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING_ARB, &binding);
-	glPushAttrib(GL_PIXEL_MODE_BIT);
-	glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
-
-	gl_capture->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, video->pbo);
+	struct gl_capture_pbo_s *slot;
 
-	glReadBuffer(gl_capture->capture_buffer);
-	glPixelStorei(GL_PACK_ALIGNMENT, gl_capture->pack_alignment);
-	/* to = ((char *)NULL + (offset)) */
-	glReadPixels(video->cx, video->cy, video->cw, video->ch,
-		gl_capture->format, GL_UNSIGNED_BYTE, NULL);
+	if (video->pbo_pending)
+		glc_log(gl_capture->glc, GLC_DEBUG, "gl_capture",
+			 "discarding %u pending PBO transfers", video->pbo_pending);
 
-	glPopClientAttrib();
-	glPopAttrib();
-	gl_capture->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, binding);
-	return 0;
+	while (video->pbo_pending) {
+		slot = &video->pbo[video->pbo_tail];
+		if (slot->fence) {
+			gl_capture->glDeleteSync(slot->fence);
+			slot->fence = NULL;
+		}
+		video->pbo_tail = (video->pbo_tail + 1) % gl_capture->pbo_depth;
+		video->pbo_pending--;
+	}
+	video->pbo_head = video->pbo_tail = 0;
 }
 
-int gl_capture_read_pbo(gl_capture_t gl_capture, struct gl_capture_video_stream_s *video)
+int gl_capture_start_pbo(gl_capture_t gl_capture,
+			 struct gl_capture_video_stream_s *video,
+			 glc_utime_t now)
 {
-	GLvoid *buf;
-	GLint binding;
+	struct gl_capture_pbo_s *slot = &video->pbo[video->pbo_head];
+	glc_utime_t begin = glc_trace_begin(gl_capture->glc);
 
-	glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING_ARB, &binding);
+	gl_capture_save_pixel_state(gl_capture, video);
+	gl_capture->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, slot->pbo);
 
-	gl_capture->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, video->pbo);
-	buf = gl_capture->glMapBuffer(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY);
-	if (unlikely(!buf))
-		return EINVAL;
+	/* to = ((char *)NULL + (offset)) */
+	gl_capture_read_pixels(gl_capture, video, NULL);
 
-	ps_packet_write(&video->packet, buf, video->row * video->ch);
+	if (gl_capture->flags & GL_CAPTURE_USE_SYNC)
+		slot->fence = gl_capture->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
-	gl_capture->glUnmapBuffer(GL_PIXEL_PACK_BUFFER_ARB);
+	gl_capture_restore_pixel_state(gl_capture, video);
 
-	gl_capture->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, binding);
+	slot->time = now;
+	video->pbo_head = (video->pbo_head + 1) % gl_capture->pbo_depth;
+
+	if (video->readback) {
+		/* fence must reach the GPU for the other context to see it */
+		glFlush();
+
+		pthread_mutex_lock(&video->readback->mutex);
+		__sync_add_and_fetch(&video->pbo_pending, 1);
+		pthread_cond_broadcast(&video->readback->cond);
+		pthread_mutex_unlock(&video->readback->mutex);
+	} else
+		video->pbo_pending++;
+
+	glc_trace_end(gl_capture->glc, "readback start", begin, now);
 	return 0;
 }
 
-int gl_capture_get_video_stream(gl_capture_t gl_capture,
-				struct gl_capture_video_stream_s **video,
-				Display *dpy, GLXDrawable drawable)
+/*
+ * Returns 1 if the oldest transfer can be mapped without stalling.
+ * The fence is polled with a zero timeout and no flush; the host
+ * buffer swap takes care of flushing the command stream. Without
+ * GL_ARB_sync, the oldest transfer is only mapped once the ring is full.
+ */
+int gl_capture_pbo_ready(gl_capture_t gl_capture,
+			 struct gl_capture_video_stream_s *video)
 {
-	struct gl_capture_video_stream_s *fvideo;
+	struct gl_capture_pbo_s *slot;
+	GLenum status;
 
-	fvideo = gl_capture->video;
-	while (fvideo != NULL) {
-		if ((fvideo->drawable == drawable) && (fvideo->dpy == dpy))
-			break;
+	if (!video->pbo_pending)
+		return 0;
 
-		fvideo = fvideo->next;
-	}
+	slot = &video->pbo[video->pbo_tail];
+	if (!slot->fence)
+		return video->pbo_pending == gl_capture->pbo_depth;
 
-	if (fvideo == NULL) {
-		fvideo = (struct gl_capture_video_stream_s *)
-			calloc(1, sizeof(struct gl_capture_video_stream_s));
+	status = gl_capture->glClientWaitSync(slot->fence, 0, 0);
+	return (status == GL_ALREADY_SIGNALED) || (status == GL_CONDITION_SATISFIED);
+}
 
-		fvideo->dpy          = dpy;
-		fvideo->drawable     = drawable;
-		fvideo->flags        = GLC_VIDEO_NEED_COLOR_UPDATE;
-		fvideo->gather_stats = glc_log_get_level(gl_capture->glc) >= GLC_PERF;
-		ps_packet_init(&fvideo->packet, gl_capture->to);
+int gl_capture_read_pbo(gl_capture_t gl_capture,
+			struct gl_capture_video_stream_s *video,
+			ps_packet_t *packet, glc_utime_t now, int try)
+{
+	struct gl_capture_pbo_s *slot = &video->pbo[video->pbo_tail];
+	glc_message_header_t msg;
+	glc_video_frame_header_t pic;
+	glc_utime_t begin = glc_trace_begin(gl_capture->glc);
+	uint64_t hash = 0;
+	GLvoid *buf;
+	char *dma;
+	int ret;
+
+	/*
+	 * Make sure that the slot time is not in the future. This could happen if
+	 * the state time is reset by reloading the capture between a pbo start
+	 * and a pbo read.
+	 */
+	pic.time = (slot->time < now)?slot->time:now;
+	pic.id   = video->id;
+
+	/* the caller saves the pack buffer binding if it must be kept */
+	gl_capture->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, slot->pbo);
+	buf = gl_capture->glMapBuffer(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY);
+	if (unlikely(!buf))
+		return EINVAL;
+
+	if (gl_capture->flags & GL_CAPTURE_SKIP_DUPLICATES) {
+		hash = gl_capture_hash_frame(buf, video->size);
+		if (hash == video->last_hash) {
+			ret = gl_capture_write_repeat(gl_capture, video, packet,
+						      pic.time, try);
+			goto unmap;
+		}
+	}
+
+	if (unlikely(ps_packet_open(packet, try ?
+				(PS_PACKET_WRITE | PS_PACKET_TRY) :
+				(PS_PACKET_WRITE)))) {
+		ret = EBUSY; /* keep it in the ring and retry on next swap */
+		goto unmap;
+	}
+
+	if (unlikely((ret = ps_packet_setsize(packet, video->frame_size
+						+ sizeof(glc_message_header_t)
+						+ sizeof(glc_video_frame_header_t)))))
+		goto cancel;
+
+	msg.type = GLC_MESSAGE_VIDEO_FRAME;
+	if (unlikely((ret = ps_packet_write(packet,
+					    &msg, sizeof(glc_message_header_t)))))
+		goto cancel;
+
+	if (unlikely((ret = ps_packet_write(packet,
+					    &pic, sizeof(glc_video_frame_header_t)))))
+		goto cancel;
+
+	if (video->cpu_convert) {
+		/* single pass from the mapped buffer into the stream */
+		if (likely(!(ret = ps_packet_dma(packet, (void *) &dma,
+						 video->frame_size, PS_ACCEPT_FAKE_DMA))))
+			ret = ycbcr_convert(gl_capture->ycbcr, video->id, buf,
+					    (unsigned char *) dma);
+	} else
+		ret = ps_packet_write(packet, buf, video->size);
+
+	if (unlikely(ret))
+		goto cancel;
+
+	if (likely(!(ret = ps_packet_close(packet)))) {
+		video->last_hash = hash;
+		glc_trace_instant(gl_capture->glc, "commit", pic.time);
+		GLC_PROBE3(frame_capture, pic.id, pic.time, 0);
+	}
+unmap:
+	gl_capture->glUnmapBuffer(GL_PIXEL_PACK_BUFFER_ARB);
+	glc_trace_end(gl_capture->glc, "readback", begin, pic.time);
+	return ret;
+cancel:
+	ps_packet_cancel(packet);
+	goto unmap;
+}
+
+/*
+ * Fast non-cryptographic hash used to spot frames identical to the
+ * previous one. Eight independent lanes let the compiler vectorize the
+ * main loop. 0 is reserved to mean "no previous frame".
+ */
+uint64_t gl_capture_hash_frame(const void *data, size_t size)
+{
+	static const uint32_t prime1 = 2654435761U, prime2 = 2246822519U;
+	const unsigned char *p = (const unsigned char *) data;
+	uint32_t lane[8], in[8];
+	uint64_t hash;
+	size_t i;
+	int l;
+
+	for (l = 0; l < 8; l++)
+		lane[l] = prime1 + l * prime2;
+
+	for (i = 0; i + sizeof(in) <= size; i += sizeof(in)) {
+		memcpy(in, &p[i], sizeof(in));
+		for (l = 0; l < 8; l++) {
+			lane[l] += in[l] * prime2;
+			lane[l] = (lane[l] << 13) | (lane[l] >> 19);
+			lane[l] *= prime1;
+		}
+	}
+
+	for (l = 0; i < size; i++, l = (l + 1) & 7)
+		lane[l] = (lane[l] ^ p[i]) * prime1;
+
+	hash = size;
+	for (l = 0; l < 8; l++) {
+		hash ^= lane[l];
+		hash *= 0x9e3779b97f4a7c15ULL;
+		hash ^= hash >> 29;
+	}
+
+	return hash ? hash : 1;
+}
+
+/*
+ * Check a frame read back without PBO against the previous one. The
+ * frame is remembered as the last written one if it differs.
+ */
+int gl_capture_is_repeat(gl_capture_t gl_capture,
+			 struct gl_capture_video_stream_s *video,
+			 const char *frame)
+{
+	uint64_t hash;
+
+	if (!(gl_capture->flags & GL_CAPTURE_SKIP_DUPLICATES))
+		return 0;
+
+	hash = gl_capture_hash_frame(frame, video->size);
+	if (hash == video->last_hash)
+		return 1;
+
+	video->last_hash = hash;
+	return 0;
+}
+
+/* tell consumers to show the previous frame again */
+int gl_capture_write_repeat(gl_capture_t gl_capture,
+			    struct gl_capture_video_stream_s *video,
+			    ps_packet_t *packet, glc_utime_t time, int try)
+{
+	glc_message_header_t msg;
+	glc_video_frame_header_t pic;
+	int ret;
+
+	if (unlikely(ps_packet_open(packet, try ?
+				(PS_PACKET_WRITE | PS_PACKET_TRY) :
+				(PS_PACKET_WRITE))))
+		return EBUSY;
+
+	msg.type = GLC_MESSAGE_VIDEO_REPEAT;
+	pic.time = time;
+	pic.id   = video->id;
+	if (unlikely((ret = ps_packet_write(packet,
+					    &msg, sizeof(glc_message_header_t)))) ||
+	    unlikely((ret = ps_packet_write(packet,
+					    &pic, sizeof(glc_video_frame_header_t))))) {
+		ps_packet_cancel(packet);
+		return ret;
+	}
+
+	if (likely(!(ret = ps_packet_close(packet)))) {
+		__sync_add_and_fetch(&video->num_repeated_frames, 1);
+		glc_trace_instant(gl_capture->glc, "commit repeat", time);
+		GLC_PROBE3(frame_capture, pic.id, time, 1);
+	}
+	return ret;
+}
+
+/*
+ * Write out every completed transfer, oldest first. If wait is set and
+ * the ring is full, the oldest transfer is read even if it means stalling.
+ */
+int gl_capture_flush_pbo(gl_capture_t gl_capture,
+			 struct gl_capture_video_stream_s *video,
+			 glc_utime_t now, int wait)
+{
+	struct gl_capture_pbo_s *slot;
+	glc_utime_t before_capture = 0;
+	int saved = 0;
+	int ret = 0;
+
+	while ((wait && (video->pbo_pending == gl_capture->pbo_depth)) ||
+	       gl_capture_pbo_ready(gl_capture, video)) {
+		if (video->gather_stats)
+			before_capture = glc_state_time(gl_capture->glc);
+
+		if (!saved) {
+			glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+			saved = 1;
+		}
+
+		ret = gl_capture_read_pbo(gl_capture, video, &video->packet, now,
+					  !(gl_capture->flags & GL_CAPTURE_LOCK_FPS) &&
+					  !(gl_capture->flags & GL_CAPTURE_IGNORE_TIME));
+		if (ret == EBUSY) {
+			ret = 0;
+			break;
+		} else if (unlikely(ret))
+			break;
+
+		if (video->gather_stats)
+			video->capture_time_ns += glc_state_time(gl_capture->glc) -
+						  before_capture;
+
+		slot = &video->pbo[video->pbo_tail];
+		if (slot->fence) {
+			gl_capture->glDeleteSync(slot->fence);
+			slot->fence = NULL;
+		}
+		video->pbo_tail = (video->pbo_tail + 1) % gl_capture->pbo_depth;
+		video->pbo_pending--;
+	}
+
+	if (saved)
+		glPopClientAttrib();
+	return ret;
+}
+
+int gl_capture_create_readback(gl_capture_t gl_capture,
+			       struct gl_capture_video_stream_s *video)
+{
+	struct gl_capture_readback_s *readback;
+	int attribs[] = { GLX_FBCONFIG_ID, 0, None };
+	int pbuffer_attribs[] = { GLX_PBUFFER_WIDTH, 1, GLX_PBUFFER_HEIGHT, 1, None };
+	GLXContext share = glXGetCurrentContext();
+	GLXFBConfig *configs;
+	int num_configs, drawable_type = 0;
+
+	if (unlikely(!share) ||
+	    unlikely(glXQueryContext(video->dpy, share, GLX_FBCONFIG_ID, &attribs[1])))
+		return ENOTSUP;
+
+	readback = (struct gl_capture_readback_s *)
+		calloc(1, sizeof(struct gl_capture_readback_s));
+	if (unlikely(!readback))
+		return ENOMEM;
+
+	/*
+	 * Xlib before 1.8 is not thread safe unless the application called
+	 * XInitThreads(), so the thread gets a connection of its own.
+	 */
+	readback->dpy = XOpenDisplay(DisplayString(video->dpy));
+	if (unlikely(!readback->dpy)) {
+		free(readback);
+		return ENOTSUP;
+	}
+
+	configs = glXChooseFBConfig(readback->dpy, video->screen, attribs, &num_configs);
+	if (likely(configs) && (num_configs > 0))
+		glXGetFBConfigAttrib(readback->dpy, configs[0],
+				     GLX_DRAWABLE_TYPE, &drawable_type);
+
+	/* a 1x1 pbuffer is needed to make the context current */
+	if (likely(drawable_type & GLX_PBUFFER_BIT)) {
+		readback->ctx = glXCreateNewContext(readback->dpy, configs[0],
+						    GLX_RGBA_TYPE, share, True);
+		if (likely(readback->ctx))
+			readback->pbuffer = glXCreatePbuffer(readback->dpy, configs[0],
+							     pbuffer_attribs);
+	}
+	if (configs)
+		XFree(configs);
+
+	if (unlikely((!readback->ctx) || (!readback->pbuffer))) {
+		if (readback->ctx)
+			glXDestroyContext(readback->dpy, readback->ctx);
+		XCloseDisplay(readback->dpy);
+		free(readback);
+		return ENOTSUP;
+	}
+
+	readback->gl_capture = gl_capture;
+	readback->thread.name = "capture";
+	pthread_mutex_init(&readback->mutex, NULL);
+	pthread_cond_init(&readback->cond, NULL);
+	ps_packet_init(&readback->packet, gl_capture->to);
+
+	/* the thread reads video->readback */
+	video->readback = readback;
+	if (unlikely(glc_simple_thread_create(gl_capture->glc, &readback->thread,
+					      gl_capture_readback_loop, video))) {
+		video->readback = NULL;
+		gl_capture_free_readback(readback);
+		return EAGAIN;
+	}
+
+	/* frames are read at swap if the thread can't use its context */
+	pthread_mutex_lock(&readback->mutex);
+	while (!readback->ready)
+		pthread_cond_wait(&readback->cond, &readback->mutex);
+	pthread_mutex_unlock(&readback->mutex);
+
+	if (unlikely(readback->ready < 0)) {
+		glc_simple_thread_wait(gl_capture->glc, &readback->thread);
+		video->readback = NULL;
+		gl_capture_free_readback(readback);
+		glc_log(gl_capture->glc, GLC_ERROR, "gl_capture",
+			"can't make readback context current for video %d",
+			video->id);
+		return ENOTSUP;
+	}
+
+	glc_log(gl_capture->glc, GLC_INFO, "gl_capture",
+		"started readback thread for video %d", video->id);
+	return 0;
+}
+
+int gl_capture_destroy_readback(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video)
+{
+	struct gl_capture_readback_s *readback = video->readback;
+
+	pthread_mutex_lock(&readback->mutex);
+	readback->quit = 1;
+	pthread_cond_broadcast(&readback->cond);
+	pthread_mutex_unlock(&readback->mutex);
+
+	glc_simple_thread_wait(gl_capture->glc, &readback->thread);
+	video->readback = NULL;
+
+	gl_capture_free_readback(readback);
+	return 0;
+}
+
+void gl_capture_free_readback(struct gl_capture_readback_s *readback)
+{
+	ps_packet_destroy(&readback->packet);
+	pthread_cond_destroy(&readback->cond);
+	pthread_mutex_destroy(&readback->mutex);
+	glXDestroyPbuffer(readback->dpy, readback->pbuffer);
+	glXDestroyContext(readback->dpy, readback->ctx);
+	XCloseDisplay(readback->dpy);
+	free(readback);
+}
+
+/* block until at most pending transfers are left in flight */
+void gl_capture_wait_readback(struct gl_capture_video_stream_s *video,
+			      unsigned int pending)
+{
+	pthread_mutex_lock(&video->readback->mutex);
+	while (video->pbo_pending > pending)
+		pthread_cond_wait(&video->readback->cond, &video->readback->mutex);
+	pthread_mutex_unlock(&video->readback->mutex);
+}
+
+void *gl_capture_readback_loop(void *argptr)
+{
+	struct gl_capture_video_stream_s *video =
+		(struct gl_capture_video_stream_s *) argptr;
+	struct gl_capture_readback_s *readback = video->readback;
+	gl_capture_t gl_capture = readback->gl_capture;
+	struct gl_capture_pbo_s *slot;
+	glc_utime_t before_capture = 0;
+	int ret;
+
+	ret = glXMakeContextCurrent(readback->dpy, readback->pbuffer,
+				    readback->pbuffer, readback->ctx);
+
+	pthread_mutex_lock(&readback->mutex);
+	readback->ready = ret ? 1 : -1;
+	pthread_cond_broadcast(&readback->cond);
+	if (unlikely(!ret)) {
+		pthread_mutex_unlock(&readback->mutex);
+		return NULL;
+	}
+
+	for (;;) {
+		/* queued frames are still written when asked to quit */
+		while ((!video->pbo_pending) && (!readback->quit))
+			pthread_cond_wait(&readback->cond, &readback->mutex);
+		if (!video->pbo_pending)
+			break;
+		pthread_mutex_unlock(&readback->mutex);
+
+		slot = &video->pbo[video->pbo_tail];
+		while (gl_capture->glClientWaitSync(slot->fence, 0, 1000000000) ==
+		       GL_TIMEOUT_EXPIRED)
+			glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
+				"video %d: PBO transfer is taking more than 1s",
+				video->id);
+
+		if (video->gather_stats)
+			before_capture = glc_state_time(gl_capture->glc);
+
+		/* only this thread waits on the buffer */
+		ret = gl_capture_read_pbo(gl_capture, video, &readback->packet,
+					  glc_state_time(gl_capture->glc), 0);
+		if (unlikely(ret)) {
+			glc_log(gl_capture->glc, GLC_ERROR, "gl_capture",
+				"can't write video %d frame: %s (%d)",
+				video->id, strerror(ret), ret);
+			glc_state_set(gl_capture->glc, GLC_STATE_CANCEL);
+		} else
+			__sync_add_and_fetch(&video->num_captured_frames, 1);
+
+		if (video->gather_stats)
+			__sync_add_and_fetch(&video->capture_time_ns,
+					     glc_state_time(gl_capture->glc) -
+					     before_capture);
+
+		gl_capture->glDeleteSync(slot->fence);
+		slot->fence = NULL;
+		video->pbo_tail = (video->pbo_tail + 1) % gl_capture->pbo_depth;
+
+		pthread_mutex_lock(&readback->mutex);
+		__sync_sub_and_fetch(&video->pbo_pending, 1);
+		pthread_cond_broadcast(&readback->cond);
+	}
+	pthread_mutex_unlock(&readback->mutex);
+
+	glXMakeContextCurrent(readback->dpy, None, None, NULL);
+	return NULL;
+}
+
+void gl_capture_account_swap(struct gl_capture_video_stream_s *video,
+			     glc_utime_t cost)
+{
+	unsigned int bucket = 0;
+
+	if (cost)
+		bucket = 63 - __builtin_clzll(cost);
+	if (bucket >= GL_CAPTURE_COST_BUCKETS)
+		bucket = GL_CAPTURE_COST_BUCKETS - 1;
+	video->swap_cost[bucket]++;
+}
+
+void gl_capture_print_swap_cost(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s *video)
+{
+	unsigned int bucket;
+
+	glc_log(gl_capture->glc, GLC_PERF, "gl_capture",
+		"video %d per-swap capture cost:", video->id);
+	for (bucket = 0; bucket < GL_CAPTURE_COST_BUCKETS; bucket++) {
+		if (!video->swap_cost[bucket])
+			continue;
+		glc_log(gl_capture->glc, GLC_PERF, "gl_capture",
+			"  %10" PRIu64 " - %10" PRIu64 " nsec: %u swaps",
+			(uint64_t) 1 << bucket, ((uint64_t) 1 << (bucket + 1)) - 1,
+			video->swap_cost[bucket]);
+	}
+}
+
+#define GL_CAPTURE_GET_PROC(name) \
+	gl_capture->name = (name##Proc) \
+		gl_capture->glXGetProcAddress((const GLubyte *) #name); \
+	if (unlikely(!gl_capture->name)) \
+		return ENOTSUP;
+
+int gl_capture_init_fbo(gl_capture_t gl_capture)
+{
+	const char *gl_extensions = (const char *) glGetString(GL_EXTENSIONS);
+
+	if (unlikely(gl_extensions == NULL))
+		return EINVAL;
+
+	if (unlikely(!strstr(gl_extensions, "GL_ARB_framebuffer_object")))
+		return ENOTSUP;
+
+	if (unlikely(gl_capture_init_libgl(gl_capture)))
+		return ENOTSUP;
+
+	GL_CAPTURE_GET_PROC(glGenFramebuffers)
+	GL_CAPTURE_GET_PROC(glDeleteFramebuffers)
+	GL_CAPTURE_GET_PROC(glBindFramebuffer)
+	GL_CAPTURE_GET_PROC(glFramebufferTexture2D)
+	GL_CAPTURE_GET_PROC(glCheckFramebufferStatus)
+	GL_CAPTURE_GET_PROC(glBlitFramebuffer)
+
+	return 0;
+}
+
+int gl_capture_init_convert(gl_capture_t gl_capture)
+{
+	const char *gl_extensions = (const char *) glGetString(GL_EXTENSIONS);
+	const char *gl_version = (const char *) glGetString(GL_VERSION);
+	int major = 0, minor = 0;
+
+	if (unlikely((gl_extensions == NULL) || (gl_version == NULL)))
+		return EINVAL;
+
+	/* GLSL is core since 2.0 */
+	if (unlikely((sscanf(gl_version, "%d.%d", &major, &minor) != 2) ||
+		     (major < 2)))
+		return ENOTSUP;
+
+	if (unlikely(gl_capture_init_fbo(gl_capture)))
+		return ENOTSUP;
+
+	GL_CAPTURE_GET_PROC(glCreateShader)
+	GL_CAPTURE_GET_PROC(glShaderSource)
+	GL_CAPTURE_GET_PROC(glCompileShader)
+	GL_CAPTURE_GET_PROC(glGetShaderiv)
+	GL_CAPTURE_GET_PROC(glDeleteShader)
+	GL_CAPTURE_GET_PROC(glCreateProgram)
+	GL_CAPTURE_GET_PROC(glAttachShader)
+	GL_CAPTURE_GET_PROC(glLinkProgram)
+	GL_CAPTURE_GET_PROC(glGetProgramiv)
+	GL_CAPTURE_GET_PROC(glUseProgram)
+	GL_CAPTURE_GET_PROC(glDeleteProgram)
+	GL_CAPTURE_GET_PROC(glGetUniformLocation)
+	GL_CAPTURE_GET_PROC(glUniform1i)
+	GL_CAPTURE_GET_PROC(glActiveTexture)
+
+	glc_log(gl_capture->glc, GLC_INFO, "gl_capture",
+		 "converting to Y'CbCr 420jpeg on the GPU");
+
+	return 0;
+}
+
+int gl_capture_create_program(gl_capture_t gl_capture,
+			      const GLchar *fragment, GLuint *program)
+{
+	GLuint vs, fs;
+	GLint status, vs_status;
+
+	vs = gl_capture->glCreateShader(GL_VERTEX_SHADER);
+	gl_capture->glShaderSource(vs, 1, &gl_capture_convert_vertex, NULL);
+	gl_capture->glCompileShader(vs);
+	gl_capture->glGetShaderiv(vs, GL_COMPILE_STATUS, &vs_status);
+
+	fs = gl_capture->glCreateShader(GL_FRAGMENT_SHADER);
+	gl_capture->glShaderSource(fs, 1, &fragment, NULL);
+	gl_capture->glCompileShader(fs);
+	gl_capture->glGetShaderiv(fs, GL_COMPILE_STATUS, &status);
+
+	if (unlikely((!vs_status) || (!status))) {
+		glc_log(gl_capture->glc, GLC_ERROR, "gl_capture",
+			 "can't compile conversion shader");
+		gl_capture->glDeleteShader(vs);
+		gl_capture->glDeleteShader(fs);
+		return EINVAL;
+	}
+
+	*program = gl_capture->glCreateProgram();
+	gl_capture->glAttachShader(*program, vs);
+	gl_capture->glAttachShader(*program, fs);
+	gl_capture->glLinkProgram(*program);
+
+	/* program keeps the shaders alive */
+	gl_capture->glDeleteShader(vs);
+	gl_capture->glDeleteShader(fs);
+
+	gl_capture->glGetProgramiv(*program, GL_LINK_STATUS, &status);
+	if (unlikely(!status)) {
+		glc_log(gl_capture->glc, GLC_ERROR, "gl_capture",
+			 "can't link conversion program");
+		gl_capture->glDeleteProgram(*program);
+		*program = 0;
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+static void gl_capture_create_texture(GLuint *texture, GLint filter,
+				      unsigned int w, unsigned int h)
+{
+	glGenTextures(1, texture);
+	glBindTexture(GL_TEXTURE_2D, *texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0,
+		     GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+}
+
+int gl_capture_create_convert(gl_capture_t gl_capture,
+			      struct gl_capture_video_stream_s *video)
+{
+	GLint program, framebuffer, read_framebuffer;
+	GLenum src_status, y_status, c_status;
+	int ret = 0;
+
+	glc_log(gl_capture->glc, GLC_DEBUG, "gl_capture",
+		 "creating conversion objects for %ux%u", video->ow, video->oh);
+
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_framebuffer);
+	glPushAttrib(GL_ALL_ATTRIB_BITS);
+
+	if (unlikely((ret = gl_capture_create_program(gl_capture,
+			gl_capture_convert_y, &video->y_program))))
+		goto finish;
+	if (unlikely((ret = gl_capture_create_program(gl_capture,
+			gl_capture_convert_cbcr, &video->c_program))))
+		goto finish;
+
+	gl_capture->glActiveTexture(GL_TEXTURE0);
+	gl_capture->glUseProgram(video->y_program);
+	gl_capture->glUniform1i(gl_capture->glGetUniformLocation(video->y_program,
+								 "src"), 0);
+	gl_capture->glUseProgram(video->c_program);
+	gl_capture->glUniform1i(gl_capture->glGetUniformLocation(video->c_program,
+								 "src"), 0);
+
+	gl_capture_create_texture(&video->src_tex, GL_LINEAR, video->ow, video->oh);
+	gl_capture_create_texture(&video->y_tex, GL_NEAREST, video->ow, video->oh);
+	gl_capture_create_texture(&video->c_tex, GL_NEAREST,
+				  video->ow / 2, video->oh / 2);
+
+	gl_capture->glGenFramebuffers(1, &video->src_fbo);
+	gl_capture->glBindFramebuffer(GL_FRAMEBUFFER, video->src_fbo);
+	gl_capture->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+					   GL_TEXTURE_2D, video->src_tex, 0);
+	src_status = gl_capture->glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	gl_capture->glGenFramebuffers(1, &video->y_fbo);
+	gl_capture->glBindFramebuffer(GL_FRAMEBUFFER, video->y_fbo);
+	gl_capture->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+					   GL_TEXTURE_2D, video->y_tex, 0);
+	y_status = gl_capture->glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	gl_capture->glGenFramebuffers(1, &video->c_fbo);
+	gl_capture->glBindFramebuffer(GL_FRAMEBUFFER, video->c_fbo);
+	gl_capture->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+					   GL_TEXTURE_2D, video->c_tex, 0);
+	c_status = gl_capture->glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	if (unlikely((src_status != GL_FRAMEBUFFER_COMPLETE) ||
+		     (y_status != GL_FRAMEBUFFER_COMPLETE) ||
+		     (c_status != GL_FRAMEBUFFER_COMPLETE))) {
+		glc_log(gl_capture->glc, GLC_ERROR, "gl_capture",
+			 "conversion framebuffer is incomplete (0x%04x, 0x%04x, 0x%04x)",
+			 src_status, y_status, c_status);
+		ret = ENOTSUP;
+	}
+
+finish:
+	video->convert_created = 1;
+
+	gl_capture->glUseProgram(program);
+	gl_capture->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	gl_capture->glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+	glPopAttrib();
+
+	if (unlikely(ret))
+		gl_capture_destroy_convert(gl_capture, video);
+	return ret;
+}
+
+int gl_capture_destroy_convert(gl_capture_t gl_capture,
+			       struct gl_capture_video_stream_s *video)
+{
+	glc_log(gl_capture->glc, GLC_DEBUG, "gl_capture",
+		 "destroying conversion objects");
+
+	/* deleting name 0 is silently ignored */
+	gl_capture->glDeleteFramebuffers(1, &video->src_fbo);
+	gl_capture->glDeleteFramebuffers(1, &video->y_fbo);
+	gl_capture->glDeleteFramebuffers(1, &video->c_fbo);
+	glDeleteTextures(1, &video->src_tex);
+	glDeleteTextures(1, &video->y_tex);
+	glDeleteTextures(1, &video->c_tex);
+	gl_capture->glDeleteProgram(video->y_program);
+	gl_capture->glDeleteProgram(video->c_program);
+
+	video->src_fbo = video->y_fbo = video->c_fbo = 0;
+	video->src_tex = video->y_tex = video->c_tex = 0;
+	video->y_program = video->c_program = 0;
+	video->convert_created = 0;
+	return 0;
+}
+
+/* fullscreen quad, flipped vertically */
+static void gl_capture_draw_quad(void)
+{
+	glBegin(GL_TRIANGLE_STRIP);
+	glTexCoord2f(0.0f, 1.0f);
+	glVertex2f(-1.0f, -1.0f);
+	glTexCoord2f(1.0f, 1.0f);
+	glVertex2f(1.0f, -1.0f);
+	glTexCoord2f(0.0f, 0.0f);
+	glVertex2f(-1.0f, 1.0f);
+	glTexCoord2f(1.0f, 0.0f);
+	glVertex2f(1.0f, 1.0f);
+	glEnd();
+}
+
+/*
+ * Writes the Y', Cb and Cr planes one after the other into to, in the
+ * GLC_VIDEO_YCBCR_420JPEG layout.
+ */
+int gl_capture_convert_pixels(gl_capture_t gl_capture,
+			      struct gl_capture_video_stream_s *video, char *to)
+{
+	GLint program, framebuffer, read_framebuffer;
+	unsigned int cw = video->ow / 2, ch = video->oh / 2;
+
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_framebuffer);
+	glPushAttrib(GL_ALL_ATTRIB_BITS);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	glDisable(GL_ALPHA_TEST);
+	glDisable(GL_BLEND);
+	glDisable(GL_CULL_FACE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	glReadBuffer(gl_capture->capture_buffer);
+	if (video->use_scale) {
+		/* downscale whole capture area */
+		gl_capture->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, video->src_fbo);
+		gl_capture->glBlitFramebuffer(video->cx, video->cy,
+					      video->cx + video->cw, video->cy + video->ch,
+					      0, 0, video->ow, video->oh,
+					      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	} else {
+		/* grab capture area, skipping the bottom row if height is odd */
+		gl_capture->glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, video->src_tex);
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+				    video->cx, video->cy + video->ch - video->oh,
+				    video->ow, video->oh);
+	}
+
+	gl_capture->glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, video->src_tex);
+
+	gl_capture->glBindFramebuffer(GL_FRAMEBUFFER, video->y_fbo);
+	glViewport(0, 0, video->ow, video->oh);
+	gl_capture->glUseProgram(video->y_program);
+	gl_capture_draw_quad();
+
+	gl_capture->glBindFramebuffer(GL_FRAMEBUFFER, video->c_fbo);
+	glViewport(0, 0, cw, ch);
+	gl_capture->glUseProgram(video->c_program);
+	gl_capture_draw_quad();
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(0, 0, cw, ch, GL_RED, GL_UNSIGNED_BYTE,
+		     to + video->ow * video->oh);
+	glReadPixels(0, 0, cw, ch, GL_GREEN, GL_UNSIGNED_BYTE,
+		     to + video->ow * video->oh + cw * ch);
+
+	gl_capture->glBindFramebuffer(GL_FRAMEBUFFER, video->y_fbo);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(0, 0, video->ow, video->oh, GL_RED, GL_UNSIGNED_BYTE, to);
+
+	gl_capture->glUseProgram(program);
+	gl_capture->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	gl_capture->glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+	glPopAttrib();
+
+	return 0;
+}
+
+int gl_capture_create_scale(gl_capture_t gl_capture,
+			    struct gl_capture_video_stream_s *video)
+{
+	GLint framebuffer, read_framebuffer;
+	GLenum status;
+
+	glc_log(gl_capture->glc, GLC_DEBUG, "gl_capture",
+		 "creating scaling framebuffer %ux%u", video->ow, video->oh);
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_framebuffer);
+	glPushAttrib(GL_TEXTURE_BIT);
+
+	gl_capture_create_texture(&video->scale_tex, GL_NEAREST, video->ow, video->oh);
+	gl_capture->glGenFramebuffers(1, &video->scale_fbo);
+	gl_capture->glBindFramebuffer(GL_FRAMEBUFFER, video->scale_fbo);
+	gl_capture->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+					   GL_TEXTURE_2D, video->scale_tex, 0);
+	status = gl_capture->glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	gl_capture->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	gl_capture->glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+	glPopAttrib();
+
+	if (unlikely(status != GL_FRAMEBUFFER_COMPLETE)) {
+		glc_log(gl_capture->glc, GLC_ERROR, "gl_capture",
+			 "scaling framebuffer is incomplete (0x%04x)", status);
+		gl_capture_destroy_scale(gl_capture, video);
+		return ENOTSUP;
+	}
+
+	return 0;
+}
+
+int gl_capture_destroy_scale(gl_capture_t gl_capture,
+			     struct gl_capture_video_stream_s *video)
+{
+	glc_log(gl_capture->glc, GLC_DEBUG, "gl_capture",
+		 "destroying scaling framebuffer");
+
+	gl_capture->glDeleteFramebuffers(1, &video->scale_fbo);
+	glDeleteTextures(1, &video->scale_tex);
+	video->scale_fbo = video->scale_tex = 0;
+	return 0;
+}
+
+/* linear filtered blit of the capture area, then readback of the result */
+int gl_capture_scale_pixels(gl_capture_t gl_capture,
+			    struct gl_capture_video_stream_s *video, char *to)
+{
+	GLint framebuffer, read_framebuffer;
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_framebuffer);
+	glPushAttrib(GL_ENABLE_BIT);
+
+	/* blit is subject to scissor test */
+	glDisable(GL_SCISSOR_TEST);
+
+	glReadBuffer(gl_capture->capture_buffer);
+	gl_capture->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, video->scale_fbo);
+	gl_capture->glBlitFramebuffer(video->cx, video->cy,
+				      video->cx + video->cw, video->cy + video->ch,
+				      0, 0, video->ow, video->oh,
+				      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	gl_capture->glBindFramebuffer(GL_READ_FRAMEBUFFER, video->scale_fbo);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, gl_capture->pack_alignment);
+	glReadPixels(0, 0, video->ow, video->oh,
+		gl_capture->format, GL_UNSIGNED_BYTE, to);
+
+	gl_capture->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	gl_capture->glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+	glPopAttrib();
+
+	return 0;
+}
+
+static inline unsigned int gl_capture_video_hash(Display *dpy, GLXDrawable drawable)
+{
+	uintptr_t key = (uintptr_t) drawable ^ ((uintptr_t) dpy >> 4);
+	return (key ^ (key >> 6) ^ (key >> 12)) & (GL_CAPTURE_VIDEO_HASH - 1);
+}
+
+/*
+ * Streams are only added, and freed in gl_capture_destroy(). Lookups
+ * walk the hash chain without locking; new streams are fully set up
+ * before being published, under gl_capture->mutex.
+ */
+int gl_capture_get_video_stream(gl_capture_t gl_capture,
+				struct gl_capture_video_stream_s **video,
+				Display *dpy, GLXDrawable drawable)
+{
+	unsigned int hash = gl_capture_video_hash(dpy, drawable);
+	struct gl_capture_video_stream_s *fvideo;
+
+	for (fvideo = gl_capture->video_hash[hash]; fvideo; fvideo = fvideo->hash_next) {
+		if (likely((fvideo->drawable == drawable) && (fvideo->dpy == dpy))) {
+			*video = fvideo;
+			return 0;
+		}
+	}
+
+	pthread_mutex_lock(&gl_capture->mutex);
+
+	/* another thread might have added it meanwhile */
+	for (fvideo = gl_capture->video_hash[hash]; fvideo; fvideo = fvideo->hash_next) {
+		if ((fvideo->drawable == drawable) && (fvideo->dpy == dpy))
+			break;
+	}
+
+	if (fvideo == NULL) {
+		fvideo = (struct gl_capture_video_stream_s *)
+			calloc(1, sizeof(struct gl_capture_video_stream_s));
+
+		fvideo->dpy          = dpy;
+		fvideo->drawable     = drawable;
+		fvideo->flags        = GLC_VIDEO_NEED_COLOR_UPDATE;
+		fvideo->gather_stats = glc_log_get_level(gl_capture->glc) >= GLC_PERF;
+		ps_packet_init(&fvideo->packet, gl_capture->to);
 
 		glc_state_video_new(gl_capture->glc, &fvideo->id, &fvideo->state_video);
 
 		fvideo->next      = gl_capture->video;
+		fvideo->hash_next = gl_capture->video_hash[hash];
 
 		/* linked list multithread sync RCU style! */
+		__sync_synchronize();
+		gl_capture->video_hash[hash] = fvideo;
 		gl_capture->video = fvideo;
 	}
-	__sync_or_and_fetch(&fvideo->flags, GLC_VIDEO_CAPTURING);
+
+	pthread_mutex_unlock(&gl_capture->mutex);
+
 	*video = fvideo;
 	return 0;
 }
 
-static inline void gl_capture_release_video_stream(struct gl_capture_video_stream_s *video)
+static inline int gl_capture_enter_frame(gl_capture_t gl_capture)
+{
+	/* cheap test first, nothing is shared when not capturing */
+	if (!(gl_capture->flags & GL_CAPTURE_CAPTURING))
+		return 0;
+
+	/* gl_capture_stop() clears the flag before counting frames in flight */
+	__sync_add_and_fetch(&gl_capture->active_frames, 1);
+	if (likely(gl_capture->flags & GL_CAPTURE_CAPTURING))
+		return 1;
+
+	gl_capture_leave_frame(gl_capture);
+	return 0;
+}
+
+void gl_capture_leave_frame(gl_capture_t gl_capture)
 {
-	__sync_and_and_fetch(&video->flags, ~GLC_VIDEO_CAPTURING);
+	if (likely(__sync_sub_and_fetch(&gl_capture->active_frames, 1)) ||
+	    likely(!gl_capture->stopping))
+		return;
+
+	pthread_mutex_lock(&gl_capture->quiesce_mutex);
+	pthread_cond_broadcast(&gl_capture->quiesce_cond);
+	pthread_mutex_unlock(&gl_capture->quiesce_mutex);
 }
 
 int gl_capture_clear_video_streams(gl_capture_t gl_capture)
 {
 	struct gl_capture_video_stream_s *fvideo;
+
+	/* wait for the frames that saw the capture as active */
+	pthread_mutex_lock(&gl_capture->quiesce_mutex);
+	while (gl_capture->active_frames)
+		pthread_cond_wait(&gl_capture->quiesce_cond, &gl_capture->quiesce_mutex);
+	pthread_mutex_unlock(&gl_capture->quiesce_mutex);
+
 	fvideo = gl_capture->video;
 	while (fvideo != NULL) {
-		while (unlikely(fvideo->flags & GLC_VIDEO_CAPTURING)) {
-			struct timespec one_ms = { .tv_sec = 0, .tv_nsec = 1000000 };
-			clock_nanosleep(CLOCK_MONOTONIC, 0, &one_ms, NULL);
-		}
 		fvideo->last = 0;
 		fvideo = fvideo->next;
 	}
@@ -788,12 +2234,20 @@ int gl_capture_init_video_format(gl_capture_t gl_capture,
 	/* reset gamma values */
 	video->gamma_red = video->gamma_green = video->gamma_blue = 1.0;
 
-	if (gl_capture->format == GL_BGRA)
+	/* the frame format is fixed once, a stream that fell back stays BGR(A) */
+	if (!video->format)
+		video->use_convert = !!(gl_capture->flags & GL_CAPTURE_USE_CONVERT);
+
+	if (video->use_convert)
+		video->format = GLC_VIDEO_YCBCR_420JPEG;
+	else if (gl_capture->format == GL_BGRA)
 		video->format = GLC_VIDEO_BGRA;
 	else
 		video->format = GLC_VIDEO_BGR;
 
-	if (gl_capture->pack_alignment == 8)
+	/* planes are always tightly packed */
+	if ((gl_capture->pack_alignment == 8) &&
+	    !video->use_convert)
 		__sync_or_and_fetch(&video->flags, GLC_VIDEO_DWORD_ALIGNED);
 
 	return 0;
@@ -806,8 +2260,41 @@ int gl_capture_write_video_format_message(gl_capture_t gl_capture,
 	glc_message_header_t msg;
 	glc_video_format_message_t format_msg;
 
+	/* frames in flight belong to the previous geometry, let them through */
+	if (video->readback)
+		gl_capture_wait_readback(video, 0);
+
+	video->use_scale = !!(gl_capture->flags & GL_CAPTURE_USE_SCALE);
 	gl_capture_calc_geometry(gl_capture, video, w, h);
 
+	if (video->use_convert) {
+		if (video->convert_created)
+			gl_capture_destroy_convert(gl_capture, video);
+
+		if (unlikely(gl_capture_create_convert(gl_capture, video))) {
+			glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
+				 "GPU conversion failed for video %d, capturing BGRA",
+				 video->id);
+			video->use_convert = 0;
+			gl_capture_init_video_format(gl_capture, video);
+			gl_capture_calc_geometry(gl_capture, video, w, h);
+		}
+	}
+
+	/* BGR(A) frames, including a failed conversion, scale through their own FBO */
+	if (!video->use_convert && video->use_scale) {
+		if (video->scale_fbo)
+			gl_capture_destroy_scale(gl_capture, video);
+
+		if (unlikely(gl_capture_create_scale(gl_capture, video))) {
+			glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
+				 "GPU scaling failed for video %d, capturing unscaled",
+				 video->id);
+			video->use_scale = 0;
+			gl_capture_calc_geometry(gl_capture, video, w, h);
+		}
+	}
+
 	glc_log(gl_capture->glc, GLC_INFO, "gl_capture",
 		 "creating/updating configuration for video %d", video->id);
 
@@ -816,8 +2303,22 @@ int gl_capture_write_video_format_message(gl_capture_t gl_capture,
 			    ~(GLC_VIDEO_CAPTURING|GLC_VIDEO_NEED_COLOR_UPDATE);
 	format_msg.format = video->format;
 	format_msg.id     = video->id;
-	format_msg.width  = video->cw;
-	format_msg.height = video->ch;
+	format_msg.width  = video->ow;
+	format_msg.height = video->oh;
+	if (gl_capture->flags & GL_CAPTURE_SKIP_DUPLICATES)
+		format_msg.flags |= GLC_VIDEO_REPEATS;
+	video->last_hash = 0;
+
+	/* ycbcr rewrites the message to describe the converted frames */
+	video->cpu_convert = gl_capture->ycbcr &&
+			     !video->use_convert &&
+			     !ycbcr_video_format(gl_capture->ycbcr, &format_msg) &&
+			     (format_msg.format == GLC_VIDEO_YCBCR_420JPEG);
+	if (video->cpu_convert)
+		video->frame_size = format_msg.width * format_msg.height +
+				    2 * ((format_msg.width / 2) * (format_msg.height / 2));
+	else
+		video->frame_size = video->size;
 
 	ps_packet_open(&video->packet, PS_PACKET_WRITE);
 	ps_packet_write(&video->packet, &msg, sizeof(glc_message_header_t));
@@ -829,7 +2330,7 @@ int gl_capture_write_video_format_message(gl_capture_t gl_capture,
 		 video->cw, video->ch, video->w, video->h, video->flags);
 
 	if (gl_capture->flags & GL_CAPTURE_USE_PBO) {
-		if (video->pbo)
+		if (video->pbo_created)
 			gl_capture_destroy_pbo(gl_capture, video);
 
 		if (gl_capture_create_pbo(gl_capture, video)) {
@@ -843,8 +2344,10 @@ int gl_capture_write_video_format_message(gl_capture_t gl_capture,
 }
 
 int gl_capture_update_video_stream(gl_capture_t gl_capture,
-			  struct gl_capture_video_stream_s *video)
+			  struct gl_capture_video_stream_s *video,
+			  glc_utime_t now)
 {
+	uint64_t geometry = video->window_geometry;
 	unsigned int w, h;
 
 	/* initialize PBO if not already done */
@@ -865,9 +2368,68 @@ int gl_capture_update_video_stream(gl_capture_t gl_capture,
 		pthread_mutex_unlock(&gl_capture->mutex);
 	}
 
-	gl_capture_get_geometry(gl_capture, video->dpy,
-				video->attribWin ? video->attribWin : video->drawable,
-				&w, &h);
+	/* same for GPU colorspace conversion */
+	if (unlikely((!(gl_capture->flags & GL_CAPTURE_USE_CONVERT)) &&
+	    (gl_capture->flags & GL_CAPTURE_TRY_CONVERT))) {
+		pthread_mutex_lock(&gl_capture->mutex);
+
+		if (unlikely((!(gl_capture->flags & GL_CAPTURE_USE_CONVERT)) &&
+			     (gl_capture->flags & GL_CAPTURE_TRY_CONVERT))) {
+
+			if (!gl_capture_init_convert(gl_capture))
+				gl_capture->flags |= GL_CAPTURE_USE_CONVERT;
+			else {
+				glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
+					 "GPU conversion not supported, capturing BGRA");
+				gl_capture->flags &= ~GL_CAPTURE_TRY_CONVERT;
+			}
+		}
+
+		pthread_mutex_unlock(&gl_capture->mutex);
+	}
+
+	/* and GPU scaling */
+	if (unlikely((!(gl_capture->flags & GL_CAPTURE_USE_SCALE)) &&
+	    (gl_capture->flags & GL_CAPTURE_TRY_SCALE))) {
+		pthread_mutex_lock(&gl_capture->mutex);
+
+		if (unlikely((!(gl_capture->flags & GL_CAPTURE_USE_SCALE)) &&
+			     (gl_capture->flags & GL_CAPTURE_TRY_SCALE))) {
+
+			if (!gl_capture_init_fbo(gl_capture)) {
+				glc_log(gl_capture->glc, GLC_INFO, "gl_capture",
+					 "scaling with factor %f on the GPU",
+					 gl_capture->scale);
+				gl_capture->flags |= GL_CAPTURE_USE_SCALE;
+			} else {
+				glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
+					 "GPU scaling not supported, capturing unscaled");
+				gl_capture->flags &= ~GL_CAPTURE_TRY_SCALE;
+			}
+		}
+
+		pthread_mutex_unlock(&gl_capture->mutex);
+	}
+
+	/*
+	 * XGetGeometry() is a server round-trip. Once the application
+	 * event loop has shown us a ConfigureNotify, the size comes from
+	 * there. Otherwise it is polled at a low rate.
+	 */
+	if (likely(geometry)) {
+		w = geometry >> 32;
+		h = geometry & 0xffffffff;
+	} else if (unlikely((!video->format) ||
+			    (now - video->geometry_polled >= GL_CAPTURE_GEOMETRY_POLL) ||
+			    (now < video->geometry_polled))) {
+		gl_capture_get_geometry(gl_capture, video->dpy,
+					video->attribWin ? video->attribWin : video->drawable,
+					&w, &h);
+		video->geometry_polled = now;
+	} else {
+		w = video->w;
+		h = video->h;
+	}
 
 	if (unlikely(!video->format)) {
 		gl_capture_init_video_format(gl_capture,video);
@@ -885,6 +2447,21 @@ int gl_capture_update_video_stream(gl_capture_t gl_capture,
 	    (!video->indicator_list)))
 		gl_capture_gen_indicator_list(gl_capture, video);
 
+	/* readback thread needs both PBO and fences */
+	if (unlikely((gl_capture->flags & GL_CAPTURE_TRY_THREAD) &&
+		     (!video->readback) && (!video->readback_failed))) {
+		if ((gl_capture->flags & GL_CAPTURE_USE_PBO) &&
+		    (gl_capture->flags & GL_CAPTURE_USE_SYNC) &&
+		    !gl_capture_create_readback(gl_capture, video))
+			gl_capture->flags |= GL_CAPTURE_USE_THREAD;
+		else {
+			glc_log(gl_capture->glc, GLC_WARN, "gl_capture",
+				"can't start readback thread for video %d, "
+				"reading frames at swap", video->id);
+			video->readback_failed = 1;
+		}
+	}
+
 	return 0;
 }
 
@@ -901,18 +2478,20 @@ int gl_capture_frame(gl_capture_t gl_capture, Display *dpy, GLXDrawable drawable
 	glc_video_frame_header_t pic;
 	glc_utime_t now;
 	glc_utime_t before_capture = 0, after_capture = 0;
+	int repeat = 0;
+	glc_utime_t swap_start = 0;
+	glc_utime_t trace_begin, frame = 0;
 	char *dma;
 	int ret = 0;
 
-	spin_lock(&gl_capture->capture_spinlock);
-
-	if (!(gl_capture->flags & GL_CAPTURE_CAPTURING)) {
-		spin_unlock(&gl_capture->capture_spinlock);
+	if (!gl_capture_enter_frame(gl_capture))
 		return 0; /* capturing not active */
-	}
+	trace_begin = glc_trace_begin(gl_capture->glc);
 
 	gl_capture_get_video_stream(gl_capture, &video, dpy, drawable);
-	spin_unlock(&gl_capture->capture_spinlock);
+
+	if (video->gather_stats)
+		swap_start = glc_state_time(gl_capture->glc);
 
 	/* get current time */
 	if (unlikely(gl_capture->flags & GL_CAPTURE_IGNORE_TIME))
@@ -920,6 +2499,11 @@ int gl_capture_frame(gl_capture_t gl_capture, Display *dpy, GLXDrawable drawable
 	else
 		now = glc_state_time(gl_capture->glc);
 
+	/* collect completed transfers on every swap, captured or not */
+	if (video->pbo_pending && (!video->readback) &&
+	    unlikely((ret = gl_capture_flush_pbo(gl_capture, video, now, 0))))
+		goto finish;
+
 	/* has gl_capture->fps nanoseconds elapsed since last capture */
 	if ((now - video->last < gl_capture->fps_period) &&
 	    !(gl_capture->flags & GL_CAPTURE_LOCK_FPS) &&
@@ -932,69 +2516,115 @@ int gl_capture_frame(gl_capture_t gl_capture, Display *dpy, GLXDrawable drawable
 			now - video->last);
 
 	/* not really needed until now */
-	gl_capture_update_video_stream(gl_capture, video);
-	video->num_frames++;
-
-	/* if PBO is not active, just start transfer and finish */
-	if (unlikely((gl_capture->flags & GL_CAPTURE_USE_PBO) &&
-	     __sync_bool_compare_and_swap(&video->pbo_active,0,1))) {
-		ret = gl_capture_start_pbo(gl_capture, video);
-		video->pbo_time = now;
-		goto finish;
-	}
+	gl_capture_update_video_stream(gl_capture, video, now);
+	if (unlikely(!video->num_frames++))
+		video->first_frame = now;
+	frame = now;
 
-	if (unlikely(ps_packet_open(&video->packet,
-				((gl_capture->flags & GL_CAPTURE_LOCK_FPS) ||
-				(gl_capture->flags & GL_CAPTURE_IGNORE_TIME)) ?
-				(PS_PACKET_WRITE) :
-				(PS_PACKET_WRITE | PS_PACKET_TRY))))
-		goto finish;
+	if (gl_capture->flags & GL_CAPTURE_USE_PBO) {
+		/* every frame is wanted when fps is locked, make room */
+		if (unlikely((gl_capture->flags & GL_CAPTURE_LOCK_FPS) ||
+			     (gl_capture->flags & GL_CAPTURE_IGNORE_TIME))) {
+			if (video->readback)
+				gl_capture_wait_readback(video, gl_capture->pbo_depth - 1);
+			else if (unlikely((ret = gl_capture_flush_pbo(gl_capture,
+								     video, now, 1))))
+				goto finish;
+		}
 
-	if (unlikely((ret = ps_packet_setsize(&video->packet, video->row * video->ch
-						+ sizeof(glc_message_header_t)
-						+ sizeof(glc_video_frame_header_t)))))
-		goto cancel;
+		/* otherwise never wait for the GPU, drop the frame if the ring is full */
+		if (unlikely(video->pbo_pending == gl_capture->pbo_depth)) {
+			glc_log(gl_capture->glc, GLC_INFO, "gl_capture",
+				"dropped frame #%u, no free PBO",
+				video->num_frames);
+			GLC_PROBE3(frame_drop, video->id, video->num_frames, "no free PBO");
+			goto finish;
+		}
 
-	msg.type = GLC_MESSAGE_VIDEO_FRAME;
-	if (unlikely((ret = ps_packet_write(&video->packet,
-					    &msg, sizeof(glc_message_header_t)))))
-		goto cancel;
+		/*
+		 * the frame is written by gl_capture_flush_pbo() or the
+		 * readback thread once it has landed
+		 */
+		ret = gl_capture_start_pbo(gl_capture, video, now);
+	} else {
+		if (unlikely(ps_packet_open(&video->packet,
+					((gl_capture->flags & GL_CAPTURE_LOCK_FPS) ||
+					(gl_capture->flags & GL_CAPTURE_IGNORE_TIME)) ?
+					(PS_PACKET_WRITE) :
+					(PS_PACKET_WRITE | PS_PACKET_TRY)))) {
+			GLC_PROBE3(frame_drop, video->id, video->num_frames, "buffer full");
+			goto finish;
+		}
 
-	/*
-	 * if we are using PBO we will actually write previous picture to buffer.
-	 * Also, make sure that pbo_time is not in the future. This could happen if
-	 * the state time is reset by reloading the capture between a pbo start
-	 * and a pbo read.
-	 */
-	pic.time = (gl_capture->flags & GL_CAPTURE_USE_PBO &&
-		    video->pbo_time < now)?video->pbo_time:now;
-	pic.id   = video->id;
-	if (unlikely((ret = ps_packet_write(&video->packet,
-					    &pic, sizeof(glc_video_frame_header_t)))))
-		goto cancel;
+		if (unlikely((ret = ps_packet_setsize(&video->packet, video->frame_size
+							+ sizeof(glc_message_header_t)
+							+ sizeof(glc_video_frame_header_t)))))
+			goto cancel;
 
-	if (video->gather_stats)
-		before_capture = glc_state_time(gl_capture->glc);
-	if (gl_capture->flags & GL_CAPTURE_USE_PBO) {
-		if (unlikely((ret = gl_capture_read_pbo(gl_capture, video))))
+		msg.type = GLC_MESSAGE_VIDEO_FRAME;
+		if (unlikely((ret = ps_packet_write(&video->packet,
+						    &msg, sizeof(glc_message_header_t)))))
 			goto cancel;
 
-		ret = gl_capture_start_pbo(gl_capture, video);
-		video->pbo_time = now;
-	} else {
+		pic.time = now;
+		pic.id   = video->id;
+		if (unlikely((ret = ps_packet_write(&video->packet,
+						    &pic, sizeof(glc_video_frame_header_t)))))
+			goto cancel;
+
+		if (video->gather_stats)
+			before_capture = glc_state_time(gl_capture->glc);
+
 		if (unlikely((ret = ps_packet_dma(&video->packet, (void *) &dma,
-					video->row * video->ch, PS_ACCEPT_FAKE_DMA))))
+					video->frame_size, PS_ACCEPT_FAKE_DMA))))
 			goto cancel;
 
-		ret = gl_capture_get_pixels(gl_capture, video, dma);
-	}
-	if (video->gather_stats) {
-		after_capture = glc_state_time(gl_capture->glc);
-		video->capture_time_ns += after_capture - before_capture;
-	}
+		if (video->cpu_convert) {
+			if (unlikely(video->scratch_size < video->size)) {
+				free(video->scratch);
+				video->scratch = (char *) malloc(video->size);
+				video->scratch_size = video->size;
+			}
+
+			ret = gl_capture_get_pixels(gl_capture, video, video->scratch);
+			if (likely(!ret))
+				repeat = gl_capture_is_repeat(gl_capture, video,
+							       video->scratch);
+			if (likely(!ret) && !repeat)
+				ret = ycbcr_convert(gl_capture->ycbcr, video->id,
+						    (unsigned char *) video->scratch,
+						    (unsigned char *) dma);
+		} else {
+			ret = gl_capture_get_pixels(gl_capture, video, dma);
+			if (likely(!ret))
+				repeat = gl_capture_is_repeat(gl_capture, video, dma);
+		}
 
-	ps_packet_close(&video->packet);
-	video->num_captured_frames++;
+		if (video->gather_stats) {
+			after_capture = glc_state_time(gl_capture->glc);
+			video->capture_time_ns += after_capture - before_capture;
+		}
+
+		if (unlikely(ret))
+			goto cancel;
+
+		if (repeat) {
+			/* same picture as the last one, send a repeat instead */
+			ps_packet_cancel(&video->packet);
+			ret = gl_capture_write_repeat(gl_capture, video, &video->packet, now,
+						      !(gl_capture->flags & GL_CAPTURE_LOCK_FPS) &&
+						      !(gl_capture->flags & GL_CAPTURE_IGNORE_TIME));
+			if (ret == EBUSY)
+				ret = 0;
+		} else {
+			ps_packet_close(&video->packet);
+			glc_trace_instant(gl_capture->glc, "commit", now);
+			GLC_PROBE3(frame_capture, video->id, now, 0);
+		}
+	}
+	video->num_frames_started++;
+	if (!video->readback)
+		video->num_captured_frames++;
 	now = glc_state_time(gl_capture->glc);
 
 	if (unlikely((gl_capture->flags & GL_CAPTURE_LOCK_FPS) &&
@@ -1008,11 +2638,15 @@ int gl_capture_frame(gl_capture_t gl_capture, Display *dpy, GLXDrawable drawable
 
 	/* increment by 1/fps seconds */
 	video->last += gl_capture->fps_period;
-	if (video->num_captured_frames%gl_capture->fps_rem_period == 0)
+	if (video->num_frames_started%gl_capture->fps_rem_period == 0)
 		video->last += gl_capture->fps_rem;
 
 finish:
-	gl_capture_release_video_stream(video);
+	if (video->gather_stats)
+		gl_capture_account_swap(video, glc_state_time(gl_capture->glc) -
+					swap_start);
+	glc_trace_end(gl_capture->glc, "swap", trace_begin, frame);
+	gl_capture_leave_frame(gl_capture);
 	if (unlikely(ret != 0))
 		gl_capture_error(gl_capture, ret);
 
@@ -1026,11 +2660,41 @@ cancel:
 		glc_log(gl_capture->glc, GLC_INFO, "gl_capture",
 			"dropped frame #%u, buffer not ready",
 			video->num_frames);
+		GLC_PROBE3(frame_drop, video->id, video->num_frames, "buffer not ready");
 	}
 	ps_packet_cancel(&video->packet);
 	goto finish;
 }
 
+int gl_capture_get_stats(gl_capture_t gl_capture, gl_capture_stats_t *stats,
+			 size_t *count)
+{
+	struct gl_capture_video_stream_s *video;
+	glc_utime_t now = glc_state_time(gl_capture->glc);
+	size_t n = 0;
+
+	/* streams are only added, at the head, until gl_capture_destroy() */
+	for (video = gl_capture->video; video; video = video->next, n++) {
+		if (n >= *count)
+			continue;
+
+		stats[n].id       = video->id;
+		stats[n].w        = video->ow;
+		stats[n].h        = video->oh;
+		stats[n].frames   = video->num_frames;
+		stats[n].captured = video->num_captured_frames;
+		stats[n].repeated = video->num_repeated_frames;
+		stats[n].dropped  = video->num_frames - video->num_frames_started;
+		stats[n].fps      = 0;
+		if ((video->num_frames) && (now > video->first_frame))
+			stats[n].fps = stats[n].captured * 1000000000.0 /
+				       (now - video->first_frame);
+	}
+
+	*count = n;
+	return 0;
+}
+
 int gl_capture_refresh_color_correction(gl_capture_t gl_capture)
 {
 	struct gl_capture_video_stream_s *video;
@@ -1101,6 +2765,88 @@ err:
 	return ret;
 }
 
+int gl_capture_resize_window(gl_capture_t gl_capture, Display *dpy,
+			     Window window, unsigned int w, unsigned int h)
+{
+	struct gl_capture_video_stream_s *video;
+
+	for (video = gl_capture->video; video != NULL; video = video->next) {
+		if ((video->dpy != dpy) ||
+		    ((video->drawable != window) && (video->attribWin != window)))
+			continue;
+
+		/* picked up by gl_capture_update_video_stream() on next frame */
+		__sync_lock_test_and_set(&video->window_geometry,
+					 ((uint64_t) w << 32) | h);
+	}
+
+	return 0;
+}
+
+int gl_capture_track_context(gl_capture_t gl_capture, GLXContext ctx)
+{
+	struct gl_capture_context_s *context = NULL;
+
+	if (ctx) {
+		pthread_mutex_lock(&gl_capture->mutex);
+		for (context = gl_capture->context; context != NULL; context = context->next) {
+			if (context->ctx == ctx)
+				break;
+		}
+
+		if ((context == NULL) &&
+		    ((context = (struct gl_capture_context_s *)
+		      calloc(1, sizeof(struct gl_capture_context_s))))) {
+			context->ctx = ctx;
+			context->next = gl_capture->context;
+			gl_capture->context = context;
+		}
+		pthread_mutex_unlock(&gl_capture->mutex);
+	}
+
+	/* an untracked context has its read buffer queried on each frame */
+	gl_capture_current_context = context;
+	return ((ctx) && (!context)) ? ENOMEM : 0;
+}
+
+int gl_capture_track_destroy_context(gl_capture_t gl_capture, GLXContext ctx)
+{
+	struct gl_capture_context_s *context;
+
+	/*
+	 * Entries are kept, another thread may still have the context
+	 * current, but a new context at the same address starts over.
+	 */
+	pthread_mutex_lock(&gl_capture->mutex);
+	for (context = gl_capture->context; context != NULL; context = context->next) {
+		if (context->ctx == ctx) {
+			context->read_framebuffer = 0;
+			context->read_buffer = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&gl_capture->mutex);
+
+	return 0;
+}
+
+int gl_capture_track_read_framebuffer(gl_capture_t gl_capture, GLuint framebuffer)
+{
+	if (gl_capture_current_context)
+		gl_capture_current_context->read_framebuffer = framebuffer;
+	return 0;
+}
+
+int gl_capture_track_read_buffer(gl_capture_t gl_capture, GLenum buffer)
+{
+	struct gl_capture_context_s *context = gl_capture_current_context;
+
+	/* framebuffer objects have a read buffer of their own */
+	if ((context) && (!context->read_framebuffer))
+		context->read_buffer = buffer;
+	return 0;
+}
+
 int gl_capture_set_attribute_window(gl_capture_t gl_capture, Display *dpy,
 				    GLXDrawable drawable, Window window)
 {
@@ -20,6 +20,7 @@
 #include <GL/glx.h>
 #include <packetstream.h>
 #include <glc/common/glc.h>
+#include <glc/core/ycbcr.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -84,6 +85,89 @@ __PUBLIC int gl_capture_set_pack_alignment(gl_capture_t gl_capture,
  */
 __PUBLIC int gl_capture_try_pbo(gl_capture_t gl_capture, int try_pbo);
 
+/**
+ * \brief set number of PBO transfers in flight per video stream
+ *
+ * Each captured frame is read asynchronously into its own PBO and
+ * written out only once the transfer has completed. If every PBO is
+ * busy, the frame is dropped instead of stalling the application.
+ * Default depth is 3.
+ * \param gl_capture gl_capture object
+ * \param depth number of PBO, 1 to 16
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_set_pbo_depth(gl_capture_t gl_capture, unsigned int depth);
+
+/**
+ * \brief convert frames to Y'CbCr 420jpeg while writing them
+ *
+ * BGR(A) frames are converted, and scaled if ycbcr is set to,
+ * straight from the mapped PBO into the target buffer. This
+ * replaces an intermediate buffer and a ycbcr process, saving
+ * a full pass over every frame. The pixel format should be
+ * GL_BGRA. GPU conversion takes precedence when enabled.
+ * \param gl_capture gl_capture object
+ * \param ycbcr initialized ycbcr object, NULL disables conversion
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_set_ycbcr(gl_capture_t gl_capture, ycbcr_t ycbcr);
+
+/**
+ * \brief collect PBO transfers in a dedicated thread
+ *
+ * The thread binds its own GLX context, sharing objects with the
+ * application context, and waits on the transfer fences so that
+ * the swap only pays for starting the transfer. This requires PBO,
+ * GL_ARB_sync and pbuffer support, frames are collected at swap
+ * otherwise.
+ * \param gl_capture gl_capture object
+ * \param thread 1 means gl_capture tries a readback thread, 0 disables it
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_readback_thread(gl_capture_t gl_capture, int thread);
+
+/**
+ * \brief replace frames identical to the previous one by a repeat message
+ *
+ * Every frame is hashed once it has been read back. When the hash
+ * matches the last frame written, a GLC_MESSAGE_VIDEO_REPEAT carrying
+ * only the stream id and time is sent instead of the picture.
+ * \param gl_capture gl_capture object
+ * \param skip 1 means duplicate frames are skipped, 0 disables it
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_skip_duplicates(gl_capture_t gl_capture, int skip);
+
+/**
+ * \brief convert frames to Y'CbCr 420jpeg on the GPU
+ *
+ * Capture area is rendered through a small shader into planar
+ * Y', Cb and Cr framebuffers which are read back instead of BGRA.
+ * This requires OpenGL 2.0 and GL_ARB_framebuffer_object. If they
+ * are not available, frames are captured using the pixel format.
+ * Unlike the plain and PBO readbacks, this path still saves and
+ * restores the application state with glGetIntegerv() and
+ * glPushAttrib(GL_ALL_ATTRIB_BITS) on every frame.
+ * \param gl_capture gl_capture object
+ * \param convert 1 means gl_capture tries GPU conversion, 0 disables it
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_convert_ycbcr(gl_capture_t gl_capture, int convert);
+
+/**
+ * \brief scale frames on the GPU
+ *
+ * Capture area is resized with a linear filtered glBlitFramebuffer()
+ * and only the scaled image is read back. This requires
+ * GL_ARB_framebuffer_object, frames are captured unscaled otherwise.
+ * Like GPU conversion, this path still queries and pushes the
+ * application state on every frame.
+ * \param gl_capture gl_capture object
+ * \param scale scale factor, 1.0 disables GPU scaling
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_set_scale(gl_capture_t gl_capture, double scale);
+
 /**
  * \brief set pixel format
  *
@@ -187,6 +271,39 @@ __PUBLIC int gl_capture_destroy(gl_capture_t gl_capture);
  */
 __PUBLIC int gl_capture_frame(gl_capture_t gl_capture, Display *dpy, GLXDrawable drawable);
 
+/**
+ * \brief video stream counters
+ */
+typedef struct {
+	/** stream id */
+	glc_stream_id_t id;
+	/** size of the frames written to the stream */
+	unsigned int w, h;
+	/** frames due at the capture fps */
+	unsigned int frames;
+	/** frames written to the stream */
+	unsigned int captured;
+	/** frames written as a repeat of the previous one */
+	unsigned int repeated;
+	/** frames skipped because the buffer or the PBO ring was full */
+	unsigned int dropped;
+	/** frames written per second since the first one */
+	double fps;
+} gl_capture_stats_t;
+
+/**
+ * \brief get video stream counters
+ *
+ * Safe to call from any thread while gl_capture is alive.
+ * \param gl_capture gl_capture object
+ * \param stats returned counters, one per video stream
+ * \param count size of stats on input, number of video streams
+ *              on return, which can be larger than the size of stats
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_get_stats(gl_capture_t gl_capture, gl_capture_stats_t *stats,
+				  size_t *count);
+
 /**
  * \brief refresh color correction information
  * \param gl_capture gl_capture object
@@ -194,6 +311,67 @@ __PUBLIC int gl_capture_frame(gl_capture_t gl_capture, Display *dpy, GLXDrawable
  */
 __PUBLIC int gl_capture_refresh_color_correction(gl_capture_t gl_capture);
 
+/**
+ * \brief report a new window size
+ *
+ * Asking the X server for the window size on every frame is a
+ * round-trip in the rendering thread. Feed ConfigureNotify events
+ * seen by the application here and the size is taken from them.
+ * Until one has been reported, the size is polled once per second.
+ * \param gl_capture gl_capture object
+ * \param dpy X Display
+ * \param window window, either the drawable or its attribute window
+ * \param w new width
+ * \param h new height
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_resize_window(gl_capture_t gl_capture, Display *dpy,
+				      Window window, unsigned int w, unsigned int h);
+
+/**
+ * \brief report the context made current in the calling thread
+ *
+ * Querying GL_READ_BUFFER around each readback is a synchronous
+ * driver call. The read buffer is tracked per context instead, from
+ * the calls reported with gl_capture_track_*(), and only queried the
+ * first time a context is captured. A thread that never reported its
+ * context has it queried on every frame.
+ * \param gl_capture gl_capture object
+ * \param ctx context now current, NULL for none
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_track_context(gl_capture_t gl_capture, GLXContext ctx);
+
+/**
+ * \brief report a context about to be destroyed
+ * \param gl_capture gl_capture object
+ * \param ctx context
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_track_destroy_context(gl_capture_t gl_capture,
+					      GLXContext ctx);
+
+/**
+ * \brief report a read framebuffer binding of the current context
+ *
+ * Call for GL_FRAMEBUFFER and GL_READ_FRAMEBUFFER bindings. While an
+ * application framebuffer object is bound for reading, the read buffer
+ * is queried on every frame.
+ * \param gl_capture gl_capture object
+ * \param framebuffer framebuffer object, 0 for the default framebuffer
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_track_read_framebuffer(gl_capture_t gl_capture,
+					       GLuint framebuffer);
+
+/**
+ * \brief report a glReadBuffer() call in the current context
+ * \param gl_capture gl_capture object
+ * \param buffer new read buffer
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int gl_capture_track_read_buffer(gl_capture_t gl_capture, GLenum buffer);
+
 /**
  * \brief set attribute window for drawable
  *
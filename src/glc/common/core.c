@@ -33,21 +33,43 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <ctype.h>
 
 #include "glc.h"
 #include "core.h"
 #include "log.h"
 #include "util.h"
+#include "trace.h"
 #include "optimization.h"
 
+/* GLC_AFFINITY and GLC_SCHED settings of one stage */
+struct glc_stage_s {
+	char *name;
+	int has_cpus;
+	cpu_set_t cpus;
+	glc_sched_t sched;
+	struct glc_stage_s *next;
+};
+
 struct glc_core_s {
 	struct timespec init_time;
 	long int single_process_num;
 	long int multi_process_num;
 	long int threads_hint;
+	long int slice_threads;
 	int      allow_rt;
+	glc_utime_t stats_interval;
+	struct glc_stage_s *stages;
 };
 
+static struct glc_stage_s *glc_stage_find(glc_t *glc, const char *name,
+					  size_t len);
+static int glc_stage_get(glc_t *glc, const char *name, size_t len,
+			 struct glc_stage_s **stage);
+static int glc_parse_stage(const char **spec, const char **name, size_t *len);
+static int glc_parse_cpus(const char **spec, cpu_set_t *cpus);
+static int glc_parse_sched(const char **spec, glc_sched_t *sched);
+
 const char *glc_version()
 {
 	return GLC_VERSION;
@@ -62,12 +84,14 @@ int glc_init(glc_t *glc)
 	glc->state = NULL;
 	glc->util  = NULL;
 	glc->log   = NULL;
+	glc->trace = NULL;
 
 	glc->core = (glc_core_t) calloc(1, sizeof(struct glc_core_s));
 
 	clock_gettime(CLOCK_MONOTONIC, &glc->core->init_time);
 
 	glc->core->threads_hint = 1; /* safe conservative default value */
+	glc->core->slice_threads = 1; /* frames are not split by default */
 
 	if (unlikely((ret = glc_log_init(glc))))
 		return ret;
@@ -77,9 +101,18 @@ int glc_init(glc_t *glc)
 
 int glc_destroy(glc_t *glc)
 {
+	struct glc_stage_s *del;
+
+	glc_trace_close(glc);
 	glc_util_destroy(glc);
 	glc_log_destroy(glc);
 
+	while (glc->core->stages != NULL) {
+		del = glc->core->stages;
+		glc->core->stages = del->next;
+		free(del->name);
+		free(del);
+	}
 	free(glc->core);
 
 	/* and clear */
@@ -121,6 +154,19 @@ int glc_set_threads_hint(glc_t *glc, long int count)
 	return 0;
 }
 
+long int glc_slice_threads(glc_t *glc)
+{
+	return glc->core->slice_threads;
+}
+
+int glc_set_slice_threads(glc_t *glc, long int count)
+{
+	if (unlikely(count <= 0))
+		return EINVAL;
+	glc->core->slice_threads = count;
+	return 0;
+}
+
 void glc_account_threads(glc_t *glc, long int single, long int multi)
 {
 	glc->core->single_process_num += single;
@@ -154,4 +200,224 @@ int glc_allow_rt(glc_t *glc)
 	return glc->core->allow_rt;
 }
 
+glc_utime_t glc_stats_interval(glc_t *glc)
+{
+	return glc->core->stats_interval;
+}
+
+void glc_set_stats_interval(glc_t *glc, glc_utime_t interval)
+{
+	glc->core->stats_interval = interval;
+}
+
+struct glc_stage_s *glc_stage_find(glc_t *glc, const char *name, size_t len)
+{
+	struct glc_stage_s *stage = glc->core->stages;
+
+	while ((stage != NULL) &&
+	       ((strlen(stage->name) != len) || (strncmp(stage->name, name, len))))
+		stage = stage->next;
+
+	return stage;
+}
+
+int glc_stage_get(glc_t *glc, const char *name, size_t len,
+		  struct glc_stage_s **stage)
+{
+	if ((*stage = glc_stage_find(glc, name, len)))
+		return 0;
+
+	if (unlikely(!(*stage = calloc(1, sizeof(struct glc_stage_s)))))
+		return ENOMEM;
+	if (unlikely(!((*stage)->name = strndup(name, len)))) {
+		free(*stage);
+		return ENOMEM;
+	}
+
+	(*stage)->next = glc->core->stages;
+	glc->core->stages = *stage;
+	return 0;
+}
+
+/* reads "name:" and leaves spec after the colon */
+int glc_parse_stage(const char **spec, const char **name, size_t *len)
+{
+	const char *colon = strchr(*spec, ':');
+
+	if (unlikely((colon == NULL) || (colon == *spec) ||
+		     (memchr(*spec, ',', colon - *spec))))
+		return EINVAL;
+
+	*name = *spec;
+	*len = colon - *spec;
+	*spec = colon + 1;
+	return 0;
+}
+
+/*
+ * Reads a cpu list such as "0,2,4-7". A comma followed by a digit
+ * continues the list, anything else after it starts the next stage.
+ */
+int glc_parse_cpus(const char **spec, cpu_set_t *cpus)
+{
+	unsigned long first, last;
+	char *end;
+
+	CPU_ZERO(cpus);
+	for (;;) {
+		if (unlikely(!isdigit(**spec)))
+			return EINVAL;
+		first = last = strtoul(*spec, &end, 10);
+		if (*end == '-') {
+			if (unlikely(!isdigit(end[1])))
+				return EINVAL;
+			last = strtoul(end + 1, &end, 10);
+		}
+		if (unlikely((first > last) || (last >= CPU_SETSIZE)))
+			return EINVAL;
+		for (; first <= last; first++)
+			CPU_SET(first, cpus);
+
+		*spec = end;
+		if ((**spec != ',') || (!isdigit((*spec)[1])))
+			return 0;
+		(*spec)++;
+	}
+}
+
+/* reads nice=N, rr=PRIO or deadline=RUNTIME/DEADLINE/PERIOD */
+int glc_parse_sched(const char **spec, glc_sched_t *sched)
+{
+	unsigned long long runtime, deadline, period;
+	long value;
+	char *end;
+
+	memset(sched, 0, sizeof(glc_sched_t));
+
+	if (!strncmp(*spec, "nice=", 5)) {
+		value = strtol(*spec + 5, &end, 10);
+		if (unlikely((end == *spec + 5) || (value < -20) || (value > 19)))
+			return EINVAL;
+		sched->policy = GLC_SCHED_NICE;
+		sched->value = value;
+	} else if (!strncmp(*spec, "rr=", 3)) {
+		value = strtol(*spec + 3, &end, 10);
+		if (unlikely((end == *spec + 3) ||
+			     (value < sched_get_priority_min(SCHED_RR)) ||
+			     (value > sched_get_priority_max(SCHED_RR))))
+			return EINVAL;
+		sched->policy = GLC_SCHED_RR;
+		sched->value = value;
+	} else if (!strncmp(*spec, "deadline=", 9)) {
+		runtime = strtoull(*spec + 9, &end, 10);
+		if (unlikely(*end != '/'))
+			return EINVAL;
+		deadline = strtoull(end + 1, &end, 10);
+		if (unlikely(*end != '/'))
+			return EINVAL;
+		period = strtoull(end + 1, &end, 10);
+		/* the kernel refuses anything else */
+		if (unlikely((!runtime) || (runtime > deadline) || (deadline > period)))
+			return EINVAL;
+		sched->policy = GLC_SCHED_DEADLINE;
+		sched->runtime = runtime * 1000;
+		sched->deadline = deadline * 1000;
+		sched->period = period * 1000;
+	} else
+		return EINVAL;
+
+	*spec = end;
+	return 0;
+}
+
+int glc_set_affinity(glc_t *glc, const char *spec)
+{
+	struct glc_stage_s *stage;
+	const char *p, *name;
+	cpu_set_t cpus;
+	size_t len;
+	int apply, ret;
+
+	/* check the whole spec before changing anything */
+	for (apply = 0; apply < 2; apply++) {
+		p = spec;
+		while (*p != '\0') {
+			if (unlikely((ret = glc_parse_stage(&p, &name, &len))))
+				return ret;
+			if (unlikely((ret = glc_parse_cpus(&p, &cpus))))
+				return ret;
+			if (unlikely((*p != '\0') && (*p++ != ',')))
+				return EINVAL;
+
+			if (!apply)
+				continue;
+			if (unlikely((ret = glc_stage_get(glc, name, len, &stage))))
+				return ret;
+			stage->has_cpus = 1;
+			memcpy(&stage->cpus, &cpus, sizeof(cpu_set_t));
+		}
+	}
+
+	return 0;
+}
+
+int glc_set_sched(glc_t *glc, const char *spec)
+{
+	struct glc_stage_s *stage;
+	const char *p, *name;
+	glc_sched_t sched;
+	size_t len;
+	int apply, ret;
+
+	for (apply = 0; apply < 2; apply++) {
+		p = spec;
+		while (*p != '\0') {
+			if (unlikely((ret = glc_parse_stage(&p, &name, &len))))
+				return ret;
+			if (unlikely((ret = glc_parse_sched(&p, &sched))))
+				return ret;
+			if (unlikely((*p != '\0') && (*p++ != ',')))
+				return EINVAL;
+
+			if (!apply)
+				continue;
+			if (unlikely((ret = glc_stage_get(glc, name, len, &stage))))
+				return ret;
+			memcpy(&stage->sched, &sched, sizeof(glc_sched_t));
+		}
+	}
+
+	return 0;
+}
+
+int glc_stage_affinity(glc_t *glc, const char *stage, cpu_set_t *cpus)
+{
+	struct glc_stage_s *found = NULL;
+
+	if (stage != NULL)
+		found = glc_stage_find(glc, stage, strlen(stage));
+	if ((found == NULL) || (!found->has_cpus))
+		found = glc_stage_find(glc, "*", 1);
+	if ((found == NULL) || (!found->has_cpus))
+		return ENOENT;
+
+	memcpy(cpus, &found->cpus, sizeof(cpu_set_t));
+	return 0;
+}
+
+int glc_stage_sched(glc_t *glc, const char *stage, glc_sched_t *sched)
+{
+	struct glc_stage_s *found = NULL;
+
+	if (stage != NULL)
+		found = glc_stage_find(glc, stage, strlen(stage));
+	if ((found == NULL) || (found->sched.policy == GLC_SCHED_DEFAULT))
+		found = glc_stage_find(glc, "*", 1);
+	if ((found == NULL) || (found->sched.policy == GLC_SCHED_DEFAULT))
+		return ENOENT;
+
+	memcpy(sched, &found->sched, sizeof(glc_sched_t));
+	return 0;
+}
+
 /**  \} */
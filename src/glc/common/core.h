@@ -33,6 +33,7 @@
 #ifndef _CORE_H
 #define _CORE_H
 
+#include <sched.h>
 #include <glc/common/glc.h>
 
 #ifdef __cplusplus
@@ -97,6 +98,25 @@ __PUBLIC long int glc_threads_hint(glc_t *glc);
  */
 __PUBLIC int glc_set_threads_hint(glc_t *glc, long int count);
 
+/**
+ * \brief slice thread count
+ *
+ * Filters that can split a frame's rows across several threads
+ * (glc_thread_slice()) use this many threads per frame. Default
+ * value is 1, which processes each frame in a single thread.
+ * \param glc glc
+ * \return slice thread count
+ */
+__PUBLIC long int glc_slice_threads(glc_t *glc);
+
+/**
+ * \brief set slice thread count
+ * \param glc glc
+ * \param count threads working on one frame
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int glc_set_slice_threads(glc_t *glc, long int count);
+
 __PUBLIC void glc_account_threads(glc_t *glc, long int single, long int multi);
 
 __PUBLIC void glc_compute_threads_hint(glc_t *glc);
@@ -104,6 +124,96 @@ __PUBLIC void glc_compute_threads_hint(glc_t *glc);
 __PUBLIC void glc_set_allow_rt(glc_t *glc, int allow);
 __PUBLIC int glc_allow_rt(glc_t *glc);
 
+/**
+ * \brief interval between stage statistics reports
+ *
+ * With GLC_PERF logging, every glc_thread stage keeps histograms
+ * of its wait and processing times. They are logged when the stage
+ * finishes and, if the interval is not 0, also that often while it
+ * runs. Default value is 0.
+ * \param glc glc
+ * \return interval in nanoseconds
+ */
+__PUBLIC glc_utime_t glc_stats_interval(glc_t *glc);
+
+/**
+ * \brief set interval between stage statistics reports
+ * \param glc glc
+ * \param interval interval in nanoseconds, 0 reports only at close
+ */
+__PUBLIC void glc_set_stats_interval(glc_t *glc, glc_utime_t interval);
+
+/** keep the default policy (SCHED_RR if rt is asked and allowed) */
+#define GLC_SCHED_DEFAULT                0
+/** SCHED_OTHER with a nice value */
+#define GLC_SCHED_NICE                   1
+/** SCHED_RR with a priority */
+#define GLC_SCHED_RR                     2
+/** SCHED_DEADLINE with runtime, deadline and period */
+#define GLC_SCHED_DEADLINE               3
+
+/**
+ * \brief scheduling policy of a stage
+ */
+typedef struct {
+	/** GLC_SCHED_* */
+	int policy;
+	/** nice value or SCHED_RR priority */
+	int value;
+	/** SCHED_DEADLINE runtime in nanoseconds */
+	glc_utime_t runtime;
+	/** SCHED_DEADLINE relative deadline in nanoseconds */
+	glc_utime_t deadline;
+	/** SCHED_DEADLINE period in nanoseconds */
+	glc_utime_t period;
+} glc_sched_t;
+
+/**
+ * \brief set cpu affinity of stages
+ *
+ * spec is a comma separated list of stage:cpus entries, where cpus
+ * is a list of cpu numbers and ranges, for instance
+ * "pack:4-7,sink:3,audio:2". The stage "*" applies to every thread
+ * without an entry of its own. Stage names are the ones threads give
+ * in glc_thread_t.name.
+ * \param glc glc
+ * \param spec affinity specification
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int glc_set_affinity(glc_t *glc, const char *spec);
+
+/**
+ * \brief set scheduling policy of stages
+ *
+ * spec is a comma separated list of stage:policy entries, where
+ * policy is nice=N (SCHED_OTHER), rr=PRIO (SCHED_RR) or
+ * deadline=RUNTIME/DEADLINE/PERIOD (SCHED_DEADLINE, in microseconds),
+ * for instance "pack:nice=5,audio:rr=10". A policy given here
+ * replaces the one glc_set_allow_rt() would pick.
+ * \param glc glc
+ * \param spec scheduling specification
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int glc_set_sched(glc_t *glc, const char *spec);
+
+/**
+ * \brief get the cpu affinity of a stage
+ * \param glc glc
+ * \param stage stage name, NULL for an unnamed thread
+ * \param cpus returned cpu set
+ * \return 0 on success, ENOENT if no affinity applies to the stage
+ */
+__PUBLIC int glc_stage_affinity(glc_t *glc, const char *stage, cpu_set_t *cpus);
+
+/**
+ * \brief get the scheduling policy of a stage
+ * \param glc glc
+ * \param stage stage name, NULL for an unnamed thread
+ * \param sched returned policy
+ * \return 0 on success, ENOENT if no policy applies to the stage
+ */
+__PUBLIC int glc_stage_sched(glc_t *glc, const char *stage, glc_sched_t *sched);
+
 #ifdef __cplusplus
 }
 #endif
@@ -118,6 +118,8 @@ typedef struct glc_util_s* glc_util_t;
 typedef struct glc_log_s* glc_log_t;
 /** glc state */
 typedef struct glc_state_s* glc_state_t;
+/** glc trace */
+typedef struct glc_trace_s* glc_trace_t;
 
 /**
  * \brief glc structure
@@ -133,6 +135,8 @@ typedef struct {
 	glc_state_t state;
 	/** state flags */
 	glc_flags_t state_flags;
+	/** trace internal state, NULL unless tracing */
+	glc_trace_t trace;
 } glc_t;
 
 /** error */
@@ -208,6 +212,16 @@ typedef u_int8_t glc_message_type_t;
 #define GLC_MESSAGE_LZJB               0x0a
 /** callback request */
 #define GLC_CALLBACK_REQUEST           0x0b
+/** previous video frame is shown again, carries glc_video_frame_header_t */
+#define GLC_MESSAGE_VIDEO_REPEAT       0x0c
+/** tile delta coded video frame */
+#define GLC_MESSAGE_DELTA              0x0d
+/** lz4-compressed packet, lz4 and lz4-hc share the format */
+#define GLC_MESSAGE_LZ4                0x0e
+/** zstd-compressed packet */
+#define GLC_MESSAGE_ZSTD               0x0f
+/** packet compressed in independent chunks */
+#define GLC_MESSAGE_CHUNKED            0x10
 
 /**
  * \brief stream message header
@@ -247,6 +261,110 @@ typedef struct {
 	glc_message_header_t header;
 } __attribute__((packed)) glc_lzjb_header_t;
 
+/**
+ * \brief lz4-compressed message header
+ */
+typedef struct {
+	/** uncompressed data size */
+	glc_size_t size;
+	/** original message header */
+	glc_message_header_t header;
+} __attribute__((packed)) glc_lz4_header_t;
+
+/**
+ * \brief zstd-compressed message header
+ */
+typedef struct {
+	/** uncompressed data size */
+	glc_size_t size;
+	/** original message header */
+	glc_message_header_t header;
+} __attribute__((packed)) glc_zstd_header_t;
+
+/** maximum number of planes in a delta coded frame */
+#define GLC_DELTA_MAX_PLANES            3
+
+/**
+ * \brief plane layout of a delta coded frame
+ *
+ * Planes follow each other in the frame, each one is stride * height
+ * bytes long.
+ */
+typedef struct {
+	/** bytes per row, excluding padding */
+	u_int32_t width;
+	/** rows */
+	u_int32_t height;
+	/** bytes between two rows */
+	u_int32_t stride;
+} __attribute__((packed)) glc_delta_plane_t;
+
+/**
+ * \brief tile delta coded message header
+ *
+ * Planes are cut in tile_width x tile_height byte tiles, scanned row by
+ * row. The payload, compressed using compression, is the original
+ * glc_video_frame_header_t followed either by the whole frame for a
+ * keyframe or by a bitmap of the changed tiles and their content.
+ * Unchanged tiles are taken from the previous frame of the same stream.
+ */
+typedef struct {
+	/** rebuilt message size */
+	glc_size_t size;
+	/** original message header */
+	glc_message_header_t header;
+	/** stream identifier */
+	glc_stream_id_t id;
+	/** flags */
+	glc_flags_t flags;
+	/** compression message type, 0 if stored */
+	glc_message_type_t compression;
+	/** uncompressed payload size */
+	glc_size_t delta_size;
+	/** tile width in bytes */
+	u_int16_t tile_width;
+	/** tile height in rows */
+	u_int16_t tile_height;
+	/** number of planes */
+	u_int8_t planes;
+	/** plane layout */
+	glc_delta_plane_t plane[GLC_DELTA_MAX_PLANES];
+} __attribute__((packed)) glc_delta_header_t;
+
+/**
+ * \brief chunked message header
+ *
+ * The original message is cut in chunks of chunk_size bytes, the last
+ * one being shorter, each compressed on its own using compression so
+ * they can be packed and unpacked concurrently. The header is followed
+ * by a glc_chunk_t per chunk, then by the compressed chunks.
+ */
+typedef struct {
+	/** uncompressed message size */
+	glc_size_t size;
+	/** original message header */
+	glc_message_header_t header;
+	/** compression message type */
+	glc_message_type_t compression;
+	/** uncompressed chunk size */
+	u_int32_t chunk_size;
+	/** number of chunks */
+	u_int32_t chunks;
+} __attribute__((packed)) glc_chunked_header_t;
+
+/**
+ * \brief chunk offset table entry
+ */
+typedef struct {
+	/** offset from the first compressed chunk */
+	glc_size_t offset;
+	/** compressed size */
+	glc_size_t size;
+} __attribute__((packed)) glc_chunk_t;
+
+/** payload holds the whole frame */
+#define GLC_DELTA_KEYFRAME              0x1
+
 /** video format type */
 typedef u_int8_t glc_video_format_t;
 /** 24bit BGR, last row first */
@@ -278,6 +396,8 @@ typedef struct {
 #define GLC_VIDEO_DWORD_ALIGNED         0x1
 #define GLC_VIDEO_CAPTURING             0x2
 #define GLC_VIDEO_NEED_COLOR_UPDATE     0x4
+/** stream may contain GLC_MESSAGE_VIDEO_REPEAT messages */
+#define GLC_VIDEO_REPEATS               0x8
 
 /**
  * \brief video data header
@@ -0,0 +1,128 @@
+/**
+ * \file glc/common/histogram.c
+ * \brief latency histograms
+ * \author Olivier Langlois <olivier@trillion01.com>
+ * \date 2014
+
+    Copyright 2014 Olivier Langlois
+
+    This file is part of glcs.
+
+    glcs is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    glcs is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with glcs.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/**
+ * \addtogroup histogram
+ *  \{
+ */
+
+#include <inttypes.h>
+
+#include "glc.h"
+#include "log.h"
+#include "histogram.h"
+#include "optimization.h"
+
+#define GLC_HISTOGRAM_SUB_COUNT (1 << GLC_HISTOGRAM_SUB_BITS)
+
+static unsigned int glc_histogram_bucket(uint64_t value);
+static uint64_t glc_histogram_bucket_max(unsigned int bucket);
+
+/*
+ * Values below GLC_HISTOGRAM_SUB_COUNT get a bucket each. Above, the
+ * bucket is picked by the position of the highest bit and the next
+ * GLC_HISTOGRAM_SUB_BITS bits.
+ */
+unsigned int glc_histogram_bucket(uint64_t value)
+{
+	unsigned int msb;
+
+	if (value < GLC_HISTOGRAM_SUB_COUNT)
+		return value;
+
+	msb = 63 - __builtin_clzll(value);
+	return ((msb - GLC_HISTOGRAM_SUB_BITS + 1) << GLC_HISTOGRAM_SUB_BITS) +
+	       ((value >> (msb - GLC_HISTOGRAM_SUB_BITS)) & (GLC_HISTOGRAM_SUB_COUNT - 1));
+}
+
+uint64_t glc_histogram_bucket_max(unsigned int bucket)
+{
+	unsigned int shift;
+	uint64_t sub;
+
+	if (bucket < GLC_HISTOGRAM_SUB_COUNT)
+		return bucket;
+
+	shift = (bucket >> GLC_HISTOGRAM_SUB_BITS) - 1;
+	sub = GLC_HISTOGRAM_SUB_COUNT + (bucket & (GLC_HISTOGRAM_SUB_COUNT - 1));
+	return ((sub + 1) << shift) - 1;
+}
+
+void glc_histogram_add(glc_histogram_t *hist, uint64_t value)
+{
+	uint64_t max;
+
+	__sync_fetch_and_add(&hist->count[glc_histogram_bucket(value)], 1);
+	__sync_fetch_and_add(&hist->samples, 1);
+
+	max = hist->max;
+	while ((value > max) &&
+	       (!__sync_bool_compare_and_swap(&hist->max, max, value)))
+		max = hist->max;
+}
+
+uint64_t glc_histogram_percentile(glc_histogram_t *hist, double percentile)
+{
+	uint64_t rank, seen = 0;
+	unsigned int bucket;
+
+	if (unlikely(!hist->samples))
+		return 0;
+
+	/* rank of the sample, counting from 1 */
+	rank = (uint64_t) (percentile / 100.0 * hist->samples + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	for (bucket = 0; bucket < GLC_HISTOGRAM_BUCKETS; bucket++) {
+		seen += hist->count[bucket];
+		if (seen >= rank)
+			break;
+	}
+
+	/* concurrent adds may leave samples ahead of the buckets */
+	if (bucket == GLC_HISTOGRAM_BUCKETS)
+		return hist->max;
+	if (glc_histogram_bucket_max(bucket) > hist->max)
+		return hist->max;
+	return glc_histogram_bucket_max(bucket);
+}
+
+void glc_histogram_log(glc_t *glc, const char *module, const char *name,
+		       glc_histogram_t *hist)
+{
+	if (!hist->samples)
+		return;
+
+	glc_log(glc, GLC_PERF, module,
+		"  %-10s %10" PRIu64 " samples, p50 %9.1f, p99 %9.1f, p99.9 %9.1f, max %9.1f usec",
+		name, hist->samples,
+		glc_histogram_percentile(hist, 50.0) / 1000.0,
+		glc_histogram_percentile(hist, 99.0) / 1000.0,
+		glc_histogram_percentile(hist, 99.9) / 1000.0,
+		hist->max / 1000.0);
+}
+
+/**  \} */
@@ -0,0 +1,102 @@
+/**
+ * \file glc/common/histogram.h
+ * \brief latency histograms
+ * \author Olivier Langlois <olivier@trillion01.com>
+ * \date 2014
+
+    Copyright 2014 Olivier Langlois
+
+    This file is part of glcs.
+
+    glcs is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    glcs is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with glcs.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/**
+ * \addtogroup common
+ *  \{
+ * \defgroup histogram histogram
+ *  \{
+ */
+
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+
+#include <stdint.h>
+#include <glc/common/glc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** sub-buckets per power of two are 2^GLC_HISTOGRAM_SUB_BITS */
+#define GLC_HISTOGRAM_SUB_BITS           4
+/** number of buckets, enough for any 64 bit value */
+#define GLC_HISTOGRAM_BUCKETS            ((64 - GLC_HISTOGRAM_SUB_BITS + 1) << \
+					  GLC_HISTOGRAM_SUB_BITS)
+
+/**
+ * \brief log-linear histogram
+ *
+ * Like HdrHistogram, each power of two is split in 16 linear
+ * sub-buckets so any recorded value is known within 1/16th. Values
+ * can be added from several threads at once. Zero the structure to
+ * initialize it.
+ */
+typedef struct {
+	/** samples per bucket */
+	uint64_t count[GLC_HISTOGRAM_BUCKETS];
+	/** number of samples */
+	uint64_t samples;
+	/** largest value seen */
+	uint64_t max;
+} glc_histogram_t;
+
+/**
+ * \brief add a value
+ * \param hist histogram
+ * \param value value
+ */
+__PUBLIC void glc_histogram_add(glc_histogram_t *hist, uint64_t value);
+
+/**
+ * \brief value at percentile
+ * \param hist histogram
+ * \param percentile percentile, between 0 and 100
+ * \return highest value of the bucket holding the percentile,
+ *         0 if the histogram is empty
+ */
+__PUBLIC uint64_t glc_histogram_percentile(glc_histogram_t *hist, double percentile);
+
+/**
+ * \brief log sample count, p50, p99, p99.9 and max
+ *
+ * Values are taken to be nanoseconds and logged in microseconds
+ * at GLC_PERF level.
+ * \param glc glc
+ * \param module module name used for logging
+ * \param name histogram name
+ * \param hist histogram
+ */
+__PUBLIC void glc_histogram_log(glc_t *glc, const char *module, const char *name,
+				glc_histogram_t *hist);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/**  \} */
+/**  \} */
@@ -32,38 +32,248 @@
 #include <string.h>
 #include <errno.h>
 #include <pthread.h>
+#include <signal.h>
+#include <time.h>
 
 #include "core.h"
 #include "log.h"
 #include "optimization.h"
 
+/** messages queued per thread, power of 2 */
+#define GLC_LOG_RING_SIZE 64
+
+/** how often the log thread writes queued messages, in nsec */
+#define GLC_LOG_DRAIN_INTERVAL 10000000
+
+struct glc_log_message_s {
+	glc_utime_t time;
+	int level;
+	const char *module;
+	char text[GLC_LOG_MESSAGE_SIZE];
+};
+
+/*
+ * Only the owning thread moves head and counts dropped messages, only
+ * the thread holding log_mutex moves tail. orphan is set when the
+ * owner exits, the ring is freed once it is empty.
+ */
+struct glc_log_ring_s {
+	unsigned long head, tail;
+	unsigned long dropped, reported;
+	int orphan;
+	struct glc_log_message_s message[GLC_LOG_RING_SIZE];
+	struct glc_log_ring_s *next;
+};
+
 struct glc_log_s {
+	glc_t *glc;
 	int level;
 	FILE *stream;
 	FILE *default_stream;
 	pthread_mutex_t log_mutex;
+
+	/* messages go through the rings while the log thread runs */
+	int async;
+	pthread_key_t ring_key;
+	struct glc_log_ring_s *rings;
+	pthread_t thread;
 };
 
-static void glc_log_write_prefix(glc_t *glc, FILE *stream, int level, const char *module);
+/* the log thread is gone in a forked child, it writes directly */
+static pthread_once_t glc_log_atfork_once = PTHREAD_ONCE_INIT;
+static int glc_log_forked = 0;
+
+static void glc_log_write_prefix(FILE *stream, glc_utime_t time, int level,
+				 const char *module);
+static void glc_log_atfork_child(void);
+static void glc_log_atfork_init(void);
+static void glc_log_ring_release(void *ptr);
+static struct glc_log_ring_s *glc_log_get_ring(glc_log_t log);
+static void glc_log_drain(glc_log_t log);
+static void *glc_log_thread(void *argptr);
 
 int glc_log_init(glc_t *glc)
 {
-	glc->log = (glc_log_t) calloc(1, sizeof(struct glc_log_s));
+	int ret;
+
+	if (unlikely(!(glc->log = (glc_log_t) calloc(1, sizeof(struct glc_log_s)))))
+		return ENOMEM;
 
 	pthread_mutex_init(&glc->log->log_mutex, NULL);
+	glc->log->glc = glc;
 	glc->log->default_stream = stderr;
 	glc->log->stream = glc->log->default_stream;
 
+	pthread_once(&glc_log_atfork_once, glc_log_atfork_init);
+	if (unlikely((ret = pthread_key_create(&glc->log->ring_key,
+					       glc_log_ring_release))))
+		return ret;
+
+	/*
+	 * Not fatal, messages are written by the caller like before. The
+	 * stages aren't configured yet so glc_simple_thread_create()
+	 * can't be used.
+	 */
+	glc->log->async = 1;
+	if (unlikely(pthread_create(&glc->log->thread, NULL, glc_log_thread,
+				    glc->log)))
+		glc->log->async = 0;
+
 	return 0;
 }
 
 int glc_log_destroy(glc_t *glc)
 {
+	struct glc_log_ring_s *ring;
+
+	if (glc->log->async) {
+		__atomic_store_n(&glc->log->async, 0, __ATOMIC_RELAXED);
+		pthread_join(glc->log->thread, NULL);
+	}
+
+	pthread_mutex_lock(&glc->log->log_mutex);
+	glc_log_drain(glc->log);
+	pthread_mutex_unlock(&glc->log->log_mutex);
+
+	pthread_key_delete(glc->log->ring_key);
+	while ((ring = glc->log->rings) != NULL) {
+		glc->log->rings = ring->next;
+		free(ring);
+	}
+
 	pthread_mutex_destroy(&glc->log->log_mutex);
 	free(glc->log);
 	return 0;
 }
 
+void glc_log_atfork_child(void)
+{
+	glc_log_forked = 1;
+}
+
+void glc_log_atfork_init(void)
+{
+	pthread_atfork(NULL, NULL, glc_log_atfork_child);
+}
+
+void glc_log_ring_release(void *ptr)
+{
+	struct glc_log_ring_s *ring = (struct glc_log_ring_s *) ptr;
+
+	__atomic_store_n(&ring->orphan, 1, __ATOMIC_RELEASE);
+}
+
+struct glc_log_ring_s *glc_log_get_ring(glc_log_t log)
+{
+	struct glc_log_ring_s *ring;
+
+	if (likely((ring = (struct glc_log_ring_s *)
+		    pthread_getspecific(log->ring_key)) != NULL))
+		return ring;
+
+	/* the first message of this thread */
+	if (unlikely(!(ring = (struct glc_log_ring_s *)
+		       calloc(1, sizeof(struct glc_log_ring_s)))))
+		return NULL;
+
+	/* lock-free push, the log thread only unlinks rings behind the head */
+	do
+		ring->next = log->rings;
+	while (!__sync_bool_compare_and_swap(&log->rings, ring->next, ring));
+
+	pthread_setspecific(log->ring_key, ring);
+	return ring;
+}
+
+/*
+ * Write queued messages, the oldest first across threads. Called with
+ * log_mutex held.
+ */
+void glc_log_drain(glc_log_t log)
+{
+	struct glc_log_ring_s *ring, *oldest, **link;
+	struct glc_log_message_s *message;
+	unsigned long dropped;
+
+	for (;;) {
+		oldest = NULL;
+		message = NULL;
+		for (ring = log->rings; ring != NULL; ring = ring->next) {
+			if (ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+				continue;
+			if ((!oldest) ||
+			    (ring->message[ring->tail & (GLC_LOG_RING_SIZE - 1)].time <
+			     message->time)) {
+				oldest = ring;
+				message = &ring->message[ring->tail & (GLC_LOG_RING_SIZE - 1)];
+			}
+		}
+		if (!oldest)
+			break;
+
+		glc_log_write_prefix(log->stream, message->time, message->level,
+				     message->module);
+		fputs(message->text, log->stream);
+		fputc('\n', log->stream);
+		__atomic_store_n(&oldest->tail, oldest->tail + 1, __ATOMIC_RELEASE);
+	}
+
+	link = &log->rings;
+	while ((ring = *link) != NULL) {
+		dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+		if (unlikely(dropped != ring->reported)) {
+			glc_log_write_prefix(log->stream, glc_time(log->glc),
+					     GLC_WARN, "log");
+			fprintf(log->stream, "%lu messages dropped, log ring full\n",
+				dropped - ring->reported);
+			ring->reported = dropped;
+		}
+
+		/* a new ring may be pushed in front of the head at any time */
+		if ((__atomic_load_n(&ring->orphan, __ATOMIC_ACQUIRE)) &&
+		    (ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) &&
+		    ((link != &log->rings) ||
+		     (__sync_bool_compare_and_swap(&log->rings, ring, ring->next)))) {
+			if (link != &log->rings)
+				*link = ring->next;
+			free(ring);
+			continue;
+		}
+		link = &ring->next;
+	}
+}
+
+void *glc_log_thread(void *argptr)
+{
+	glc_log_t log = (glc_log_t) argptr;
+	struct timespec interval = { 0, GLC_LOG_DRAIN_INTERVAL };
+	sigset_t ss;
+
+	/* signals are for the application threads */
+	sigfillset(&ss);
+	pthread_sigmask(SIG_BLOCK, &ss, NULL);
+
+	while (__atomic_load_n(&log->async, __ATOMIC_RELAXED)) {
+		nanosleep(&interval, NULL);
+
+		pthread_mutex_lock(&log->log_mutex);
+		glc_log_drain(log);
+		pthread_mutex_unlock(&log->log_mutex);
+	}
+
+	return NULL;
+}
+
+void glc_log_flush(glc_t *glc)
+{
+	if (unlikely(glc_log_forked))
+		return;
+
+	pthread_mutex_lock(&glc->log->log_mutex);
+	glc_log_drain(glc->log);
+	pthread_mutex_unlock(&glc->log->log_mutex);
+}
+
 int glc_log_open_file(glc_t *glc, const char *filename)
 {
 	int ret;
@@ -88,7 +298,12 @@ int glc_log_set_stream(glc_t *glc, FILE *stream)
 	/** \todo check that stream is good */
 	if (unlikely(!stream))
 		return EINVAL;
+
+	/* queued messages go to the previous stream */
+	pthread_mutex_lock(&glc->log->log_mutex);
+	glc_log_drain(glc->log);
 	glc->log->stream = stream;
+	pthread_mutex_unlock(&glc->log->log_mutex);
 	return 0;
 }
 
@@ -107,21 +322,32 @@ int glc_log_get_level(glc_t *glc)
 
 FILE *glc_log_get_stream(glc_t *glc)
 {
+	glc_log_flush(glc);
 	return glc->log->stream;
 }
 
 int glc_log_close(glc_t *glc)
 {
+	FILE *stream;
+
 	glc_log(glc, GLC_INFO, "log", "log closed");
-	if (unlikely(fclose(glc->log->stream)))
-		return errno;
+
+	pthread_mutex_lock(&glc->log->log_mutex);
+	glc_log_drain(glc->log);
+	stream = glc->log->stream;
 	glc->log->stream = glc->log->default_stream;
+	pthread_mutex_unlock(&glc->log->log_mutex);
 
+	if (unlikely(fclose(stream)))
+		return errno;
 	return 0;
 }
 
 void glc_log(glc_t *glc, int level, const char *module, const char *format, ...)
 {
+	struct glc_log_ring_s *ring;
+	struct glc_log_message_s *message;
+	unsigned long head;
 	va_list ap;
 
 	if (level > glc->log->level)
@@ -129,19 +355,43 @@ void glc_log(glc_t *glc, int level, const char *module, const char *format, ...)
 
 	va_start(ap, format);
 
+	if (likely(__atomic_load_n(&glc->log->async, __ATOMIC_RELAXED)) &&
+	    likely(!glc_log_forked) &&
+	    likely((ring = glc_log_get_ring(glc->log)))) {
+		head = ring->head;
+		if (unlikely(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) ==
+			     GLC_LOG_RING_SIZE)) {
+			__atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+			goto out;
+		}
+
+		message = &ring->message[head & (GLC_LOG_RING_SIZE - 1)];
+		message->time   = glc_time(glc);
+		message->level  = level;
+		message->module = module;
+		if (unlikely(vsnprintf(message->text, GLC_LOG_MESSAGE_SIZE, format, ap) >=
+			     GLC_LOG_MESSAGE_SIZE))
+			strcpy(&message->text[GLC_LOG_MESSAGE_SIZE - 4], "...");
+
+		__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+		goto out;
+	}
+
 	/* this is highly threaded application and we want
-	   non-corrupted logs */
-	pthread_mutex_lock(&glc->log->log_mutex);
-	glc_log_write_prefix(glc, glc->log->stream, level, module);
+	   non-corrupted logs, a forked child is alone */
+	if (likely(!glc_log_forked))
+		pthread_mutex_lock(&glc->log->log_mutex);
+	glc_log_write_prefix(glc->log->stream, glc_time(glc), level, module);
 	vfprintf(glc->log->stream, format, ap);
 	fputc('\n', glc->log->stream);
-
-	pthread_mutex_unlock(&glc->log->log_mutex);
-
+	if (likely(!glc_log_forked))
+		pthread_mutex_unlock(&glc->log->log_mutex);
+out:
 	va_end(ap);
 }
 
-void glc_log_write_prefix(glc_t *glc, FILE *stream, int level, const char *module)
+void glc_log_write_prefix(FILE *stream, glc_utime_t time, int level,
+			  const char *module)
 {
 	const char *level_str = NULL;
 
@@ -168,7 +418,7 @@ void glc_log_write_prefix(glc_t *glc, FILE *stream, int level, const char *modul
 	}
 
 	fprintf(stream, "[%7.2fs %10s %5s ] ",
-		(double) glc_time(glc) / 1000000000.0, module, level_str);
+		(double) time / 1000000000.0, module, level_str);
 }
 
 /**  \} */
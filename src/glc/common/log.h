@@ -41,6 +41,9 @@
 extern "C" {
 #endif
 
+/** longest message, terminating nul included */
+#define GLC_LOG_MESSAGE_SIZE 512
+
 /**
  * \brief initialize log
  * \param glc glc
@@ -67,8 +70,22 @@ __PRIVATE int glc_log_destroy(glc_t *glc);
 __PUBLIC int glc_log_set_level(glc_t *glc, int level);
 __PUBLIC int glc_log_get_level(glc_t *glc);
 
+/**
+ * \brief get log stream
+ *
+ * Queued messages are written first so that whatever the caller
+ * writes directly to the stream comes after them.
+ * \param glc glc
+ * \return log stream
+ */
 __PUBLIC FILE *glc_log_get_stream(glc_t *glc);
 
+/**
+ * \brief write queued messages now
+ * \param glc glc
+ */
+__PUBLIC void glc_log_flush(glc_t *glc);
+
 /**
  * \brief open file for log
  * \note this calls glc_log_set_stream()
@@ -103,9 +120,15 @@ __PUBLIC int glc_log_close(glc_t *glc);
  * Message is actually written to log if level is
  * lesser than, or equal to current log verbosity level and
  * logging is enabled.
+ *
+ * The message is formatted in a ring of the calling thread and
+ * written by the log thread a few milliseconds later, the caller
+ * never blocks on the stream. If the ring is full the message is
+ * dropped and the number of dropped messages is logged instead.
+ * Messages longer than GLC_LOG_MESSAGE_SIZE are truncated.
  * \param glc glc
  * \param level message level
- * \param module module
+ * \param module module, must stay valid until the message is written
  * \param format passed to fprintf()
  * \param ... passed to fprintf()
  */
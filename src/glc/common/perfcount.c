@@ -0,0 +1,137 @@
+/**
+ * \file glc/common/perfcount.c
+ * \brief hardware performance counters
+ * \author Olivier Langlois <olivier@trillion01.com>
+ * \date 2014
+
+    Copyright 2014 Olivier Langlois
+
+    This file is part of glcs.
+
+    glcs is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    glcs is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with glcs.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/**
+ * \addtogroup perfcount
+ *  \{
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+
+#include "glc.h"
+#include "log.h"
+#include "perfcount.h"
+#include "optimization.h"
+
+/* type and config of each perf event, context switches come from getrusage() */
+static const struct {
+	uint32_t type;
+	uint64_t config;
+	const char *name;
+} glc_perfcount_event[GLC_PERFCOUNT_CONTEXT_SWITCHES] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache misses"}
+};
+
+static int glc_perfcount_warned = 0;
+
+int glc_perfcount_open(glc_t *glc, glc_perfcount_t *perfcount)
+{
+	struct perf_event_attr attr;
+	int e, ret = 0;
+
+	for (e = 0; e < GLC_PERFCOUNT_EVENTS; e++)
+		perfcount->fd[e] = -1;
+
+	for (e = 0; e < GLC_PERFCOUNT_CONTEXT_SWITCHES; e++) {
+		memset(&attr, 0, sizeof(attr));
+		attr.size           = sizeof(attr);
+		attr.type           = glc_perfcount_event[e].type;
+		attr.config         = glc_perfcount_event[e].config;
+		attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED |
+				      PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv     = 1;
+
+		perfcount->fd[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+					   PERF_FLAG_FD_CLOEXEC);
+		if (likely(perfcount->fd[e] >= 0))
+			continue;
+
+		perfcount->fd[e] = -1;
+		if (ret)
+			continue;
+		ret = errno;
+
+		/* the same goes for every thread, say it once */
+		if (__sync_bool_compare_and_swap(&glc_perfcount_warned, 0, 1))
+			glc_log(glc, GLC_WARN, "perfcount",
+				"no %s counter: %s (%d)%s", glc_perfcount_event[e].name,
+				strerror(ret), ret, ((ret == EACCES) || (ret == EPERM)) ?
+				", see /proc/sys/kernel/perf_event_paranoid" : "");
+	}
+
+	return ret;
+}
+
+unsigned int glc_perfcount_read(glc_perfcount_t *perfcount,
+				uint64_t value[GLC_PERFCOUNT_EVENTS])
+{
+	/* value, time enabled, time running */
+	uint64_t data[3];
+	struct rusage usage;
+	unsigned int mask = 0;
+	int e;
+
+	for (e = 0; e < GLC_PERFCOUNT_CONTEXT_SWITCHES; e++) {
+		value[e] = 0;
+		if ((perfcount->fd[e] < 0) ||
+		    unlikely(read(perfcount->fd[e], data, sizeof(data)) != sizeof(data)))
+			continue;
+
+		if ((data[2]) && (data[2] < data[1]))
+			value[e] = (uint64_t) ((double) data[0] * data[1] / data[2]);
+		else
+			value[e] = data[0];
+		mask |= 1 << e;
+	}
+
+	value[GLC_PERFCOUNT_CONTEXT_SWITCHES] = 0;
+	if (likely(!getrusage(RUSAGE_THREAD, &usage))) {
+		value[GLC_PERFCOUNT_CONTEXT_SWITCHES] = usage.ru_nvcsw + usage.ru_nivcsw;
+		mask |= 1 << GLC_PERFCOUNT_CONTEXT_SWITCHES;
+	}
+
+	return mask;
+}
+
+void glc_perfcount_close(glc_perfcount_t *perfcount)
+{
+	int e;
+
+	for (e = 0; e < GLC_PERFCOUNT_EVENTS; e++) {
+		if (perfcount->fd[e] >= 0)
+			close(perfcount->fd[e]);
+		perfcount->fd[e] = -1;
+	}
+}
+
+/**  \} */
@@ -0,0 +1,103 @@
+/**
+ * \file glc/common/perfcount.h
+ * \brief hardware performance counters
+ * \author Olivier Langlois <olivier@trillion01.com>
+ * \date 2014
+
+    Copyright 2014 Olivier Langlois
+
+    This file is part of glcs.
+
+    glcs is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    glcs is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with glcs.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/**
+ * \addtogroup common
+ *  \{
+ * \defgroup perfcount performance counters
+ *  \{
+ */
+
+#ifndef _PERFCOUNT_H
+#define _PERFCOUNT_H
+
+#include <stdint.h>
+#include <glc/common/glc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** cpu cycles */
+#define GLC_PERFCOUNT_CYCLES             0
+/** retired instructions */
+#define GLC_PERFCOUNT_INSTRUCTIONS       1
+/** last level cache misses */
+#define GLC_PERFCOUNT_LLC_MISSES         2
+/** voluntary and involuntary context switches */
+#define GLC_PERFCOUNT_CONTEXT_SWITCHES   3
+/** number of counters */
+#define GLC_PERFCOUNT_EVENTS             4
+
+/**
+ * \brief counters of the calling thread
+ *
+ * Only user space is counted so the default perf_event_paranoid
+ * setting is enough.
+ */
+typedef struct {
+	/** perf event file descriptors, -1 if unavailable or not needed */
+	int fd[GLC_PERFCOUNT_EVENTS];
+} glc_perfcount_t;
+
+/**
+ * \brief start counting for the calling thread
+ *
+ * Counters the kernel or the cpu doesn't provide are left out, the
+ * first failure is logged once per process. Context switches are
+ * always available.
+ * \param glc glc
+ * \param perfcount counters
+ * \return 0 if every counter could be opened, otherwise the error
+ *         code of the first one that couldn't
+ */
+__PUBLIC int glc_perfcount_open(glc_t *glc, glc_perfcount_t *perfcount);
+
+/**
+ * \brief read counters
+ *
+ * Values are scaled up if the kernel had to multiplex the counters.
+ * Must be called from the thread that opened them.
+ * \param perfcount counters
+ * \param value values, indexed by GLC_PERFCOUNT_*
+ * \return bit mask of the values that were read, (1 << GLC_PERFCOUNT_*)
+ */
+__PUBLIC unsigned int glc_perfcount_read(glc_perfcount_t *perfcount,
+					 uint64_t value[GLC_PERFCOUNT_EVENTS]);
+
+/**
+ * \brief stop counting
+ * \param perfcount counters
+ */
+__PUBLIC void glc_perfcount_close(glc_perfcount_t *perfcount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/**  \} */
+/**  \} */
@@ -0,0 +1,66 @@
+/**
+ * \file glc/common/probe.h
+ * \brief USDT static probes
+ * \author Olivier Langlois <olivier@trillion01.com>
+ * \date 2014
+
+    Copyright 2014 Olivier Langlois
+
+    This file is part of glcs.
+
+    glcs is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    glcs is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with glcs.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/**
+ * \addtogroup common
+ *  \{
+ * \defgroup probe USDT probes
+ *  \{
+ */
+
+#ifndef _PROBE_H
+#define _PROBE_H
+
+/*
+ * Probes are in the glcs provider. A disabled probe is a single nop in
+ * the code, tools like bpftrace, perf or systemtap patch it when they
+ * attach. Without <sys/sdt.h> they compile to nothing.
+ *
+ *   frame_capture(id, time, repeat)  picture or repeat put in the stream
+ *   frame_drop(id, frame, reason)    picture dropped, reason is a string
+ *   packet_open(stage)               stage starts processing a packet
+ *   packet_close(stage, type, time)  stage is done with it
+ *   compress(type, in, out)          pack compressed a packet
+ *   pipe_stall(timeout)              pipe sink waits for the encoder
+ *   pipe_ready(ret)                  wait is over, 0 unless it failed
+ *   audio_handoff(id, time, size)    ALSA hook thread queued audio data
+ */
+#ifdef __USDT
+# include <sys/sdt.h>
+# define GLC_PROBE(name) DTRACE_PROBE(glcs, name)
+# define GLC_PROBE1(name, a1) DTRACE_PROBE1(glcs, name, a1)
+# define GLC_PROBE2(name, a1, a2) DTRACE_PROBE2(glcs, name, a1, a2)
+# define GLC_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(glcs, name, a1, a2, a3)
+#else
+# define GLC_PROBE(name) do { } while (0)
+# define GLC_PROBE1(name, a1) do { } while (0)
+# define GLC_PROBE2(name, a1, a2) do { } while (0)
+# define GLC_PROBE3(name, a1, a2, a3) do { } while (0)
+#endif
+
+#endif
+
+/**  \} */
+/**  \} */
@@ -33,6 +33,10 @@
 #include <pthread.h>
 #include <signal.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
 #include <packetstream.h>
 #include <errno.h>
 
@@ -42,8 +46,52 @@
 #include "util.h"
 #include "log.h"
 #include "state.h"
+#include "histogram.h"
+#include "perfcount.h"
+#include "trace.h"
+#include "probe.h"
 #include "optimization.h"
 
+/** slices are never smaller than this, except for the last one */
+#define GLC_THREAD_SLICE_MIN_ROWS 16
+
+#ifndef SCHED_DEADLINE
+# define SCHED_DEADLINE 6
+#endif
+
+/** struct sched_attr, glibc has no wrapper for sched_setattr() */
+struct glc_thread_sched_attr_s {
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t  sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+};
+
+/**
+ * \brief per-stage timings
+ *
+ * wait_in is the time spent getting the next packet from the input
+ * buffer, wait_out the time spent getting room in the output buffer
+ * and process the rest of the packet handling. A stage that drops
+ * frames upstream has a high process or wait_out time, one that is
+ * starved a high wait_in time.
+ *
+ * counter adds up the performance counters of the workers and of the
+ * slice helpers while they work for the stage, bytes the size of the
+ * packets read. Only the counters in the counters mask were available.
+ */
+struct glc_thread_stats_s {
+	glc_histogram_t wait_in, process, wait_out;
+	glc_utime_t last_report;
+	uint64_t counter[GLC_PERFCOUNT_EVENTS];
+	unsigned int counters;
+	uint64_t bytes;
+};
+
 /**
  * \brief thread private variables
  */
@@ -55,6 +103,21 @@ struct glc_thread_private_s {
 	pthread_t *pthread_thread;
 	pthread_mutex_t open, finish;
 
+	/*
+	 * Read and write threads number packets as they read them, under
+	 * the open mutex, and reserve room in the output buffer in that
+	 * order. Processing and closing the packets is done in parallel.
+	 */
+	pthread_mutex_t order;
+	pthread_cond_t turn;
+	unsigned long read_seq, write_seq;
+
+	/* holds a reference on the slice pool */
+	int pooled;
+
+	/* NULL unless logging at GLC_PERF level */
+	struct glc_thread_stats_s *stats;
+
 	glc_thread_t *thread;
 	size_t running_threads;
 
@@ -62,9 +125,162 @@ struct glc_thread_private_s {
 	int ret;
 };
 
+/**
+ * \brief rows of one packet shared through the slice pool
+ *
+ * Lives on the stack of the glc_thread_slice() caller, which
+ * doesn't return before every range is finished.
+ */
+struct glc_thread_slice_job_s {
+	glc_thread_state_t *state;
+	int (*callback)(glc_thread_state_t *, unsigned int, unsigned int);
+	unsigned int rows, step, next, finished;
+	int ret;
+	struct glc_thread_slice_job_s *next_job;
+};
+
+/**
+ * \brief process-wide slice helpers
+ *
+ * Every stage with slice_threads > 1 shares the same helpers. A
+ * helper always takes its next range from the job with the most rows
+ * left, so idle cores end up on whichever stage is behind.
+ */
+struct glc_thread_pool_s {
+	glc_t *glc;
+	pthread_mutex_t mutex;
+	pthread_cond_t work, done;
+	pthread_t *helper;
+	size_t helpers, users;
+	struct glc_thread_slice_job_s *jobs;
+	int quit;
+};
+
+static pthread_mutex_t glc_thread_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct glc_thread_pool_s *glc_thread_pool = NULL;
+
+/* counters of a slice helper, NULL in every other thread */
+static __thread glc_perfcount_t *glc_thread_helper_perfcount = NULL;
+
 static void *glc_thread(void *argptr);
+static int glc_thread_wait_turn(struct glc_thread_private_s *private,
+				unsigned long seq);
+static void glc_thread_end_turn(struct glc_thread_private_s *private);
+static void glc_thread_stats_report(struct glc_thread_private_s *private,
+				    glc_utime_t now);
+static void glc_thread_stats_log(struct glc_thread_private_s *private);
+static void glc_thread_stats_count(struct glc_thread_stats_s *stats,
+				   unsigned int mask, const uint64_t *before,
+				   const uint64_t *after);
+static void glc_thread_counters_log(struct glc_thread_private_s *private);
+static int glc_thread_pool_get(glc_t *glc, size_t helpers);
+static void glc_thread_pool_put(void);
+static void *glc_thread_pool_helper(void *argptr);
+static void glc_thread_pool_run(struct glc_thread_pool_s *pool,
+				struct glc_thread_slice_job_s *job);
+static int glc_thread_slice_run(glc_thread_state_t *state, unsigned int rows,
+				unsigned int step);
 static int glc_thread_block_signals(void);
-static int glc_thread_set_rt_priority(glc_t *glc, int ask_rt);
+static int glc_thread_set_sched(glc_t *glc, const char *name, int ask_rt);
+static int glc_thread_set_deadline(glc_sched_t *sched);
+
+/*
+ * Block until packets read before seq have reserved their room in the
+ * output buffer. Returns EINTR if the threads are stopping.
+ */
+int glc_thread_wait_turn(struct glc_thread_private_s *private,
+			 unsigned long seq)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&private->order);
+	while ((private->write_seq != seq) && (!private->stop))
+		pthread_cond_wait(&private->turn, &private->order);
+	if (unlikely(private->write_seq != seq))
+		ret = EINTR;
+	pthread_mutex_unlock(&private->order);
+
+	return ret;
+}
+
+void glc_thread_end_turn(struct glc_thread_private_s *private)
+{
+	pthread_mutex_lock(&private->order);
+	private->write_seq++;
+	pthread_cond_broadcast(&private->turn);
+	pthread_mutex_unlock(&private->order);
+}
+
+void glc_thread_stats_log(struct glc_thread_private_s *private)
+{
+	struct glc_thread_stats_s *stats = private->stats;
+	const char *name = private->thread->name ? private->thread->name : "thread";
+
+	glc_log(private->glc, GLC_PERF, "glc_thread", "%s stage timings:", name);
+	glc_histogram_log(private->glc, "glc_thread", "wait in", &stats->wait_in);
+	glc_histogram_log(private->glc, "glc_thread", "process", &stats->process);
+	glc_histogram_log(private->glc, "glc_thread", "wait out", &stats->wait_out);
+}
+
+/*
+ * Called by every worker after each packet; whichever worker first
+ * sees the interval elapsed logs the report.
+ */
+void glc_thread_stats_report(struct glc_thread_private_s *private,
+			     glc_utime_t now)
+{
+	glc_utime_t interval = glc_stats_interval(private->glc);
+	glc_utime_t last = private->stats->last_report;
+
+	if ((!interval) || (now - last < interval))
+		return;
+	if (!__sync_bool_compare_and_swap(&private->stats->last_report, last, now))
+		return;
+
+	glc_thread_stats_log(private);
+}
+
+void glc_thread_stats_count(struct glc_thread_stats_s *stats,
+			    unsigned int mask, const uint64_t *before,
+			    const uint64_t *after)
+{
+	int e;
+
+	for (e = 0; e < GLC_PERFCOUNT_EVENTS; e++) {
+		if (mask & (1 << e))
+			__sync_fetch_and_add(&stats->counter[e], after[e] - before[e]);
+	}
+	__sync_fetch_and_or(&stats->counters, mask);
+}
+
+void glc_thread_counters_log(struct glc_thread_private_s *private)
+{
+	struct glc_thread_stats_s *stats = private->stats;
+	const char *name = private->thread->name ? private->thread->name : "thread";
+	double mib = stats->bytes / (1024.0 * 1024.0);
+
+	glc_log(private->glc, GLC_PERF, "glc_thread", "%s stage counters, %.1f MiB read:",
+		name, mib);
+
+	if ((stats->counters & (1 << GLC_PERFCOUNT_CYCLES)) &&
+	    (stats->counters & (1 << GLC_PERFCOUNT_INSTRUCTIONS)) &&
+	    (stats->counter[GLC_PERFCOUNT_CYCLES]))
+		glc_log(private->glc, GLC_PERF, "glc_thread", "  %-16s %12.2f",
+			"IPC", (double) stats->counter[GLC_PERFCOUNT_INSTRUCTIONS] /
+			stats->counter[GLC_PERFCOUNT_CYCLES]);
+
+	if ((stats->counters & (1 << GLC_PERFCOUNT_CYCLES)) && (stats->bytes))
+		glc_log(private->glc, GLC_PERF, "glc_thread", "  %-16s %12.0f",
+			"cycles/MiB", stats->counter[GLC_PERFCOUNT_CYCLES] / mib);
+
+	if ((stats->counters & (1 << GLC_PERFCOUNT_LLC_MISSES)) && (stats->bytes))
+		glc_log(private->glc, GLC_PERF, "glc_thread", "  %-16s %12.0f",
+			"LLC misses/MiB", stats->counter[GLC_PERFCOUNT_LLC_MISSES] / mib);
+
+	if (stats->counters & (1 << GLC_PERFCOUNT_CONTEXT_SWITCHES))
+		glc_log(private->glc, GLC_PERF, "glc_thread", "  %-16s %12" PRIu64,
+			"context switches", stats->counter[GLC_PERFCOUNT_CONTEXT_SWITCHES]);
+}
 
 int glc_thread_create(glc_t *glc, glc_thread_t *thread, ps_buffer_t *from,
 			ps_buffer_t *to)
@@ -88,6 +304,21 @@ int glc_thread_create(glc_t *glc, glc_thread_t *thread, ps_buffer_t *from,
 
 	pthread_mutex_init(&private->open, NULL);
 	pthread_mutex_init(&private->finish, NULL);
+	pthread_mutex_init(&private->order, NULL);
+	pthread_cond_init(&private->turn, NULL);
+
+	if (glc_log_get_level(glc) >= GLC_PERF) {
+		/* not fatal, the stage just goes without timings */
+		if (likely((private->stats = (struct glc_thread_stats_s *)
+			calloc(1, sizeof(struct glc_thread_stats_s)))))
+			private->stats->last_report = glc_time(glc);
+	}
+
+	if ((thread->slice_callback) && (thread->slice_threads > 1)) {
+		/* not fatal, the workers do the slices themselves */
+		if (likely(!glc_thread_pool_get(glc, thread->slice_threads - 1)))
+			private->pooled = 1;
+	}
 
 	private->pthread_thread = malloc(sizeof(pthread_t) * thread->threads);
 	for (t = 0; t < thread->threads; t++) {
@@ -118,7 +349,18 @@ int glc_thread_wait(glc_thread_t *thread)
 		}
 	}
 
+	if (private->pooled)
+		glc_thread_pool_put();
+
+	if (private->stats) {
+		glc_thread_stats_log(private);
+		glc_thread_counters_log(private);
+		free(private->stats);
+	}
+
 	free(private->pthread_thread);
+	pthread_cond_destroy(&private->turn);
+	pthread_mutex_destroy(&private->order);
 	pthread_mutex_destroy(&private->finish);
 	pthread_mutex_destroy(&private->open);
 	free(private);
@@ -137,7 +379,14 @@ int glc_thread_wait(glc_thread_t *thread)
  */
 void *glc_thread(void *argptr)
 {
-	int has_locked, ret, write_size_set, packets_init;
+	int has_locked, has_turn, ordered, ret, write_size_set, packets_init;
+	unsigned long seq;
+	glc_utime_t start, wait_in, wait_out, now;
+	glc_utime_t trace_begin, trace_wait, frame;
+	uint64_t counter_start[GLC_PERFCOUNT_EVENTS], counter_end[GLC_PERFCOUNT_EVENTS];
+	glc_perfcount_t perfcount;
+	unsigned int counters = 0;
+	const char *name;
 
 	struct glc_thread_private_s *private = (struct glc_thread_private_s *) argptr;
 	glc_thread_t *thread = private->thread;
@@ -145,12 +394,22 @@ void *glc_thread(void *argptr)
 	ps_packet_t read, write;
 
 	memset(&state, 0, sizeof(state));
-	write_size_set = ret = has_locked = packets_init = 0;
+	write_size_set = ret = has_locked = has_turn = packets_init = 0;
 	state.ptr   = thread->ptr;
 	state.from  = private->from;
+	state.priv  = private;
+	ordered     = (thread->flags & GLC_THREAD_WRITE) &&
+		      (thread->flags & GLC_THREAD_READ);
+	name        = thread->name ? thread->name : "thread";
 
 	glc_thread_block_signals();
-	glc_thread_set_rt_priority(private->glc, thread->ask_rt);
+	glc_thread_set_sched(private->glc, thread->name, thread->ask_rt);
+	glc_trace_thread(private->glc, name);
+
+	if (private->stats) {
+		glc_perfcount_open(private->glc, &perfcount);
+		counters = glc_perfcount_read(&perfcount, counter_start);
+	}
 
 	if (thread->flags & GLC_THREAD_READ) {
 		if (unlikely((ret = ps_packet_init(&read, private->from))))
@@ -172,20 +431,36 @@ void *glc_thread(void *argptr)
 	}
 
 	do {
+		start = wait_in = wait_out = 0;
+		if (private->stats)
+			start = glc_time(private->glc);
+
 		/* open callback */
 		if (thread->open_callback) {
 			if (unlikely((ret = thread->open_callback(&state))))
 				goto err;
 		}
 
-		if ((thread->flags & GLC_THREAD_WRITE) && (thread->flags & GLC_THREAD_READ)) {
-			pthread_mutex_lock(&private->open); /* preserve packet order */
+		if (private->stats)
+			wait_in = glc_time(private->glc);
+
+		if (ordered) {
+			pthread_mutex_lock(&private->open); /* read callbacks see packets in order */
 			has_locked = 1;
 		}
 
 		if ((thread->flags & GLC_THREAD_READ) && (!(state.flags & GLC_THREAD_STATE_SKIP_READ))) {
 			if (unlikely((ret = ps_packet_open(&read, PS_PACKET_READ))))
 				goto err;
+		}
+
+		if (private->stats)
+			wait_in = glc_time(private->glc) - wait_in;
+		trace_begin = glc_trace_begin(private->glc);
+		frame = 0;
+		GLC_PROBE1(packet_open, name);
+
+		if ((thread->flags & GLC_THREAD_READ) && (!(state.flags & GLC_THREAD_STATE_SKIP_READ))) {
 			if (unlikely((ret = ps_packet_read(&read, &state.header,
 						  sizeof(glc_message_header_t)))))
 				goto err;
@@ -209,6 +484,30 @@ void *glc_thread(void *argptr)
 				if (unlikely((ret = thread->read_callback(&state))))
 					goto err;
 			}
+
+			/* video frames and audio data both start with id and time */
+			if (((state.header.type == GLC_MESSAGE_VIDEO_FRAME) ||
+			     (state.header.type == GLC_MESSAGE_AUDIO_DATA)) &&
+			    (state.read_size >= sizeof(glc_video_frame_header_t)))
+				frame = ((glc_video_frame_header_t *) state.read_data)->time;
+
+			if (private->stats)
+				__sync_fetch_and_add(&private->stats->bytes, state.read_size);
+		}
+
+		if (private->stats)
+			wait_out = glc_time(private->glc);
+		trace_wait = glc_trace_begin(private->glc);
+
+		if (ordered) {
+			/* let the next thread read while we wait for the output buffer */
+			seq = private->read_seq++;
+			has_locked = 0;
+			pthread_mutex_unlock(&private->open);
+
+			if (unlikely((ret = glc_thread_wait_turn(private, seq))))
+				goto err;
+			has_turn = 1;
 		}
 
 		if ((thread->flags & GLC_THREAD_WRITE) &&
@@ -216,10 +515,20 @@ void *glc_thread(void *argptr)
 			if (unlikely((ret = ps_packet_open(&write, PS_PACKET_WRITE))))
 				goto err;
 
-			if (has_locked) {
-				has_locked = 0;
-				pthread_mutex_unlock(&private->open);
+			if (has_turn) {
+				has_turn = 0;
+				glc_thread_end_turn(private);
 			}
+		}
+
+		if (private->stats)
+			wait_out = glc_time(private->glc) - wait_out;
+		if ((thread->flags & GLC_THREAD_WRITE) &&
+		    (!(state.flags & GLC_THREAD_STATE_SKIP_WRITE)))
+			glc_trace_end(private->glc, "wait out", trace_wait, frame);
+
+		if ((thread->flags & GLC_THREAD_WRITE) &&
+		    (!(state.flags & GLC_THREAD_STATE_SKIP_WRITE))) {
 
 			/* reserve space for header */
 			if (unlikely((ret = ps_packet_seek(&write,
@@ -261,9 +570,9 @@ void *glc_thread(void *argptr)
 		}
 
 		/* in case of we skipped writing */
-		if (has_locked) {
-			has_locked = 0;
-			pthread_mutex_unlock(&private->open);
+		if (has_turn) {
+			has_turn = 0;
+			glc_thread_end_turn(private);
 		}
 
 		if ((thread->flags & GLC_THREAD_READ) &&
@@ -291,6 +600,18 @@ void *glc_thread(void *argptr)
 				goto err;
 		}
 
+		glc_trace_end(private->glc, name, trace_begin, frame);
+		GLC_PROBE3(packet_close, name, state.header.type, frame);
+
+		if (private->stats) {
+			now = glc_time(private->glc);
+			glc_histogram_add(&private->stats->wait_in, wait_in);
+			glc_histogram_add(&private->stats->wait_out, wait_out);
+			glc_histogram_add(&private->stats->process,
+					  now - start - wait_in - wait_out);
+			glc_thread_stats_report(private, now);
+		}
+
 		if (state.flags & GLC_THREAD_STOP)
 			break; /* no error, just stop, please */
 
@@ -320,6 +641,20 @@ finish:
 			ps_buffer_cancel(private->to);
 	}
 
+	/* threads waiting for their turn must notice stop */
+	if (ordered) {
+		pthread_mutex_lock(&private->order);
+		pthread_cond_broadcast(&private->turn);
+		pthread_mutex_unlock(&private->order);
+	}
+
+	if (private->stats) {
+		counters &= glc_perfcount_read(&perfcount, counter_end);
+		glc_thread_stats_count(private->stats, counters, counter_start,
+				       counter_end);
+		glc_perfcount_close(&perfcount);
+	}
+
 	/* thread finish callback */
 	if (thread->thread_finish_callback)
 		thread->thread_finish_callback(state.ptr, state.threadptr, ret);
@@ -348,6 +683,8 @@ finish:
 err:
 	if (has_locked)
 		pthread_mutex_unlock(&private->open);
+	if (has_turn)
+		glc_thread_end_turn(private);
 
 	if (ret == EINTR)
 		ret = 0;
@@ -359,20 +696,294 @@ err:
 	goto finish;
 }
 
-int glc_thread_set_rt_priority(glc_t *glc, int ask_rt)
+int glc_thread_slice(glc_thread_state_t *state, unsigned int rows)
+{
+	struct glc_thread_private_s *private = state->priv;
+	unsigned int step;
+
+	/* the pool can't go away while this stage holds a reference */
+	if ((!private->pooled) || (rows < 2 * GLC_THREAD_SLICE_MIN_ROWS))
+		return private->thread->slice_callback(state, 0, rows);
+
+	/* a few slices per thread even out the ones that run late */
+	step = rows / ((private->thread->slice_threads) * 4);
+	if (step < GLC_THREAD_SLICE_MIN_ROWS)
+		step = GLC_THREAD_SLICE_MIN_ROWS;
+	step += step % 2; /* keep 4:2:0 chroma rows whole */
+
+	return glc_thread_slice_run(state, rows, step);
+}
+
+int glc_thread_slice_chunks(glc_thread_state_t *state, unsigned int chunks)
+{
+	struct glc_thread_private_s *private = state->priv;
+
+	if ((!private->pooled) || (chunks < 2))
+		return private->thread->slice_callback(state, 0, chunks);
+
+	return glc_thread_slice_run(state, chunks, 1);
+}
+
+int glc_thread_slice_run(glc_thread_state_t *state, unsigned int rows,
+			 unsigned int step)
+{
+	struct glc_thread_private_s *private = state->priv;
+	struct glc_thread_pool_s *pool = glc_thread_pool;
+	struct glc_thread_slice_job_s job;
+
+	job.state    = state;
+	job.callback = private->thread->slice_callback;
+	job.rows     = rows;
+	job.step     = step;
+	job.next     = job.finished = 0;
+	job.ret      = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	job.next_job = pool->jobs;
+	pool->jobs = &job;
+	pthread_cond_broadcast(&pool->work);
+
+	while (job.next < job.rows)
+		glc_thread_pool_run(pool, &job);
+	while (job.finished < job.rows)
+		pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+
+	return job.ret;
+}
+
+int glc_thread_pool_get(glc_t *glc, size_t helpers)
+{
+	struct glc_thread_pool_s *pool;
+	int ret = 0;
+
+	pthread_mutex_lock(&glc_thread_pool_lock);
+	if (!(pool = glc_thread_pool)) {
+		if (unlikely(!(pool = (struct glc_thread_pool_s *)
+			calloc(1, sizeof(struct glc_thread_pool_s))))) {
+			pthread_mutex_unlock(&glc_thread_pool_lock);
+			return ENOMEM;
+		}
+		pool->glc = glc;
+		pthread_mutex_init(&pool->mutex, NULL);
+		pthread_cond_init(&pool->work, NULL);
+		pthread_cond_init(&pool->done, NULL);
+		glc_thread_pool = pool;
+	}
+
+	/* grow up to the largest team a stage asked for */
+	if (helpers > pool->helpers) {
+		pool->helper = realloc(pool->helper, sizeof(pthread_t) * helpers);
+		while (pool->helpers < helpers) {
+			if (unlikely((ret = pthread_create(&pool->helper[pool->helpers], NULL,
+							   glc_thread_pool_helper, pool)))) {
+				glc_log(glc, GLC_WARN, "glc_thread",
+					 "can't create slice thread: %s (%d)", strerror(ret), ret);
+				break;
+			}
+			pool->helpers++;
+		}
+		glc_log(glc, GLC_DEBUG, "glc_thread", "%zd slice threads in pool",
+			 pool->helpers);
+	}
+
+	pool->users++;
+	pthread_mutex_unlock(&glc_thread_pool_lock);
+
+	return 0;
+}
+
+void glc_thread_pool_put(void)
+{
+	struct glc_thread_pool_s *pool;
+	size_t t;
+
+	pthread_mutex_lock(&glc_thread_pool_lock);
+	pool = glc_thread_pool;
+	if (--pool->users) {
+		pthread_mutex_unlock(&glc_thread_pool_lock);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (t = 0; t < pool->helpers; t++)
+		pthread_join(pool->helper[t], NULL);
+
+	glc_thread_pool = NULL;
+	pthread_mutex_unlock(&glc_thread_pool_lock);
+
+	free(pool->helper);
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->work);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+}
+
+/*
+ * Take the next range of the job and process it. The job leaves the
+ * queue once its last range is handed out. Called, and returns, with
+ * the pool mutex held.
+ */
+void glc_thread_pool_run(struct glc_thread_pool_s *pool,
+			 struct glc_thread_slice_job_s *job)
+{
+	struct glc_thread_slice_job_s **link;
+	struct glc_thread_stats_s *stats;
+	uint64_t before[GLC_PERFCOUNT_EVENTS], after[GLC_PERFCOUNT_EVENTS];
+	unsigned int from, to, counters = 0;
+	glc_utime_t begin;
+	int ret;
+
+	from = job->next;
+	to = from + job->step;
+	if (to > job->rows)
+		to = job->rows;
+	job->next = to;
+
+	if (job->next == job->rows) {
+		for (link = &pool->jobs; *link != job; link = &(*link)->next_job);
+		*link = job->next_job;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	/* the stage worker counts its own slices */
+	stats = ((struct glc_thread_private_s *) job->state->priv)->stats;
+	if ((stats) && (glc_thread_helper_perfcount))
+		counters = glc_perfcount_read(glc_thread_helper_perfcount, before);
+
+	begin = glc_trace_begin(pool->glc);
+	ret = job->callback(job->state, from, to);
+	glc_trace_end(pool->glc, "slice", begin, 0);
+
+	if (counters) {
+		counters &= glc_perfcount_read(glc_thread_helper_perfcount, after);
+		glc_thread_stats_count(stats, counters, before, after);
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	if (unlikely(ret) && (!job->ret))
+		job->ret = ret;
+	job->finished += to - from;
+	if (job->finished == job->rows)
+		pthread_cond_broadcast(&pool->done);
+}
+
+void *glc_thread_pool_helper(void *argptr)
+{
+	struct glc_thread_pool_s *pool = (struct glc_thread_pool_s *) argptr;
+	struct glc_thread_slice_job_s *job, *deepest;
+	glc_perfcount_t perfcount;
+
+	glc_thread_block_signals();
+	/* helpers serve every stage, GLC_RTPRIO alone doesn't make them rt */
+	glc_thread_set_sched(pool->glc, "slice", 0);
+	glc_trace_thread(pool->glc, "slice");
+
+	if (glc_log_get_level(pool->glc) >= GLC_PERF) {
+		glc_perfcount_open(pool->glc, &perfcount);
+		glc_thread_helper_perfcount = &perfcount;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while ((!pool->quit) && (pool->jobs == NULL))
+			pthread_cond_wait(&pool->work, &pool->mutex);
+		if (pool->quit)
+			break;
+
+		deepest = pool->jobs;
+		for (job = deepest->next_job; job != NULL; job = job->next_job) {
+			if (job->rows - job->next > deepest->rows - deepest->next)
+				deepest = job;
+		}
+		glc_thread_pool_run(pool, deepest);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (glc_thread_helper_perfcount) {
+		glc_perfcount_close(glc_thread_helper_perfcount);
+		glc_thread_helper_perfcount = NULL;
+	}
+
+	return NULL;
+}
+
+/*
+ * Applies the cpu affinity and scheduling policy configured for the
+ * stage. Failing to do so is not fatal, the thread just keeps running
+ * where and how it was.
+ */
+int glc_thread_set_sched(glc_t *glc, const char *name, int ask_rt)
 {
 	int ret = 0;
 	struct sched_param param;
-	if (ask_rt && glc_allow_rt(glc)) {
+	glc_sched_t sched;
+	cpu_set_t cpus;
+
+	if (!glc_stage_affinity(glc, name, &cpus)) {
+		ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+		if (unlikely(ret))
+			glc_log(glc, GLC_WARN, "glc_thread", "failed to set %s affinity: %s (%d)",
+				name ? name : "thread", strerror(ret), ret);
+	}
+
+	if (glc_stage_sched(glc, name, &sched))
+		sched.policy = GLC_SCHED_DEFAULT;
+
+	switch (sched.policy) {
+	case GLC_SCHED_NICE:
+		/* nice values are per thread on linux */
+		if (unlikely(setpriority(PRIO_PROCESS, syscall(SYS_gettid), sched.value)))
+			ret = errno;
+		break;
+	case GLC_SCHED_RR:
+		param.sched_priority = sched.value;
+		ret = pthread_setschedparam(pthread_self(), SCHED_RR, &param);
+		break;
+	case GLC_SCHED_DEADLINE:
+		ret = glc_thread_set_deadline(&sched);
+		break;
+	default:
+		if (!(ask_rt && glc_allow_rt(glc)))
+			return 0;
 		param.sched_priority = sched_get_priority_min(SCHED_RR);
 		ret = pthread_setschedparam(pthread_self(), SCHED_RR, &param);
 		if (unlikely(ret))
 			glc_log(glc, GLC_ERROR, "glc_thread", "failed to set rtprio: %s (%d)",
 				strerror(ret), ret);
+		return ret;
 	}
+
+	if (unlikely(ret))
+		glc_log(glc, GLC_WARN, "glc_thread", "failed to set %s scheduling policy: %s (%d)",
+			name ? name : "thread", strerror(ret), ret);
 	return ret;
 }
 
+int glc_thread_set_deadline(glc_sched_t *sched)
+{
+#ifdef SYS_sched_setattr
+	struct glc_thread_sched_attr_s attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size           = sizeof(attr);
+	attr.sched_policy   = SCHED_DEADLINE;
+	attr.sched_runtime  = sched->runtime;
+	attr.sched_deadline = sched->deadline;
+	attr.sched_period   = sched->period;
+
+	if (unlikely(syscall(SYS_sched_setattr, 0, &attr, 0)))
+		return errno;
+	return 0;
+#else
+	return ENOTSUP;
+#endif
+}
+
 /*
  * Signals should be handled by the main thread, nowhere else.
  * I'm using POSIX signal interface here, until someone tells me
@@ -406,6 +1017,7 @@ typedef struct {
 	void *arg;
 	glc_t *glc;
 	int   ask_rt;
+	const char *name;
 } glc_simple_thread_param_t;
 
 static void *glc_simple_thread_start_routine(void *arg)
@@ -414,7 +1026,9 @@ static void *glc_simple_thread_start_routine(void *arg)
 	void *res;
 
 	glc_thread_block_signals();
-	glc_thread_set_rt_priority(param->glc, param->ask_rt);
+	glc_thread_set_sched(param->glc, param->name, param->ask_rt);
+	if (param->name)
+		glc_trace_thread(param->glc, param->name);
 	res  = param->start_routine(param->arg);
 	free(param);
 	return res;
@@ -437,6 +1051,7 @@ int glc_simple_thread_create(glc_t *glc, glc_simple_thread_t *thread,
 	param->arg           = arg;
 	param->glc           = glc;
 	param->ask_rt        = thread->ask_rt;
+	param->name          = thread->name;
 
 	/* May need to set before starting the thread as some threads
 	 * might use this flag as a stop condition.
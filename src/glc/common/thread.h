@@ -91,6 +91,9 @@ typedef struct {
 	 * and I find this a bit heavy for the risk the shortcut represents.
 	 */
 	ps_buffer_t *from;
+
+	/** implementation specific */
+	void *priv;
 } glc_thread_state_t;
 
 /** thread does read operations */
@@ -111,8 +114,15 @@ typedef struct {
 	void *ptr;
 	/** number of threads to create */
 	size_t threads;
+	/** number of threads sharing the rows of one packet in
+	    glc_thread_slice(), including the calling thread. The
+	    helpers come from a pool shared by every stage */
+	size_t slice_threads;
 	/** flag to indicate that rt prio is desired. */
 	int    ask_rt;
+	/** stage name matched against glc_set_affinity() and
+	    glc_set_sched() entries, may be NULL */
+	const char *name;
 	/** implementation specific */
 	void *priv;
 
@@ -128,11 +138,19 @@ typedef struct {
 	    header from packet */
 	int (*header_callback)(glc_thread_state_t *);
 	/** read callback is called when thread has read the
-	    whole packet */
+	    whole packet. With both GLC_THREAD_READ and
+	    GLC_THREAD_WRITE, read callbacks run one at a time
+	    and in packet order */
 	int (*read_callback)(glc_thread_state_t *);
 	/** write callback is called when thread has opened
-	    dma to write packet */
+	    dma to write packet, concurrently with other threads.
+	    Written packets keep the order they were read in */
 	int (*write_callback)(glc_thread_state_t *);
+	/** slice callback processes rows [from, to) of the packet
+	    passed to glc_thread_slice(), or chunks with
+	    glc_thread_slice_chunks(). Several slices of the same
+	    packet run concurrently */
+	int (*slice_callback)(glc_thread_state_t *, unsigned int, unsigned int);
 	/** close callback is called when both packets are closed */
 	int (*close_callback)(glc_thread_state_t *);
 	/** finish callback is called only once, when all threads have
@@ -160,10 +178,38 @@ __PUBLIC int glc_thread_create(glc_t *glc, glc_thread_t *thread,
  */
 __PUBLIC int glc_thread_wait(glc_thread_t *thread);
 
+/**
+ * \brief process the rows of the current packet in slices
+ *
+ * Splits [0, rows) into ranges starting on even rows and calls
+ * thread.slice_callback on them from the calling thread and from
+ * the process-wide slice helpers. Helpers serve the packet with the
+ * most rows left first, whatever stage it belongs to. Returns when
+ * every range is done.
+ * \param state state passed to the read or write callback
+ * \param rows number of rows
+ * \return 0 on success otherwise an error code from slice_callback
+ */
+__PUBLIC int glc_thread_slice(glc_thread_state_t *state, unsigned int rows);
+
+/**
+ * \brief process the chunks of the current packet concurrently
+ *
+ * Same as glc_thread_slice() but every range handed to a helper is a
+ * single chunk, [chunk, chunk + 1). Without helpers thread.slice_callback
+ * gets all of [0, chunks) at once.
+ * \param state state passed to the read or write callback
+ * \param chunks number of chunks
+ * \return 0 on success otherwise an error code from slice_callback
+ */
+__PUBLIC int glc_thread_slice_chunks(glc_thread_state_t *state, unsigned int chunks);
+
 typedef struct {
 	pthread_t thread;
 	/** flag to indicate that rt prio is desired. */
 	int ask_rt;
+	/** stage name, see glc_thread_t */
+	const char *name;
 	int running;
 } glc_simple_thread_t;
 
@@ -0,0 +1,272 @@
+/**
+ * \file glc/common/trace.c
+ * \brief frame lifecycle tracing
+ * \author Olivier Langlois <olivier@trillion01.com>
+ * \date 2014
+
+    Copyright 2014 Olivier Langlois
+
+    This file is part of glcs.
+
+    glcs is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    glcs is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with glcs.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/**
+ * \addtogroup trace
+ *  \{
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "glc.h"
+#include "core.h"
+#include "log.h"
+#include "trace.h"
+#include "optimization.h"
+
+/** events kept per thread, power of 2 */
+#define GLC_TRACE_RING_SIZE 65536
+
+/** instant events have no duration */
+#define GLC_TRACE_INSTANT ((glc_utime_t) -1)
+
+struct glc_trace_event_s {
+	const char *name;
+	glc_utime_t begin, duration;
+	glc_utime_t frame;
+};
+
+/*
+ * Only the owning thread writes to its ring, nothing is read before
+ * glc_trace_close() when every thread is done.
+ */
+struct glc_trace_ring_s {
+	pid_t tid;
+	const char *name;
+	unsigned long count;
+	struct glc_trace_event_s event[GLC_TRACE_RING_SIZE];
+	struct glc_trace_ring_s *next;
+};
+
+struct glc_trace_s {
+	char *filename;
+	unsigned long serial;
+	pthread_mutex_t mutex;
+	struct glc_trace_ring_s *rings;
+};
+
+/* tells rings of a previous trace apart */
+static unsigned long glc_trace_serial = 0;
+
+static __thread struct glc_trace_ring_s *glc_trace_ring = NULL;
+static __thread unsigned long glc_trace_ring_serial = 0;
+
+static struct glc_trace_ring_s *glc_trace_get_ring(glc_t *glc);
+static void glc_trace_add(glc_t *glc, const char *name, glc_utime_t begin,
+			  glc_utime_t duration, glc_utime_t frame);
+static void glc_trace_write_string(FILE *stream, const char *str);
+
+int glc_trace_open(glc_t *glc, const char *filename)
+{
+	struct glc_trace_s *trace;
+
+	if (unlikely(glc->trace))
+		return EBUSY;
+
+	if (unlikely(!(trace = (struct glc_trace_s *)
+		calloc(1, sizeof(struct glc_trace_s)))))
+		return ENOMEM;
+
+	trace->filename = strdup(filename);
+	trace->serial   = __sync_add_and_fetch(&glc_trace_serial, 1);
+	pthread_mutex_init(&trace->mutex, NULL);
+
+	glc->trace = trace;
+	glc_log(glc, GLC_INFO, "trace", "tracing to %s", filename);
+	return 0;
+}
+
+int glc_trace_close(glc_t *glc)
+{
+	struct glc_trace_s *trace = glc->trace;
+	struct glc_trace_ring_s *ring;
+	struct glc_trace_event_s *event;
+	unsigned long first, i;
+	FILE *stream;
+	int ret = 0, comma = 0;
+	pid_t pid = getpid();
+
+	if (!trace)
+		return 0;
+	glc->trace = NULL;
+
+	if (unlikely(!(stream = fopen(trace->filename, "w")))) {
+		ret = errno;
+		glc_log(glc, GLC_ERROR, "trace", "can't open %s: %s (%d)",
+			trace->filename, strerror(ret), ret);
+	} else
+		fprintf(stream, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	while ((ring = trace->rings) != NULL) {
+		trace->rings = ring->next;
+
+		if (stream && ring->name) {
+			fprintf(stream, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+				"\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+				comma ? ",\n" : "", pid, ring->tid);
+			glc_trace_write_string(stream, ring->name);
+			fprintf(stream, "}}");
+			comma = 1;
+		}
+
+		first = 0;
+		if (ring->count > GLC_TRACE_RING_SIZE) {
+			first = ring->count - GLC_TRACE_RING_SIZE;
+			glc_log(glc, GLC_WARN, "trace",
+				"%lu events of thread %d were overwritten",
+				first, ring->tid);
+		}
+
+		for (i = first; (stream) && (i < ring->count); i++) {
+			event = &ring->event[i & (GLC_TRACE_RING_SIZE - 1)];
+
+			fprintf(stream, "%s{\"name\":", comma ? ",\n" : "");
+			glc_trace_write_string(stream, event->name);
+			if (event->duration == GLC_TRACE_INSTANT)
+				fprintf(stream, ",\"ph\":\"i\",\"s\":\"t\"");
+			else
+				fprintf(stream, ",\"ph\":\"X\",\"dur\":%.3f",
+					event->duration / 1000.0);
+			fprintf(stream, ",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+				event->begin / 1000.0, pid, ring->tid);
+			if (event->frame)
+				fprintf(stream, ",\"args\":{\"frame\":%" PRIu64 "}",
+					event->frame);
+			fprintf(stream, "}");
+			comma = 1;
+		}
+
+		free(ring);
+	}
+
+	if (stream) {
+		fprintf(stream, "\n]}\n");
+		if (unlikely(fclose(stream))) {
+			ret = errno;
+			glc_log(glc, GLC_ERROR, "trace", "can't write %s: %s (%d)",
+				trace->filename, strerror(ret), ret);
+		} else
+			glc_log(glc, GLC_INFO, "trace", "wrote %s", trace->filename);
+	}
+
+	pthread_mutex_destroy(&trace->mutex);
+	free(trace->filename);
+	free(trace);
+	return ret;
+}
+
+struct glc_trace_ring_s *glc_trace_get_ring(glc_t *glc)
+{
+	struct glc_trace_s *trace = glc->trace;
+	struct glc_trace_ring_s *ring;
+
+	if (likely(glc_trace_ring_serial == trace->serial))
+		return glc_trace_ring;
+
+	/* the first event of this thread since tracing started */
+	if (unlikely(!(ring = (struct glc_trace_ring_s *)
+		malloc(sizeof(struct glc_trace_ring_s)))))
+		return NULL;
+	ring->tid   = syscall(SYS_gettid);
+	ring->name  = NULL;
+	ring->count = 0;
+
+	pthread_mutex_lock(&trace->mutex);
+	ring->next   = trace->rings;
+	trace->rings = ring;
+	pthread_mutex_unlock(&trace->mutex);
+
+	glc_trace_ring        = ring;
+	glc_trace_ring_serial = trace->serial;
+	return ring;
+}
+
+void glc_trace_add(glc_t *glc, const char *name, glc_utime_t begin,
+		   glc_utime_t duration, glc_utime_t frame)
+{
+	struct glc_trace_ring_s *ring;
+	struct glc_trace_event_s *event;
+
+	if (unlikely(!(ring = glc_trace_get_ring(glc))))
+		return;
+
+	event = &ring->event[ring->count++ & (GLC_TRACE_RING_SIZE - 1)];
+	event->name     = name;
+	event->begin    = begin;
+	event->duration = duration;
+	event->frame    = frame;
+}
+
+void glc_trace_write_string(FILE *stream, const char *str)
+{
+	fputc('"', stream);
+	for (; *str; str++) {
+		if ((*str == '"') || (*str == '\\'))
+			fputc('\\', stream);
+		fputc(*str, stream);
+	}
+	fputc('"', stream);
+}
+
+void glc_trace_thread(glc_t *glc, const char *name)
+{
+	struct glc_trace_ring_s *ring;
+
+	if (likely(!glc->trace))
+		return;
+	if (likely((ring = glc_trace_get_ring(glc))))
+		ring->name = name;
+}
+
+glc_utime_t glc_trace_begin(glc_t *glc)
+{
+	if (likely(!glc->trace))
+		return 0;
+	return glc_time(glc);
+}
+
+void glc_trace_end(glc_t *glc, const char *name, glc_utime_t begin,
+		   glc_utime_t frame)
+{
+	if (likely(!glc->trace) || unlikely(!begin))
+		return;
+	glc_trace_add(glc, name, begin, glc_time(glc) - begin, frame);
+}
+
+void glc_trace_instant(glc_t *glc, const char *name, glc_utime_t frame)
+{
+	if (likely(!glc->trace))
+		return;
+	glc_trace_add(glc, name, glc_time(glc), GLC_TRACE_INSTANT, frame);
+}
+
+/**  \} */
@@ -0,0 +1,106 @@
+/**
+ * \file glc/common/trace.h
+ * \brief frame lifecycle tracing
+ * \author Olivier Langlois <olivier@trillion01.com>
+ * \date 2014
+
+    Copyright 2014 Olivier Langlois
+
+    This file is part of glcs.
+
+    glcs is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    glcs is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with glcs.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/**
+ * \addtogroup common
+ *  \{
+ * \defgroup trace trace
+ *  \{
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <glc/common/glc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief start tracing
+ *
+ * Events are kept in a ring per thread, the oldest ones being
+ * overwritten once it is full, and written to filename in the Chrome
+ * trace event format by glc_trace_close(). The file can be loaded in
+ * Perfetto or chrome://tracing. Every thread that records an event
+ * must have finished by then.
+ * \param glc glc
+ * \param filename trace file
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int glc_trace_open(glc_t *glc, const char *filename);
+
+/**
+ * \brief stop tracing and write the trace file
+ *
+ * glc_destroy() calls this.
+ * \param glc glc
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int glc_trace_close(glc_t *glc);
+
+/**
+ * \brief name the calling thread in the trace
+ * \param glc glc
+ * \param name thread name, must stay valid until glc_trace_close()
+ */
+__PUBLIC void glc_trace_thread(glc_t *glc, const char *name);
+
+/**
+ * \brief start of a traced span
+ * \param glc glc
+ * \return current time, 0 when not tracing
+ */
+__PUBLIC glc_utime_t glc_trace_begin(glc_t *glc);
+
+/**
+ * \brief record a span started with glc_trace_begin()
+ * \param glc glc
+ * \param name event name, must stay valid until glc_trace_close()
+ * \param begin value returned by glc_trace_begin()
+ * \param frame stream time of the frame or audio packet the span
+ *              worked on, shown in the trace to match the events of
+ *              one frame, 0 if unknown
+ */
+__PUBLIC void glc_trace_end(glc_t *glc, const char *name, glc_utime_t begin,
+			    glc_utime_t frame);
+
+/**
+ * \brief record an instant event
+ * \param glc glc
+ * \param name event name, must stay valid until glc_trace_close()
+ * \param frame stream time of the frame or audio packet, 0 if unknown
+ */
+__PUBLIC void glc_trace_instant(glc_t *glc, const char *name, glc_utime_t frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/**  \} */
+/**  \} */
@@ -175,7 +175,8 @@ int glc_util_log_info(glc_t *glc)
 	glc_util_utc_date(glc,  date, &unused);
 
 	glc_log(glc, GLC_INFO, "util", "system information\n" \
-		"  threads hint = %ld", glc_threads_hint(glc));
+		"  threads hint  = %ld\n" \
+		"  slice threads = %ld", glc_threads_hint(glc), glc_slice_threads(glc));
 
 	glc_log(glc, GLC_INFO, "util", "stream information\n" \
 		"  signature    = 0x%08x\n" \
@@ -413,9 +414,24 @@ const char *glc_util_msgtype_to_str(glc_message_type_t type)
 	case GLC_MESSAGE_LZJB:
 		res = "GLC_MESSAGE_LZJB";
 		break;
+	case GLC_MESSAGE_LZ4:
+		res = "GLC_MESSAGE_LZ4";
+		break;
+	case GLC_MESSAGE_ZSTD:
+		res = "GLC_MESSAGE_ZSTD";
+		break;
+	case GLC_MESSAGE_CHUNKED:
+		res = "GLC_MESSAGE_CHUNKED";
+		break;
 	case GLC_CALLBACK_REQUEST:
 		res = "GLC_CALLBACK_REQUEST";
 		break;
+	case GLC_MESSAGE_VIDEO_REPEAT:
+		res = "GLC_MESSAGE_VIDEO_REPEAT";
+		break;
+	case GLC_MESSAGE_DELTA:
+		res = "GLC_MESSAGE_DELTA";
+		break;
 	default:
 		res = "unknown";
 		break;
@@ -0,0 +1,6 @@
+#ifndef _VERSION_H
+#define _VERSION_H
+
+#define GLC_VERSION "0b8dcaf-dirty"
+
+#endif /* _VERSION_H */
@@ -58,7 +58,8 @@
 struct color_video_stream_s;
 
 typedef void (*color_proc)(color_t color, struct color_video_stream_s *video,
-			   unsigned char *from, unsigned char *to);
+			   unsigned char *from, unsigned char *to,
+			   unsigned int y0, unsigned int y1);
 
 struct color_video_stream_s {
 	glc_stream_id_t id;
@@ -90,6 +91,8 @@ struct color_s {
 
 static int color_read_callback(glc_thread_state_t *state);
 static int color_write_callback(glc_thread_state_t *state);
+static int color_slice_callback(glc_thread_state_t *state,
+				unsigned int from, unsigned int to);
 static void color_finish_callback(void *ptr, int err);
 
 static void color_get_video_stream(color_t color, glc_stream_id_t id,
@@ -104,9 +107,11 @@ static int color_generate_rgb_lookup_table(color_t color,
 				    struct color_video_stream_s *video);
 
 static void color_ycbcr(color_t color, struct color_video_stream_s *video,
-		 unsigned char *from, unsigned char *to);
+		 unsigned char *from, unsigned char *to,
+		 unsigned int y0, unsigned int y1);
 static void color_bgr(color_t color, struct color_video_stream_s *video,
-	       unsigned char *from, unsigned char *to);
+	       unsigned char *from, unsigned char *to,
+	       unsigned int y0, unsigned int y1);
 
 /* unfortunately over- and underflows will occur */
 __inline__ static unsigned char color_clamp(int val)
@@ -127,9 +132,12 @@ int color_init(color_t *color, glc_t *glc)
 	(*color)->thread.flags = GLC_THREAD_READ | GLC_THREAD_WRITE;
 	(*color)->thread.read_callback = &color_read_callback;
 	(*color)->thread.write_callback = &color_write_callback;
+	(*color)->thread.slice_callback = &color_slice_callback;
 	(*color)->thread.finish_callback = &color_finish_callback;
 	(*color)->thread.ptr = *color;
 	(*color)->thread.threads = glc_threads_hint(glc);
+	(*color)->thread.name    = "color";
+	(*color)->thread.slice_threads = glc_slice_threads(glc);
 
 	return 0;
 }
@@ -238,13 +246,24 @@ int color_read_callback(glc_thread_state_t *state)
 int color_write_callback(glc_thread_state_t *state)
 {
 	struct color_video_stream_s *video = state->threadptr;
+	int ret;
 
 	memcpy(state->write_data, state->read_data, sizeof(glc_video_frame_header_t));
-	video->proc(state->ptr, video,
-		  (unsigned char *) &state->read_data[sizeof(glc_video_frame_header_t)],
-		  (unsigned char *) &state->write_data[sizeof(glc_video_frame_header_t)]);
+	ret = glc_thread_slice(state, video->h);
 
 	pthread_rwlock_unlock(&video->update);
+	return ret;
+}
+
+int color_slice_callback(glc_thread_state_t *state,
+			 unsigned int from, unsigned int to)
+{
+	struct color_video_stream_s *video = state->threadptr;
+
+	video->proc(state->ptr, video,
+		  (unsigned char *) &state->read_data[sizeof(glc_video_frame_header_t)],
+		  (unsigned char *) &state->write_data[sizeof(glc_video_frame_header_t)],
+		  from, to);
 	return 0;
 }
 
@@ -397,7 +416,8 @@ int color_color_msg(color_t color, glc_color_message_t *msg)
 
 void color_ycbcr(color_t color,
 		 struct color_video_stream_s *video,
-		 unsigned char *from, unsigned char *to)
+		 unsigned char *from, unsigned char *to,
+		 unsigned int y0, unsigned int y1)
 {
 	unsigned int x, y, Cpix, Y;
 	unsigned int pos;
@@ -412,7 +432,8 @@ void color_ycbcr(color_t color,
 	Cb_to = &to[video->h * video->w];
 	Cr_to = &to[video->h * video->w + (video->h / 2) * (video->w / 2)];
 
-	Cpix = 0;
+	/* y0 is even, skip the chroma rows of the previous slices */
+	Cpix = (y0 / 2) * (video->w / 2);
 
 #define CONVERT_Y(xadd, yadd) 								\
 	pos = YCBCR_LOOKUP_POS(Y_from[(x + (xadd)) + (y + (yadd)) * video->w],		\
@@ -420,7 +441,7 @@ void color_ycbcr(color_t color,
 	Y_to[(x + (xadd)) + (y + (yadd)) * video->w] = video->lookup_table[pos + 0];	\
 	Y += video->lookup_table[pos + 0];
 
-	for (y = 0; y < video->h; y += 2) {
+	for (y = y0; y < y1; y += 2) {
 		for (x = 0; x < video->w; x += 2) {
 			Y = 0;
 
@@ -440,11 +461,12 @@ void color_ycbcr(color_t color,
 
 void color_bgr(color_t color,
 	       struct color_video_stream_s *video,
-	       unsigned char *from, unsigned char *to)
+	       unsigned char *from, unsigned char *to,
+	       unsigned int y0, unsigned int y1)
 {
 	unsigned int x, y, p;
 
-	for (y = 0; y < video->h; y++) {
+	for (y = y0; y < y1; y++) {
 		for (x = 0; x < video->w; x++) {
 			p = video->row * y + x * video->bpp;
 
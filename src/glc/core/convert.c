@@ -0,0 +1,847 @@
+/**
+ * \file glc/core/convert.c
+ * \brief convert to BGR, scale and color correct in one pass
+ * \author Olivier Langlois <olivier@trillion01.com>
+ * \date 2014
+
+    Copyright 2014 Olivier Langlois
+
+    This file is part of glcs.
+
+    glcs is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    glcs is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with glcs.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/**
+ * \addtogroup convert
+ *  \{
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <pthread.h>
+#include <packetstream.h>
+#include <errno.h>
+
+#include <glc/common/glc.h>
+#include <glc/common/core.h>
+#include <glc/common/log.h>
+#include <glc/common/thread.h>
+#include <glc/common/util.h>
+#include <glc/common/optimization.h>
+
+#include "convert.h"
+
+#define CONVERT_RUNNING      0x1
+#define CONVERT_SIZE         0x2
+#define CONVERT_OVERRIDE     0x4
+
+/*
+ * Same Y'CbCr lookup as rgb, scale map as scale and color table as
+ * color, so frames come out exactly as from the rgb, scale, color
+ * chain.
+ */
+#define LOOKUP_BITS 7
+#define LOOKUP_POS(Y, Cb, Cr) \
+	(((((Y) >> (8 - LOOKUP_BITS)) << (LOOKUP_BITS * 2)) + \
+	  (((Cb) >> (8 - LOOKUP_BITS)) << LOOKUP_BITS) + \
+	  ( (Cr) >> (8 - LOOKUP_BITS))) * 3)
+
+#define CLAMP_256(val) \
+	(val) < 0 ? 0 : ((val) > 255 ? 255 : (val))
+
+static unsigned char YCbCrJPEG_TO_RGB_Rd(unsigned char Y, unsigned char Cb, unsigned char Cr)
+{
+	int R = Y + 1.402 * (Cr - 128);
+	return CLAMP_256(R);
+}
+
+static unsigned char YCbCrJPEG_TO_RGB_Gd(unsigned char Y, unsigned char Cb, unsigned char Cr)
+{
+	int G = Y - 0.344136 * (Cb - 128) - 0.714136 * (Cr - 128);
+	return CLAMP_256(G);
+}
+
+static unsigned char YCbCrJPEG_TO_RGB_Bd(unsigned char Y, unsigned char Cb, unsigned char Cr)
+{
+	int B = Y + 1.772 * (Cb - 128);
+	return CLAMP_256(B);
+}
+
+/* how source pixels are sampled */
+#define CONVERT_COPY         1
+#define CONVERT_HALF         2
+#define CONVERT_SCALE        3
+
+struct convert_s;
+struct convert_video_stream_s;
+
+typedef void (*convert_proc)(struct convert_s *convert,
+			     struct convert_video_stream_s *video,
+			     unsigned char *from,
+			     unsigned char *to,
+			     unsigned int y0, unsigned int y1);
+
+struct convert_video_stream_s {
+	glc_stream_id_t id;
+	glc_flags_t flags;
+	glc_video_format_t format;
+	size_t size;
+	unsigned int w, h, bpp;
+	unsigned int row, orow;
+	double scale;
+	int sampling;
+	int created;
+
+	unsigned int sw, sh, rw, rh, rx, ry;
+
+	/* 4 samples per scaled pixel, cpos only for Y'CbCr */
+	unsigned int *pos, *cpos;
+	float *factor;
+
+	float brightness, contrast;
+	float red_gamma, green_gamma, blue_gamma;
+	/* red, green and blue tables, identity without correction */
+	unsigned char lookup_table[256 + 256 + 256];
+
+	convert_proc proc;
+
+	pthread_rwlock_t update;
+	struct convert_video_stream_s *next;
+};
+
+struct convert_s {
+	glc_t *glc;
+	glc_flags_t flags;
+	glc_thread_t thread;
+
+	struct convert_video_stream_s *video;
+
+	/* Y'CbCr to RGB, allocated with the first Y'CbCr stream */
+	unsigned char *lookup_table;
+
+	double scale;
+	unsigned int width, height;
+
+	float brightness, contrast;
+	float red_gamma, green_gamma, blue_gamma;
+};
+
+static int convert_read_callback(glc_thread_state_t *state);
+static int convert_write_callback(glc_thread_state_t *state);
+static int convert_slice_callback(glc_thread_state_t *state,
+				  unsigned int from, unsigned int to);
+static void convert_finish_callback(void *ptr, int err);
+
+static void convert_get_video_stream(convert_t convert, glc_stream_id_t id,
+				     struct convert_video_stream_s **video);
+static int convert_video_format_message(convert_t convert,
+					glc_video_format_message_t *format_message,
+					glc_thread_state_t *state);
+static int convert_color_message(convert_t convert, glc_color_message_t *color_message);
+static void convert_update(convert_t convert, struct convert_video_stream_s *video);
+
+static int convert_init_lookup(convert_t convert);
+static int convert_generate_map(convert_t convert, struct convert_video_stream_s *video);
+static void convert_generate_color_table(struct convert_video_stream_s *video,
+					 int correct);
+
+static void convert_bgr_copy(convert_t convert, struct convert_video_stream_s *video,
+			     unsigned char *from, unsigned char *to,
+			     unsigned int y0, unsigned int y1);
+static void convert_bgr_half(convert_t convert, struct convert_video_stream_s *video,
+			     unsigned char *from, unsigned char *to,
+			     unsigned int y0, unsigned int y1);
+static void convert_bgr_scale(convert_t convert, struct convert_video_stream_s *video,
+			      unsigned char *from, unsigned char *to,
+			      unsigned int y0, unsigned int y1);
+static void convert_ycbcr_copy(convert_t convert, struct convert_video_stream_s *video,
+			       unsigned char *from, unsigned char *to,
+			       unsigned int y0, unsigned int y1);
+static void convert_ycbcr_half(convert_t convert, struct convert_video_stream_s *video,
+			       unsigned char *from, unsigned char *to,
+			       unsigned int y0, unsigned int y1);
+static void convert_ycbcr_scale(convert_t convert, struct convert_video_stream_s *video,
+				unsigned char *from, unsigned char *to,
+				unsigned int y0, unsigned int y1);
+
+int convert_init(convert_t *convert, glc_t *glc)
+{
+	*convert = (convert_t) calloc(1, sizeof(struct convert_s));
+
+	(*convert)->glc = glc;
+	(*convert)->scale = 1.0;
+
+	(*convert)->thread.flags = GLC_THREAD_READ | GLC_THREAD_WRITE;
+	(*convert)->thread.read_callback = &convert_read_callback;
+	(*convert)->thread.write_callback = &convert_write_callback;
+	(*convert)->thread.slice_callback = &convert_slice_callback;
+	(*convert)->thread.finish_callback = &convert_finish_callback;
+	(*convert)->thread.ptr = *convert;
+	(*convert)->thread.threads = glc_threads_hint(glc);
+	(*convert)->thread.name    = "convert";
+	(*convert)->thread.slice_threads = glc_slice_threads(glc);
+
+	return 0;
+}
+
+int convert_destroy(convert_t convert)
+{
+	free(convert->lookup_table);
+	free(convert);
+	return 0;
+}
+
+int convert_set_scale(convert_t convert, double factor)
+{
+	if (unlikely(factor <= 0))
+		return EINVAL;
+
+	convert->scale = factor;
+	convert->flags &= ~CONVERT_SIZE;
+	return 0;
+}
+
+int convert_set_size(convert_t convert, unsigned int width, unsigned int height)
+{
+	if (unlikely((!width) || (!height)))
+		return EINVAL;
+
+	convert->width = width;
+	convert->height = height;
+	convert->flags |= CONVERT_SIZE;
+	return 0;
+}
+
+int convert_override(convert_t convert, float brightness, float contrast,
+		     float red, float green, float blue)
+{
+	convert->brightness = brightness;
+	convert->contrast = contrast;
+	convert->red_gamma = red;
+	convert->green_gamma = green;
+	convert->blue_gamma = blue;
+
+	convert->flags |= CONVERT_OVERRIDE;
+	return 0;
+}
+
+int convert_override_clear(convert_t convert)
+{
+	convert->flags &= ~CONVERT_OVERRIDE;
+	return 0;
+}
+
+int convert_process_start(convert_t convert, ps_buffer_t *from, ps_buffer_t *to)
+{
+	int ret;
+	if (unlikely(convert->flags & CONVERT_RUNNING))
+		return EAGAIN;
+
+	if (unlikely((ret = glc_thread_create(convert->glc, &convert->thread, from, to))))
+		return ret;
+	convert->flags |= CONVERT_RUNNING;
+
+	return 0;
+}
+
+int convert_process_wait(convert_t convert)
+{
+	if (unlikely(!(convert->flags & CONVERT_RUNNING)))
+		return EAGAIN;
+
+	glc_thread_wait(&convert->thread);
+	convert->flags &= ~CONVERT_RUNNING;
+
+	return 0;
+}
+
+void convert_finish_callback(void *ptr, int err)
+{
+	convert_t convert = (convert_t) ptr;
+	struct convert_video_stream_s *del;
+
+	if (unlikely(err))
+		glc_log(convert->glc, GLC_ERROR, "convert", "%s (%d)", strerror(err), err);
+
+	while (convert->video != NULL) {
+		del = convert->video;
+		convert->video = convert->video->next;
+
+		free(del->pos);
+		free(del->cpos);
+		free(del->factor);
+
+		pthread_rwlock_destroy(&del->update);
+		free(del);
+	}
+}
+
+int convert_read_callback(glc_thread_state_t *state)
+{
+	convert_t convert = (convert_t) state->ptr;
+	struct convert_video_stream_s *video;
+	glc_video_frame_header_t *pic_hdr;
+
+	if (state->header.type == GLC_MESSAGE_COLOR) {
+		convert_color_message(convert, (glc_color_message_t *) state->read_data);
+
+		/* color correction is done here */
+		state->flags |= GLC_THREAD_STATE_SKIP_WRITE;
+		return 0;
+	}
+
+	if (state->header.type == GLC_MESSAGE_VIDEO_FORMAT)
+		return convert_video_format_message(convert,
+					(glc_video_format_message_t *) state->read_data,
+					state);
+
+	if (state->header.type == GLC_MESSAGE_VIDEO_FRAME) {
+		pic_hdr = (glc_video_frame_header_t *) state->read_data;
+		convert_get_video_stream(convert, pic_hdr->id, &video);
+		state->threadptr = video;
+
+		pthread_rwlock_rdlock(&video->update);
+
+		if (video->proc)
+			state->write_size = sizeof(glc_video_frame_header_t) + video->size;
+		else {
+			state->flags |= GLC_THREAD_COPY;
+			pthread_rwlock_unlock(&video->update);
+		}
+	} else
+		state->flags |= GLC_THREAD_COPY;
+
+	return 0;
+}
+
+int convert_write_callback(glc_thread_state_t *state)
+{
+	struct convert_video_stream_s *video = state->threadptr;
+	int ret;
+
+	memcpy(state->write_data, state->read_data, sizeof(glc_video_frame_header_t));
+
+	/* black borders */
+	if ((video->rw != video->sw) || (video->rh != video->sh))
+		memset(&state->write_data[sizeof(glc_video_frame_header_t)], 0, video->size);
+
+	ret = glc_thread_slice(state, video->sh);
+	pthread_rwlock_unlock(&video->update);
+
+	return ret;
+}
+
+int convert_slice_callback(glc_thread_state_t *state,
+			   unsigned int from, unsigned int to)
+{
+	struct convert_video_stream_s *video = state->threadptr;
+
+	video->proc(state->ptr, video,
+		    (unsigned char *) &state->read_data[sizeof(glc_video_frame_header_t)],
+		    (unsigned char *) &state->write_data[sizeof(glc_video_frame_header_t)],
+		    from, to);
+	return 0;
+}
+
+void convert_get_video_stream(convert_t convert, glc_stream_id_t id,
+			      struct convert_video_stream_s **video)
+{
+	/* only called from the read callback, never in parallel */
+	*video = convert->video;
+
+	while (*video != NULL) {
+		if ((*video)->id == id)
+			break;
+		*video = (*video)->next;
+	}
+
+	if (*video == NULL) {
+		*video = (struct convert_video_stream_s *)
+			calloc(1, sizeof(struct convert_video_stream_s));
+
+		(*video)->next = convert->video;
+		convert->video = *video;
+		(*video)->id = id;
+		(*video)->red_gamma = (*video)->green_gamma = (*video)->blue_gamma = 1.0;
+		pthread_rwlock_init(&(*video)->update, NULL);
+	}
+}
+
+int convert_video_format_message(convert_t convert,
+				 glc_video_format_message_t *format_message,
+				 glc_thread_state_t *state)
+{
+	struct convert_video_stream_s *video;
+	glc_flags_t old_flags;
+	int ret;
+
+	state->flags |= GLC_THREAD_COPY;
+
+	convert_get_video_stream(convert, format_message->id, &video);
+	pthread_rwlock_wrlock(&video->update);
+
+	old_flags = video->flags;
+	video->flags = format_message->flags;
+	video->format = format_message->format;
+	video->w = format_message->width;
+	video->h = format_message->height;
+	video->sampling = 0;
+	video->proc = NULL;
+
+	if (video->format == GLC_VIDEO_YCBCR_420JPEG) {
+		if ((!convert->lookup_table) &&
+		    (unlikely((ret = convert_init_lookup(convert))))) {
+			pthread_rwlock_unlock(&video->update);
+			return ret;
+		}
+		video->bpp = 3; /* what rgb would have produced */
+		video->row = video->w * 3;
+	} else if ((video->format == GLC_VIDEO_BGR) ||
+		   (video->format == GLC_VIDEO_BGRA)) {
+		video->bpp = (video->format == GLC_VIDEO_BGRA) ? 4 : 3;
+		video->row = video->w * video->bpp;
+		if ((format_message->flags & GLC_VIDEO_DWORD_ALIGNED) &&
+		    (video->row % 8 != 0))
+			video->row += 8 - video->row % 8;
+	} else {
+		glc_log(convert->glc, GLC_WARN, "convert",
+			 "unsupported video %d", format_message->id);
+		pthread_rwlock_unlock(&video->update);
+		return 0;
+	}
+
+	if (convert->flags & CONVERT_SIZE) {
+		video->rw = convert->width;
+		video->rh = convert->height;
+
+		if ((float) video->rw / (float) video->w < (float) video->rh / (float) video->h)
+			video->scale = (float) video->rw / (float) video->w;
+		else
+			video->scale = (float) video->rh / (float) video->h;
+
+		video->sw = video->scale * video->w;
+		video->sh = video->scale * video->h;
+		video->rx = (video->rw - video->sw) / 2;
+		video->ry = (video->rh - video->sh) / 2;
+	} else {
+		video->scale = convert->scale;
+		video->sw = video->scale * video->w;
+		video->sh = video->scale * video->h;
+
+		video->rx = video->ry = 0;
+		video->rw = video->sw;
+		video->rh = video->sh;
+	}
+
+	if ((video->scale == 0.5) && !(convert->flags & CONVERT_SIZE))
+		video->sampling = CONVERT_HALF;
+	else if ((video->rw == video->w) && (video->rh == video->h))
+		video->sampling = CONVERT_COPY;
+	else {
+		video->sampling = CONVERT_SCALE;
+		convert_generate_map(convert, video);
+	}
+
+	glc_log(convert->glc, GLC_DEBUG, "convert",
+		 "video %d: %ux%u to %ux%u BGR, picture %ux%u at %ux%u",
+		 video->id, video->w, video->h, video->rw, video->rh,
+		 video->sw, video->sh, video->rx, video->ry);
+
+	/* unconverted BGR keeps its layout so color correction can come and go */
+	if ((video->format == GLC_VIDEO_BGR) && (video->sampling == CONVERT_COPY))
+		video->orow = video->row;
+	else {
+		video->orow = video->rw * 3;
+		format_message->flags &= ~GLC_VIDEO_DWORD_ALIGNED;
+	}
+	video->size = video->orow * video->rh;
+
+	format_message->format = GLC_VIDEO_BGR;
+	format_message->width = video->rw;
+	format_message->height = video->rh;
+
+	if (convert->flags & CONVERT_OVERRIDE) {
+		video->brightness = convert->brightness;
+		video->contrast = convert->contrast;
+		video->red_gamma = convert->red_gamma;
+		video->green_gamma = convert->green_gamma;
+		video->blue_gamma = convert->blue_gamma;
+	}
+	convert_update(convert, video);
+
+	/* with a constant size, the next filter doesn't need to know */
+	if ((convert->flags & CONVERT_SIZE) && (video->created) &&
+	    (video->flags == old_flags))
+		state->flags |= GLC_THREAD_STATE_SKIP_WRITE;
+	video->created = 1;
+
+	pthread_rwlock_unlock(&video->update);
+	return 0;
+}
+
+int convert_color_message(convert_t convert, glc_color_message_t *color_message)
+{
+	struct convert_video_stream_s *video;
+
+	if (convert->flags & CONVERT_OVERRIDE)
+		return 0; /* ignore */
+
+	convert_get_video_stream(convert, color_message->id, &video);
+	pthread_rwlock_wrlock(&video->update);
+
+	video->brightness = color_message->brightness;
+	video->contrast = color_message->contrast;
+	video->red_gamma = color_message->red;
+	video->green_gamma = color_message->green;
+	video->blue_gamma = color_message->blue;
+	convert_update(convert, video);
+
+	pthread_rwlock_unlock(&video->update);
+	return 0;
+}
+
+/* pick the proc matching the source format, sampling and color correction */
+void convert_update(convert_t convert, struct convert_video_stream_s *video)
+{
+	int correct = (video->brightness != 0) || (video->contrast != 0) ||
+		      (video->red_gamma != 1) || (video->green_gamma != 1) ||
+		      (video->blue_gamma != 1);
+
+	if (correct)
+		glc_log(convert->glc, GLC_INFO, "convert",
+			 "video stream %d: brightness=%f, contrast=%f, red=%f, green=%f, blue=%f",
+			 video->id, video->brightness, video->contrast,
+			 video->red_gamma, video->green_gamma, video->blue_gamma);
+	convert_generate_color_table(video, correct);
+
+	video->proc = NULL;
+	if (video->format == GLC_VIDEO_YCBCR_420JPEG) {
+		if (video->sampling == CONVERT_COPY)
+			video->proc = &convert_ycbcr_copy;
+		else if (video->sampling == CONVERT_HALF)
+			video->proc = &convert_ycbcr_half;
+		else if (video->sampling == CONVERT_SCALE)
+			video->proc = &convert_ycbcr_scale;
+	} else if ((video->format == GLC_VIDEO_BGR) ||
+		   (video->format == GLC_VIDEO_BGRA)) {
+		if (video->sampling == CONVERT_COPY) {
+			/* nothing at all to do for plain BGR */
+			if ((video->format == GLC_VIDEO_BGRA) || (correct))
+				video->proc = &convert_bgr_copy;
+		} else if (video->sampling == CONVERT_HALF)
+			video->proc = &convert_bgr_half;
+		else if (video->sampling == CONVERT_SCALE)
+			video->proc = &convert_bgr_scale;
+	}
+}
+
+int convert_init_lookup(convert_t convert)
+{
+	unsigned int Y, Cb, Cr, pos;
+	size_t lookup_size = (1 << LOOKUP_BITS) * (1 << LOOKUP_BITS) * (1 << LOOKUP_BITS) * 3;
+
+	glc_log(convert->glc, GLC_INFO, "convert",
+		 "using %d bit lookup table (%zd bytes)", LOOKUP_BITS, lookup_size);
+	if (unlikely(!(convert->lookup_table = malloc(lookup_size))))
+		return ENOMEM;
+
+	pos = 0;
+	for (Y = 0; Y < 256; Y += (1 << (8 - LOOKUP_BITS))) {
+		for (Cb = 0; Cb < 256; Cb += (1 << (8 - LOOKUP_BITS))) {
+			for (Cr = 0; Cr < 256; Cr += (1 << (8 - LOOKUP_BITS))) {
+				convert->lookup_table[pos + 0] = YCbCrJPEG_TO_RGB_Rd(Y, Cb, Cr);
+				convert->lookup_table[pos + 1] = YCbCrJPEG_TO_RGB_Gd(Y, Cb, Cr);
+				convert->lookup_table[pos + 2] = YCbCrJPEG_TO_RGB_Bd(Y, Cb, Cr);
+				pos += 3;
+			}
+		}
+	}
+	return 0;
+}
+
+void convert_generate_color_table(struct convert_video_stream_s *video,
+				  int correct)
+{
+	unsigned int c;
+	double val;
+
+	if (!correct) {
+		for (c = 0; c < 256; c++)
+			video->lookup_table[c] = video->lookup_table[c + 256] =
+				video->lookup_table[c + 256 + 256] = c;
+		return;
+	}
+
+#define CALC(value, gamma) \
+	((((pow((double) value / 255.0, 1.0 / gamma) - 0.5) * (1.0 + video->contrast) + 0.5) \
+	  + video->brightness) * 255.0)
+#define CLAMP(val) \
+	((val) > 255 ? 255 : ((val) < 0 ? 0 : (unsigned char) (val)))
+
+	for (c = 0; c < 256; c++) {
+		val = CALC(c, video->red_gamma);
+		video->lookup_table[c] = CLAMP((int) val);
+		val = CALC(c, video->green_gamma);
+		video->lookup_table[c + 256] = CLAMP((int) val);
+		val = CALC(c, video->blue_gamma);
+		video->lookup_table[c + 256 + 256] = CLAMP((int) val);
+	}
+
+#undef CLAMP
+#undef CALC
+}
+
+int convert_generate_map(convert_t convert, struct convert_video_stream_s *video)
+{
+	float ofx, ofy, fx0, fx1, fy0, fy1;
+	unsigned int tp, x, y, r, s, sx, sy, yy;
+	float d;
+	size_t smap_size = video->sw * video->sh * 4;
+
+	glc_log(convert->glc, GLC_DEBUG, "convert",
+		 "generating %zd + %zd byte scale map for video stream %d",
+		 smap_size * sizeof(unsigned int), smap_size * sizeof(float), video->id);
+
+	video->pos = (unsigned int *) realloc(video->pos, sizeof(unsigned int) * smap_size);
+	video->factor = (float *) realloc(video->factor, sizeof(float) * smap_size);
+	if (video->format == GLC_VIDEO_YCBCR_420JPEG)
+		video->cpos = (unsigned int *) realloc(video->cpos,
+						       sizeof(unsigned int) * smap_size);
+
+	r = 0;
+	do {
+		d = (float) (video->w - r++) / (float) video->sw;
+	} while ((d * (float) (video->sh - 1) + 1.0 > video->h) |
+		 (d * (float) (video->sw - 1) + 1.0 > video->w));
+
+	ofx = ofy = 0;
+	for (y = 0; y < video->sh; y++) {
+		for (x = 0; x < video->sw; x++) {
+			tp = (x + y * video->sw) * 4;
+
+			/* samples are (ofx, ofy), (ofx + 1, ofy), (ofx, ofy + 1), (ofx + 1, ofy + 1) */
+			for (s = 0; s < 4; s++) {
+				sx = (unsigned int) ofx + (s & 1);
+				sy = (unsigned int) ofy + (s >> 1);
+
+				if (video->format == GLC_VIDEO_YCBCR_420JPEG) {
+					/* Y'CbCr rows are stored top to bottom */
+					yy = video->h - 1 - sy;
+					video->pos[tp + s] = sx + yy * video->w;
+					video->cpos[tp + s] = sx / 2 + (yy / 2) * (video->w / 2);
+				} else
+					video->pos[tp + s] = sx * video->bpp + sy * video->row;
+			}
+
+			fx1 = (float) x * d - (float) ((unsigned int) ofx);
+			fx0 = 1.0 - fx1;
+			fy1 = (float) y * d - (float) ((unsigned int) ofy);
+			fy0 = 1.0 - fy1;
+
+			video->factor[tp + 0] = fx0 * fy0;
+			video->factor[tp + 1] = fx1 * fy0;
+			video->factor[tp + 2] = fx0 * fy1;
+			video->factor[tp + 3] = fx1 * fy1;
+
+			ofx += d;
+		}
+		ofy += d;
+		ofx = 0;
+	}
+
+	return 0;
+}
+
+/*
+ * Procs write rows [y0, y1) of the scaled picture. Source pixels are
+ * read as BGR, Y'CbCr ones through the lookup table, and go through
+ * the color table on their way out.
+ */
+#define PUT_BGR(tp, B, G, R) \
+	to[(tp) + 0] = video->lookup_table[256 + 256 + (B)]; \
+	to[(tp) + 1] = video->lookup_table[256       + (G)]; \
+	to[(tp) + 2] = video->lookup_table[            (R)];
+
+#define GET_YCBCR(yp, cp, B, G, R) \
+	c = LOOKUP_POS(from[yp], Cb[cp], Cr[cp]); \
+	R = convert->lookup_table[c + 0]; \
+	G = convert->lookup_table[c + 1]; \
+	B = convert->lookup_table[c + 2];
+
+#define SCALE_SAMPLES(sp, s0, s1, s2, s3) \
+	((s0) * video->factor[(sp) + 0] + \
+	 (s1) * video->factor[(sp) + 1] + \
+	 (s2) * video->factor[(sp) + 2] + \
+	 (s3) * video->factor[(sp) + 3])
+
+void convert_bgr_copy(convert_t convert, struct convert_video_stream_s *video,
+		      unsigned char *from, unsigned char *to,
+		      unsigned int y0, unsigned int y1)
+{
+	unsigned int x, y, op, tp;
+
+	for (y = y0; y < y1; y++) {
+		op = y * video->row;
+		tp = y * video->orow;
+		for (x = 0; x < video->w; x++) {
+			PUT_BGR(tp, from[op + 0], from[op + 1], from[op + 2])
+			op += video->bpp;
+			tp += 3;
+		}
+	}
+}
+
+void convert_bgr_half(convert_t convert, struct convert_video_stream_s *video,
+		      unsigned char *from, unsigned char *to,
+		      unsigned int y0, unsigned int y1)
+{
+	unsigned int x, y, op1, op2, op3, op4, tp;
+
+	for (y = y0; y < y1; y++) {
+		tp = y * video->orow;
+		for (x = 0; x < video->sw; x++) {
+			op1 = x * 2 * video->bpp + y * 2 * video->row;
+			op2 = op1 + video->bpp;
+			op3 = op1 + video->row;
+			op4 = op2 + video->row;
+
+			PUT_BGR(tp,
+				(from[op1 + 0] + from[op2 + 0] + from[op3 + 0] + from[op4 + 0]) >> 2,
+				(from[op1 + 1] + from[op2 + 1] + from[op3 + 1] + from[op4 + 1]) >> 2,
+				(from[op1 + 2] + from[op2 + 2] + from[op3 + 2] + from[op4 + 2]) >> 2)
+			tp += 3;
+		}
+	}
+}
+
+void convert_bgr_scale(convert_t convert, struct convert_video_stream_s *video,
+		       unsigned char *from, unsigned char *to,
+		       unsigned int y0, unsigned int y1)
+{
+	unsigned int x, y, sp, tp;
+	unsigned int *pos;
+	unsigned char B, G, R;
+
+	for (y = y0; y < y1; y++) {
+		for (x = 0; x < video->sw; x++) {
+			sp = (x + y * video->sw) * 4;
+			tp = (x + video->rx) * 3 + (y + video->ry) * video->orow;
+			pos = &video->pos[sp];
+
+			B = SCALE_SAMPLES(sp, from[pos[0] + 0], from[pos[1] + 0],
+					      from[pos[2] + 0], from[pos[3] + 0]);
+			G = SCALE_SAMPLES(sp, from[pos[0] + 1], from[pos[1] + 1],
+					      from[pos[2] + 1], from[pos[3] + 1]);
+			R = SCALE_SAMPLES(sp, from[pos[0] + 2], from[pos[1] + 2],
+					      from[pos[2] + 2], from[pos[3] + 2]);
+			PUT_BGR(tp, B, G, R)
+		}
+	}
+}
+
+void convert_ycbcr_copy(convert_t convert, struct convert_video_stream_s *video,
+			unsigned char *from, unsigned char *to,
+			unsigned int y0, unsigned int y1)
+{
+	unsigned int x, y, yy, yp, cp, tp, c;
+	unsigned char *Cb, *Cr;
+	unsigned char B, G, R;
+
+	Cb = &from[video->w * video->h];
+	Cr = &Cb[(video->w / 2) * (video->h / 2)];
+
+	for (y = y0; y < y1; y++) {
+		/* BGR is stored bottom to top */
+		yy = video->h - 1 - y;
+		yp = yy * video->w;
+		cp = (yy / 2) * (video->w / 2);
+		tp = y * video->orow;
+		for (x = 0; x < video->w; x++) {
+			GET_YCBCR(yp + x, cp + x / 2, B, G, R)
+			PUT_BGR(tp, B, G, R)
+			tp += 3;
+		}
+	}
+}
+
+void convert_ycbcr_half(convert_t convert, struct convert_video_stream_s *video,
+			unsigned char *from, unsigned char *to,
+			unsigned int y0, unsigned int y1)
+{
+	unsigned int x, y, yy, yp1, yp2, cp1, cp2, tp, c;
+	unsigned char *Cb, *Cr;
+	unsigned char B[4], G[4], R[4];
+
+	Cb = &from[video->w * video->h];
+	Cr = &Cb[(video->w / 2) * (video->h / 2)];
+
+	for (y = y0; y < y1; y++) {
+		/* BGR rows 2y and 2y + 1 */
+		yy = video->h - 1 - y * 2;
+		yp1 = yy * video->w;
+		yp2 = yp1 - video->w;
+		cp1 = (yy / 2) * (video->w / 2);
+		cp2 = ((yy - 1) / 2) * (video->w / 2);
+		tp = y * video->orow;
+		for (x = 0; x < video->sw; x++) {
+			GET_YCBCR(yp1 + x * 2, cp1 + x, B[0], G[0], R[0])
+			GET_YCBCR(yp1 + x * 2 + 1, cp1 + x, B[1], G[1], R[1])
+			GET_YCBCR(yp2 + x * 2, cp2 + x, B[2], G[2], R[2])
+			GET_YCBCR(yp2 + x * 2 + 1, cp2 + x, B[3], G[3], R[3])
+
+			PUT_BGR(tp, (B[0] + B[1] + B[2] + B[3]) >> 2,
+				    (G[0] + G[1] + G[2] + G[3]) >> 2,
+				    (R[0] + R[1] + R[2] + R[3]) >> 2)
+			tp += 3;
+		}
+	}
+}
+
+void convert_ycbcr_scale(convert_t convert, struct convert_video_stream_s *video,
+			 unsigned char *from, unsigned char *to,
+			 unsigned int y0, unsigned int y1)
+{
+	unsigned int x, y, sp, tp, s, c;
+	unsigned char *Cb, *Cr;
+	unsigned char B[4], G[4], R[4];
+
+	Cb = &from[video->w * video->h];
+	Cr = &Cb[(video->w / 2) * (video->h / 2)];
+
+	for (y = y0; y < y1; y++) {
+		for (x = 0; x < video->sw; x++) {
+			sp = (x + y * video->sw) * 4;
+			tp = (x + video->rx) * 3 + (y + video->ry) * video->orow;
+
+			for (s = 0; s < 4; s++) {
+				GET_YCBCR(video->pos[sp + s], video->cpos[sp + s], B[s], G[s], R[s])
+			}
+
+			PUT_BGR(tp,
+				(unsigned char) SCALE_SAMPLES(sp, B[0], B[1], B[2], B[3]),
+				(unsigned char) SCALE_SAMPLES(sp, G[0], G[1], G[2], G[3]),
+				(unsigned char) SCALE_SAMPLES(sp, R[0], R[1], R[2], R[3]))
+		}
+	}
+}
+
+#undef SCALE_SAMPLES
+#undef GET_YCBCR
+#undef PUT_BGR
+
+/**  \} */
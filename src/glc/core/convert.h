@@ -0,0 +1,120 @@
+/**
+ * \file glc/core/convert.h
+ * \brief convert to BGR, scale and color correct in one pass
+ * \author Olivier Langlois <olivier@trillion01.com>
+ * \date 2014
+ * For conditions of distribution and use, see copyright notice in glc.h
+ */
+
+/**
+ * \addtogroup core
+ *  \{
+ * \defgroup convert convert, scale and color correct
+ *  \{
+ */
+
+#ifndef _CONVERT_H
+#define _CONVERT_H
+
+#include <packetstream.h>
+#include <glc/common/glc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief convert object
+ */
+typedef struct convert_s* convert_t;
+
+/**
+ * \brief initialize convert object
+ * \param convert convert object
+ * \param glc glc
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int convert_init(convert_t *convert, glc_t *glc);
+
+/**
+ * \brief set scaling factor
+ *
+ * Works like scale_set_scale().
+ * \param convert convert object
+ * \param factor scaling factor
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int convert_set_scale(convert_t convert, double factor);
+
+/**
+ * \brief set scale size
+ *
+ * Works like scale_set_size(), aspect ratio is preserved
+ * with black borders.
+ * \param convert convert object
+ * \param width width
+ * \param height height
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int convert_set_size(convert_t convert, unsigned int width,
+			      unsigned int height);
+
+/**
+ * \brief override color correction
+ *
+ * Works like color_override().
+ * \param convert convert object
+ * \param brightness brightness value
+ * \param contrast contrast value
+ * \param red red gamma
+ * \param green green gamma
+ * \param blue blue gamma
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int convert_override(convert_t convert, float brightness, float contrast,
+			      float red, float green, float blue);
+
+/**
+ * \brief clear override
+ * \param convert convert object
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int convert_override_clear(convert_t convert);
+
+/**
+ * \brief start convert process
+ *
+ * convert does the work of rgb, scale and color: Y'CbCr and BGRA
+ * frames become BGR, frames are rescaled and color corrected, and
+ * color messages are consumed. Each output pixel is computed in a
+ * single pass over the source frame, without intermediate buffers.
+ * \param convert convert object
+ * \param from source buffer
+ * \param to target buffer
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int convert_process_start(convert_t convert, ps_buffer_t *from,
+				   ps_buffer_t *to);
+
+/**
+ * \brief block until process has finished
+ * \param convert convert object
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int convert_process_wait(convert_t convert);
+
+/**
+ * \brief destroy convert object
+ * \param convert convert object
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int convert_destroy(convert_t convert);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/**  \} */
+/**  \} */
@@ -110,6 +110,7 @@ int copy_process_start(copy_t copy, ps_buffer_t *from)
 		return EALREADY;
 
 	copy->from = from;
+	copy->thread.name = "copy";
 
 	return glc_simple_thread_create(copy->glc, &copy->thread,
 				 copy_thread, copy);
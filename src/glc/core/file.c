@@ -86,6 +86,7 @@ typedef struct {
 	tracker_t state_tracker;
 	callback_request_func_t callback;
 	int sync;
+	glc_size_t written;
 } file_sink_t;
 
 typedef struct {
@@ -114,6 +115,7 @@ static int file_write_eof(sink_t sink);
 static int file_write_state(sink_t sink);
 static int file_write_process_start(sink_t sink, ps_buffer_t *from);
 static int file_write_process_wait(sink_t sink);
+static int file_get_written(sink_t sink, glc_size_t *bytes);
 static int file_sink_destroy(sink_t sink);
 
 static int file_set_source(struct file_private_s *mpriv, int fd);
@@ -135,6 +137,7 @@ static sink_ops_t file_sink_ops = {
 	.write_state         = file_write_state,
 	.write_process_start = file_write_process_start,
 	.write_process_wait  = file_write_process_wait,
+	.get_written         = file_get_written,
 	.destroy             = file_sink_destroy,
 };
 
@@ -160,6 +163,7 @@ int file_sink_init(sink_t *sink, glc_t *glc)
 	file->thread.read_callback   = &file_read_callback;
 	file->thread.finish_callback = &file_finish_callback;
 	file->thread.threads = 1;
+	file->thread.name    = "sink";
 
 	tracker_init(&file->state_tracker, file->mpriv.glc);
 
@@ -469,6 +473,13 @@ int file_write_process_wait(sink_t sink)
 	return 0;
 }
 
+int file_get_written(sink_t sink, glc_size_t *bytes)
+{
+	file_sink_t *file = (file_sink_t*)sink;
+	*bytes = __sync_fetch_and_add(&file->written, 0);
+	return 0;
+}
+
 void file_finish_callback(void *ptr, int err)
 {
 	file_sink_t *file = (file_sink_t*) ptr;
@@ -504,6 +515,8 @@ int file_read_callback(glc_thread_state_t *state)
 			1, file->mpriv.handle)
 		    != 1))
 			goto err;
+		__sync_fetch_and_add(&file->written,
+			sizeof(glc_container_message_header_t) + container->size);
 		if (unlikely(file->sync))
 			if (unlikely(fflush_unlocked(file->mpriv.handle)))
 				goto err;
@@ -520,6 +533,8 @@ int file_read_callback(glc_thread_state_t *state)
 		if (unlikely(fwrite_unlocked(state->read_data,
 				   state->read_size, 1, file->mpriv.handle) != 1))
 			goto err;
+		__sync_fetch_and_add(&file->written, sizeof(glc_size_t) +
+				     sizeof(glc_message_header_t) + state->read_size);
 		if (unlikely(file->sync))
 			if (unlikely(fflush_unlocked(file->mpriv.handle)))
 				goto err;
@@ -59,6 +59,7 @@ struct info_video_stream_s {
 	unsigned int w, h;
 
 	unsigned long pictures;
+	unsigned long repeats;
 	size_t bytes;
 
 	unsigned long fps;
@@ -97,7 +98,8 @@ static void info_finish_callback(void *ptr, int err);
 static int info_read_callback();
 
 static void video_format_info(info_t info, glc_video_format_message_t *video_message);
-static void video_frame_info(info_t info, glc_video_frame_header_t *pic_header);
+static void video_frame_info(info_t info, glc_video_frame_header_t *pic_header,
+			     int repeat);
 static void audio_format_info(info_t info, glc_audio_format_message_t *fmt_message);
 static void audio_data_info(info_t info, glc_audio_data_header_t *audio_header);
 static void color_info(info_t info, glc_color_message_t *color_msg);
@@ -121,6 +123,7 @@ int info_init(info_t *info, glc_t *glc)
 	(*info)->thread.read_callback = &info_read_callback;
 	(*info)->thread.finish_callback = &info_finish_callback;
 	(*info)->thread.threads = 1;
+	(*info)->thread.name    = "info";
 
 	return 0;
 }
@@ -186,6 +189,8 @@ void info_finish_callback(void *ptr, int err)
 
 		fprintf(info->stream, "video stream %d\n", video->id);
 		fprintf(info->stream, "  frames      = %lu\n", video->pictures);
+		if (video->repeats)
+			fprintf(info->stream, "  repeats     = %lu\n", video->repeats);
 		fprintf(info->stream, "  fps         = %04.2f\n",
 		       (double) (video->pictures) / (double) (info->time/1000000000.0));
 		fprintf(info->stream, "  bytes       = ");
@@ -220,7 +225,9 @@ int info_read_callback(glc_thread_state_t *state)
 	if (state->header.type == GLC_MESSAGE_VIDEO_FORMAT)
 		video_format_info(info, (glc_video_format_message_t *) state->read_data);
 	else if (state->header.type == GLC_MESSAGE_VIDEO_FRAME)
-		video_frame_info(info, (glc_video_frame_header_t *) state->read_data);
+		video_frame_info(info, (glc_video_frame_header_t *) state->read_data, 0);
+	else if (state->header.type == GLC_MESSAGE_VIDEO_REPEAT)
+		video_frame_info(info, (glc_video_frame_header_t *) state->read_data, 1);
 	else if (state->header.type == GLC_MESSAGE_AUDIO_FORMAT)
 		audio_format_info(info, (glc_audio_format_message_t *) state->read_data);
 	else if (state->header.type == GLC_MESSAGE_AUDIO_DATA)
@@ -326,6 +333,7 @@ void video_format_info(info_t info, glc_video_format_message_t *format_message)
 		}
 		fprintf(info->stream, "  flags       = ");
 		INFO_FLAG(format_message->flags, GLC_VIDEO_DWORD_ALIGNED)
+		INFO_FLAG(format_message->flags, GLC_VIDEO_REPEATS)
 		fprintf(info->stream, "\n");
 		fprintf(info->stream, "  width       = %u\n", format_message->width);
 		fprintf(info->stream, "  height      = %u\n", format_message->height);
@@ -333,7 +341,8 @@ void video_format_info(info_t info, glc_video_format_message_t *format_message)
 		fprintf(info->stream, "video stream %d\n", format_message->id);
 }
 
-void video_frame_info(info_t info, glc_video_frame_header_t *pic_header)
+void video_frame_info(info_t info, glc_video_frame_header_t *pic_header,
+		      int repeat)
 {
 	struct info_video_stream_s *video;
 	info->time = pic_header->time;
@@ -342,20 +351,23 @@ void video_frame_info(info_t info, glc_video_frame_header_t *pic_header)
 
 	if (info->level >= INFO_DETAILED_PICTURE) {
 		print_time(info->stream, info->time);
-		fprintf(info->stream, "picture\n");
+		fprintf(info->stream, repeat ? "repeated picture\n" : "picture\n");
 
 		fprintf(info->stream, "  stream id   = %d\n", pic_header->id);
 		fprintf(info->stream, "  time        = %" PRIu64 "\n", pic_header->time);
 		fprintf(info->stream, "  size        = %ux%u\n", video->w, video->h);
 	} else if (info->level >= INFO_PICTURE) {
 		print_time(info->stream, info->time);
-		fprintf(info->stream, "picture (video %d)\n", pic_header->id);
+		fprintf(info->stream, "%s (video %d)\n",
+			repeat ? "repeated picture" : "picture", pic_header->id);
 	}
 
 	video->pictures++;
 	video->fps++;
 
-	if (video->format == GLC_VIDEO_BGR) {
+	if (repeat)
+		video->repeats++;
+	else if (video->format == GLC_VIDEO_BGR) {
 		video->bytes += video->w * video->h * 3;
 		if (video->flags & GLC_VIDEO_DWORD_ALIGNED)
 			video->bytes += video->h * (8 - (video->w * 3) % 8);
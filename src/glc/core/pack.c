@@ -35,12 +35,17 @@
 #include <errno.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+#include <limits.h>
 
 #include <glc/common/glc.h>
 #include <glc/common/core.h>
 #include <glc/common/log.h>
 #include <glc/common/thread.h>
+#include <glc/common/state.h>
 #include <glc/common/util.h>
+#include <glc/common/probe.h>
 #include <glc/common/optimization.h>
 
 #include "pack.h"
@@ -48,14 +53,14 @@
 #ifdef __MINILZO
 # include <minilzo.h>
 # define __lzo_compress lzo1x_1_compress
-# define __lzo_decompress lzo1x_decompress
+# define __lzo_decompress lzo1x_decompress_safe
 # define __lzo_worstcase(size) size + (size / 16) + 64 + 3
 # define __lzo_wrk_mem LZO1X_1_MEM_COMPRESS
 # define __LZO
 #elif defined __LZO
 # include <lzo/lzo1x.h>
 # define __lzo_compress lzo1x_1_11_compress
-# define __lzo_decompress lzo1x_decompress
+# define __lzo_decompress lzo1x_decompress_safe
 # define __lzo_worstcase(size) size + (size / 16) + 64 + 3
 # define __lzo_wrk_mem LZO1X_1_11_MEM_COMPRESS
 #endif
@@ -69,6 +74,41 @@
 # include <lzjb.h>
 #endif
 
+#ifdef __LZ4
+# include <lz4.h>
+# include <lz4hc.h>
+# define __lz4_worstcase(size) LZ4_compressBound(size)
+#endif
+
+#ifdef __ZSTD
+# include <zstd.h>
+# define __zstd_worstcase(size) ZSTD_compressBound(size)
+#endif
+
+/* delta tile size, in bytes and rows */
+#define PACK_TILE_WIDTH  128
+#define PACK_TILE_HEIGHT  16
+
+/* smaller chunks lose too much ratio for what they save in time */
+#define PACK_CHUNK_MIN   (256 * 1024)
+#define PACK_CHUNK_ALIGN 4096
+
+/* configured level, faster levels and store only */
+#define PACK_GOVERNOR_STEPS     8
+/* time the averages get to follow a step before the next one */
+#define PACK_GOVERNOR_HOLD_DOWN   500000000ULL
+/* time under half the target before stepping back up, doubled when
+   stepping up didn't last */
+#define PACK_GOVERNOR_HOLD_UP    2000000000ULL
+#define PACK_GOVERNOR_HOLD_MAX  32000000000ULL
+/* a pack thread that waited this long for a frame found the buffer empty */
+#define PACK_GOVERNOR_IDLE          1000000ULL
+
+/* faster levels than the configured one, tried in order, 0 ends */
+static const int pack_governor_zstd[] = {1, -1, -4, -16, 0};
+static const int pack_governor_lz4hc[] = {6, 3, 0};
+static const int pack_governor_lz4[] = {4, 16, 64, 0}; /* acceleration */
+
 struct pack_stat_s {
 	uint64_t pack_size;
 	uint64_t unpack_size;
@@ -76,13 +116,94 @@ struct pack_stat_s {
 
 typedef struct pack_stat_s pack_stat_t;
 
+struct pack_governor_s {
+	glc_utime_t target; /* 0 when disabled */
+	pthread_mutex_t mutex;
+	int steps, step; /* the last step stores frames */
+	int level[PACK_GOVERNOR_STEPS];
+	uint64_t frames[PACK_GOVERNOR_STEPS];
+
+	/* averages over the last frames */
+	glc_utime_t latency, queue, compress;
+	/* age of the frames reaching an idle pack thread, the readback
+	   delay of the capture which is not counted as queue time */
+	glc_utime_t capture;
+	glc_utime_t changed, headroom, hold_up;
+	int stepped_up;
+};
+
+/* delta coding reference, only touched from pack_read_callback() */
+struct pack_video_s {
+	glc_stream_id_t id;
+	glc_delta_header_t layout;
+	size_t size;
+	char *ref;
+	unsigned int frames; /* since last keyframe */
+
+	struct pack_video_s *next;
+};
+
+struct pack_thread_s {
+	void *wrk;	/* compressor work memory, ZSTD_CCtx for zstd */
+	int level;	/* applied to the ZSTD_CCtx, 0 if none yet */
+	glc_utime_t queue; /* time the frame waited in the input buffer */
+	glc_utime_t opened; /* when the thread started waiting for a packet */
+
+	/* set by pack_read_callback() when the frame is delta coded */
+	int delta;
+	glc_delta_header_t delta_header;
+	unsigned char *bitmap;
+	size_t bitmap_size;
+	char *buf;
+	size_t buf_size;
+
+	/* set by pack_read_callback() when the frame is cut in chunks */
+	unsigned int chunks;
+	size_t chunk_size, chunk_slot;
+
+	struct pack_thread_s *next; /* idle chunk compressors */
+};
+
 struct pack_s {
 	glc_t *glc;
 	glc_thread_t thread;
 	size_t compress_min;
 	int running;
 	int compression;
+	int level, long_distance;
 	pack_stat_t stats;
+
+	unsigned int keyframe_interval;
+	int (*compress_callback)(glc_thread_state_t *state);
+	struct pack_video_s *video_list;
+	uint64_t tiles, changed_tiles;
+
+	unsigned int chunks;
+	pthread_mutex_t chunk_mutex;
+	struct pack_thread_s *chunk_wrk;
+
+	struct pack_governor_s governor;
+};
+
+/* frame being rebuilt, same order as in stream */
+struct unpack_video_s {
+	glc_stream_id_t id;
+	char *ref;
+	size_t size;
+	unsigned long next_seq, done_seq;
+
+	struct unpack_video_s *next;
+};
+
+struct unpack_thread_s {
+	void *qlz;
+	void *dctx;	/* ZSTD_DCtx */
+	struct unpack_video_s *video;
+	unsigned long seq;
+	char *buf;
+	size_t buf_size;
+
+	struct unpack_thread_s *next; /* idle chunk decompressors */
 };
 
 struct unpack_s {
@@ -90,25 +211,220 @@ struct unpack_s {
 	glc_thread_t thread;
 	int running;
 	pack_stat_t stats;
+
+	struct unpack_video_s *video_list;
+	pthread_mutex_t video_mutex;
+	pthread_cond_t video_cond;
+
+	pthread_mutex_t chunk_mutex;
+	struct unpack_thread_s *chunk_wrk;
 };
 
 static int pack_thread_create_callback(void *ptr, void **threadptr);
 static void pack_thread_finish_callback(void *ptr, void *threadptr, int err);
+static int pack_open_callback(glc_thread_state_t *state);
 static int pack_read_callback(glc_thread_state_t *state);
+static int pack_write_callback(glc_thread_state_t *state);
 static int pack_quicklz_write_callback(glc_thread_state_t *state);
 static int pack_lzo_write_callback(glc_thread_state_t *state);
 static int pack_lzjb_write_callback(glc_thread_state_t *state);
+static int pack_lz4_write_callback(glc_thread_state_t *state);
+static int pack_zstd_write_callback(glc_thread_state_t *state);
+static int pack_delta_write_callback(glc_thread_state_t *state);
+static int pack_chunked_write_callback(glc_thread_state_t *state);
+static int pack_chunked_slice_callback(glc_thread_state_t *state,
+				       unsigned int from, unsigned int to);
 static void pack_finish_callback(void *ptr, int err);
 
+static size_t delta_tiles(const glc_delta_header_t *layout);
+static size_t pack_worstcase(pack_t pack, size_t size);
+static size_t pack_compress(pack_t pack, struct pack_thread_s *thread,
+			    const char *from, size_t size, char *to);
+static glc_message_type_t pack_message_type(pack_t pack);
+static int pack_level(pack_t pack);
+static void pack_governor_init(pack_t pack);
+static void pack_governor_sample(pack_t pack, glc_utime_t queue,
+				 glc_utime_t compress);
+static const char *pack_governor_describe(pack_t pack, int step,
+					  char *buf, size_t size);
+static void pack_chunked_read(pack_t pack, glc_thread_state_t *state);
+static struct pack_thread_s *pack_chunk_wrk_get(pack_t pack);
+static void pack_chunk_wrk_put(pack_t pack, struct pack_thread_s *wrk);
+static void pack_video_format(pack_t pack, glc_video_format_message_t *format);
+static int pack_delta_read(pack_t pack, glc_thread_state_t *state);
+static size_t pack_delta_diff(const glc_delta_header_t *layout, const char *frame,
+			      char *ref, unsigned char *bitmap, unsigned int *changed);
+static void pack_delta_gather(const glc_delta_header_t *layout,
+			      const unsigned char *bitmap, const char *frame,
+			      char *to);
+static int unpack_delta_check(const glc_delta_header_t *layout,
+			      size_t payload_size);
+static int unpack_delta_scatter(const glc_delta_header_t *layout,
+				const unsigned char *bitmap, const char *from,
+				size_t size, char *frame);
+
+static int unpack_thread_create_callback(void *ptr, void **threadptr);
 static void unpack_thread_finish_callback(void *ptr, void *threadptr, int err);
 static int unpack_read_callback(glc_thread_state_t *state);
 static int unpack_write_callback(glc_thread_state_t *state);
+static int unpack_delta_write_callback(glc_thread_state_t *state);
+static int unpack_chunked_write_callback(glc_thread_state_t *state);
+static int unpack_chunked_slice_callback(glc_thread_state_t *state,
+					 unsigned int from, unsigned int to);
 static void unpack_finish_callback(void *ptr, int err);
+static int unpack_decompress(struct unpack_thread_s *thread,
+			     glc_message_type_t compression, const char *from,
+			     size_t size, char *to, size_t to_size);
+static struct unpack_thread_s *unpack_chunk_wrk_get(unpack_t unpack);
+static void unpack_chunk_wrk_put(unpack_t unpack, struct unpack_thread_s *wrk);
 static void print_stats(glc_t *glc, pack_stat_t *stat);
 
+/*
+ * Checks everything unpack_delta_scatter() relies on but the tile data,
+ * planes and tiles then stay inside a frame_size frame.
+ */
+int unpack_delta_check(const glc_delta_header_t *layout, size_t payload_size)
+{
+	size_t frame_size, data_size, offset = 0, plane_size, bitmap_size;
+	unsigned int p;
+
+	if (unlikely((layout->size < sizeof(glc_video_frame_header_t)) ||
+		     (!layout->planes) || (layout->planes > GLC_DELTA_MAX_PLANES) ||
+		     (!layout->tile_width) || (!layout->tile_height)))
+		return EINVAL;
+	frame_size = layout->size - sizeof(glc_video_frame_header_t);
+
+	for (p = 0; p < layout->planes; p++) {
+		const glc_delta_plane_t *plane = &layout->plane[p];
+
+		plane_size = (size_t) plane->stride * plane->height;
+		if (unlikely((plane->width > plane->stride) ||
+			     (plane_size > frame_size - offset)))
+			return EINVAL;
+		offset += plane_size;
+	}
+	bitmap_size = (delta_tiles(layout) + 7) / 8;
+
+	/* stored payloads are used in place */
+	if (unlikely((!layout->compression) && (layout->delta_size > payload_size)))
+		return EINVAL;
+
+	if (unlikely(layout->delta_size < sizeof(glc_video_frame_header_t)))
+		return EINVAL;
+	data_size = layout->delta_size - sizeof(glc_video_frame_header_t);
+
+	if (layout->flags & GLC_DELTA_KEYFRAME) {
+		if (unlikely(data_size != frame_size))
+			return EINVAL;
+	} else if (unlikely((data_size < bitmap_size) ||
+			    (data_size - bitmap_size > frame_size)))
+		return EINVAL;
+
+	return 0;
+}
+
+/* size is what is left of the payload for the tiles */
+int unpack_delta_scatter(const glc_delta_header_t *layout,
+			 const unsigned char *bitmap, const char *from,
+			 size_t size, char *frame)
+{
+	size_t offset = 0, tile, i = 0;
+	unsigned int p, x, y, row, w, h;
+
+	for (p = 0; p < layout->planes; p++) {
+		const glc_delta_plane_t *plane = &layout->plane[p];
+
+		for (y = 0; y < plane->height; y += layout->tile_height) {
+			h = plane->height - y;
+			if (h > layout->tile_height)
+				h = layout->tile_height;
+
+			for (x = 0; x < plane->width; x += layout->tile_width, i++) {
+				if (!(bitmap[i / 8] & (1 << (i % 8))))
+					continue;
+
+				w = plane->width - x;
+				if (w > layout->tile_width)
+					w = layout->tile_width;
+
+				if (unlikely((size_t) w * h > size))
+					return EINVAL;
+				size -= (size_t) w * h;
+
+				tile = offset + (size_t) y * plane->stride + x;
+				for (row = 0; row < h; row++) {
+					memcpy(&frame[tile + row * plane->stride], from, w);
+					from += w;
+				}
+			}
+		}
+		offset += (size_t) plane->stride * plane->height;
+	}
+
+	return 0;
+}
+
+int unpack_decompress(struct unpack_thread_s *thread,
+		      glc_message_type_t compression, const char *from,
+		      size_t size, char *to, size_t to_size)
+{
+	if (compression == GLC_MESSAGE_LZO) {
+#ifdef __LZO
+		lzo_uint lzo_size = to_size;
+		if (unlikely((__lzo_decompress((const unsigned char *) from, size,
+					       (unsigned char *) to, &lzo_size,
+					       NULL) != LZO_E_OK) ||
+			     (lzo_size != to_size)))
+			return EINVAL;
+		return 0;
+#endif
+	} else if (compression == GLC_MESSAGE_QUICKLZ) {
+#ifdef __QUICKLZ
+		if (!thread->qlz)
+			thread->qlz = malloc(sizeof(qlz_state_decompress));
+		if (unlikely(!thread->qlz))
+			return ENOMEM;
+		/* quicklz trusts its header, check it before writing to */
+		if (unlikely((!size) || (qlz_size_header(from) > size) ||
+			     (qlz_size_compressed(from) > size) ||
+			     (qlz_size_decompressed(from) != to_size)))
+			return EINVAL;
+		qlz_decompress((const void *) from, (void *) to,
+			       (qlz_state_decompress *) thread->qlz);
+		return 0;
+#endif
+	} else if (compression == GLC_MESSAGE_LZJB) {
+#ifdef __LZJB
+		if (unlikely(lzjb_decompress((void *) from, to, size, to_size)))
+			return EINVAL;
+		return 0;
+#endif
+	} else if (compression == GLC_MESSAGE_LZ4) {
+#ifdef __LZ4
+		if (unlikely(LZ4_decompress_safe(from, to, size, to_size) !=
+			     (int) to_size))
+			return EINVAL;
+		return 0;
+#endif
+	} else if (compression == GLC_MESSAGE_ZSTD) {
+#ifdef __ZSTD
+		if (!thread->dctx)
+			thread->dctx = ZSTD_createDCtx();
+		if (unlikely(!thread->dctx))
+			return ENOMEM;
+		if (unlikely(ZSTD_decompressDCtx((ZSTD_DCtx *) thread->dctx,
+						 to, to_size, from, size) != to_size))
+			return EINVAL;
+		return 0;
+#endif
+	}
+	return ENOTSUP;
+}
+
 int pack_init(pack_t *pack, glc_t *glc)
 {
-#if !defined(__QUICKLZ) && !defined(__LZO) && !defined(__LZJB)
+#if !defined(__QUICKLZ) && !defined(__LZO) && !defined(__LZJB) && \
+    !defined(__LZ4) && !defined(__ZSTD)
 	glc_log(glc, GLC_ERROR, "pack",
 		 "no supported compression algorithms found");
 	return ENOTSUP;
@@ -122,9 +438,15 @@ int pack_init(pack_t *pack, glc_t *glc)
 	(*pack)->thread.ptr = *pack;
 	(*pack)->thread.thread_create_callback = &pack_thread_create_callback;
 	(*pack)->thread.thread_finish_callback = &pack_thread_finish_callback;
+	(*pack)->thread.open_callback = &pack_open_callback;
 	(*pack)->thread.read_callback = &pack_read_callback;
+	(*pack)->thread.slice_callback = &pack_chunked_slice_callback;
 	(*pack)->thread.finish_callback = &pack_finish_callback;
 	(*pack)->thread.threads = glc_threads_hint(glc);
+	(*pack)->thread.name    = "pack";
+
+	pthread_mutex_init(&(*pack)->chunk_mutex, NULL);
+	pthread_mutex_init(&(*pack)->governor.mutex, NULL);
 
 	return 0;
 #endif
@@ -165,6 +487,26 @@ int pack_set_compression(pack_t pack, int compression)
 		glc_log(pack->glc, GLC_ERROR, "pack",
 			"LZJB not supported");
 		return ENOTSUP;
+#endif
+	} else if ((compression == PACK_LZ4) || (compression == PACK_LZ4HC)) {
+#ifdef __LZ4
+		pack->thread.write_callback = &pack_lz4_write_callback;
+		glc_log(pack->glc, GLC_INFO, "pack", "compressing using %s",
+			compression == PACK_LZ4 ? "LZ4" : "LZ4-HC");
+#else
+		glc_log(pack->glc, GLC_ERROR, "pack",
+			"LZ4 not supported");
+		return ENOTSUP;
+#endif
+	} else if (compression == PACK_ZSTD) {
+#ifdef __ZSTD
+		pack->thread.write_callback = &pack_zstd_write_callback;
+		glc_log(pack->glc, GLC_INFO, "pack",
+			"compressing using Zstandard");
+#else
+		glc_log(pack->glc, GLC_ERROR, "pack",
+			"Zstandard not supported");
+		return ENOTSUP;
 #endif
 	} else {
 		glc_log(pack->glc, GLC_ERROR, "pack",
@@ -177,6 +519,44 @@ int pack_set_compression(pack_t pack, int compression)
 	return 0;
 }
 
+int pack_set_compression_level(pack_t pack, int level)
+{
+	int min = 0, max = INT_MAX;
+
+	if (unlikely(pack->running))
+		return EALREADY;
+
+	/* only zstd has negative, fast, levels */
+#ifdef __ZSTD
+	if (pack->compression == PACK_ZSTD) {
+		min = ZSTD_minCLevel();
+		max = ZSTD_maxCLevel();
+	}
+#endif
+#ifdef __LZ4
+	if (pack->compression == PACK_LZ4HC)
+		max = LZ4HC_CLEVEL_MAX;
+#endif
+
+	if (unlikely((level < min) || (level > max))) {
+		glc_log(pack->glc, GLC_ERROR, "pack",
+			"invalid compression level %d", level);
+		return EINVAL;
+	}
+
+	pack->level = level;
+	return 0;
+}
+
+int pack_set_long_distance(pack_t pack, int long_distance)
+{
+	if (unlikely(pack->running))
+		return EALREADY;
+
+	pack->long_distance = long_distance;
+	return 0;
+}
+
 int pack_set_minimum_size(pack_t pack, size_t min_size)
 {
 	if (unlikely(pack->running))
@@ -189,6 +569,49 @@ int pack_set_minimum_size(pack_t pack, size_t min_size)
 	return 0;
 }
 
+int pack_set_chunks(pack_t pack, unsigned int chunks)
+{
+	if (unlikely(pack->running))
+		return EALREADY;
+
+	/* one slice thread per chunk, the pack thread being one of them */
+	pack->chunks = chunks;
+	pack->thread.slice_threads = chunks;
+	if (chunks > 1)
+		glc_log(pack->glc, GLC_INFO, "pack",
+			"compressing video frames in up to %u chunks", chunks);
+	return 0;
+}
+
+int pack_set_governor(pack_t pack, glc_utime_t latency)
+{
+	if (unlikely(pack->running))
+		return EALREADY;
+
+	pack->governor.target = latency;
+	return 0;
+}
+
+int pack_set_delta(pack_t pack, unsigned int keyframe_interval)
+{
+	if (unlikely(pack->running))
+		return EALREADY;
+
+	pack->keyframe_interval = keyframe_interval;
+	if (keyframe_interval)
+		glc_log(pack->glc, GLC_INFO, "pack",
+			"delta coding video frames, keyframe every %u frames",
+			keyframe_interval);
+	return 0;
+}
+
+int pack_get_stats(pack_t pack, glc_size_t *unpack_size, glc_size_t *pack_size)
+{
+	*unpack_size = __sync_fetch_and_add(&pack->stats.unpack_size, 0);
+	*pack_size   = __sync_fetch_and_add(&pack->stats.pack_size, 0);
+	return 0;
+}
+
 int pack_process_start(pack_t pack, ps_buffer_t *from, ps_buffer_t *to)
 {
 	int ret;
@@ -201,6 +624,18 @@ int pack_process_start(pack_t pack, ps_buffer_t *from, ps_buffer_t *to)
 		return EINVAL;
 	}
 
+	/*
+	 * pack_write_callback() hands delta coded and chunked frames to
+	 * their own callbacks and the other packets to compress_callback.
+	 */
+	if (pack->thread.write_callback != &pack_write_callback) {
+		pack->compress_callback = pack->thread.write_callback;
+		pack->thread.write_callback = &pack_write_callback;
+	}
+
+	if (pack->governor.target)
+		pack_governor_init(pack);
+
 	if (unlikely((ret = glc_thread_create(pack->glc, &pack->thread, from, to))))
 		return ret;
 	pack->running = 1;
@@ -221,7 +656,23 @@ int pack_process_wait(pack_t pack)
 
 int pack_destroy(pack_t pack)
 {
+	char desc[32];
+	int step;
+
 	print_stats(pack->glc,&pack->stats);
+	for (step = 0; (pack->governor.target) && (step < pack->governor.steps); step++) {
+		if (pack->governor.frames[step])
+			glc_log(pack->glc, GLC_PERF, "pack", "governor: %" PRIu64 " frames at %s",
+				pack->governor.frames[step],
+				pack_governor_describe(pack, step, desc, sizeof(desc)));
+	}
+	if (pack->tiles)
+		glc_log(pack->glc, GLC_PERF, "pack",
+			"delta: %" PRIu64 " of %" PRIu64 " tiles written (%.1f%%)",
+			pack->changed_tiles, pack->tiles,
+			(double) pack->changed_tiles * 100 / (double) pack->tiles);
+	pthread_mutex_destroy(&pack->chunk_mutex);
+	pthread_mutex_destroy(&pack->governor.mutex);
 	free(pack);
 	return 0;
 }
@@ -229,31 +680,97 @@ int pack_destroy(pack_t pack)
 void pack_finish_callback(void *ptr, int err)
 {
 	pack_t pack = (pack_t) ptr;
+	struct pack_video_s *del;
+	struct pack_thread_s *wrk;
 
 	if (unlikely(err))
 		glc_log(pack->glc, GLC_ERROR, "pack", "%s (%d)", strerror(err), err);
+
+	while (pack->video_list != NULL) {
+		del = pack->video_list;
+		pack->video_list = pack->video_list->next;
+
+		free(del->ref);
+		free(del);
+	}
+
+	while ((wrk = pack->chunk_wrk) != NULL) {
+		pack->chunk_wrk = wrk->next;
+		pack_thread_finish_callback(pack, wrk, 0);
+	}
 }
 
 int pack_thread_create_callback(void *ptr, void **threadptr)
 {
 	pack_t pack = (pack_t) ptr;
+	struct pack_thread_s *thread;
+
+	if (unlikely(!(thread = (struct pack_thread_s *)
+		       calloc(1, sizeof(struct pack_thread_s)))))
+		return ENOMEM;
 
 	if (pack->compression == PACK_QUICKLZ) {
 #ifdef __QUICKLZ
-		*threadptr = malloc(sizeof(qlz_state_compress));
+		thread->wrk = malloc(sizeof(qlz_state_compress));
 #endif
 	} else if (pack->compression == PACK_LZO) {
 #ifdef __LZO
-		*threadptr = malloc(__lzo_wrk_mem);
+		thread->wrk = malloc(__lzo_wrk_mem);
+#endif
+	} else if (pack->compression == PACK_LZ4) {
+#ifdef __LZ4
+		thread->wrk = malloc(LZ4_sizeofState());
+#endif
+	} else if (pack->compression == PACK_LZ4HC) {
+#ifdef __LZ4
+		thread->wrk = malloc(LZ4_sizeofStateHC());
+#endif
+	} else if (pack->compression == PACK_ZSTD) {
+#ifdef __ZSTD
+		/*
+		 * Parameters stick to the context, reused for every packet.
+		 * pack_compress() sets the level.
+		 */
+		if (unlikely(!(thread->wrk = ZSTD_createCCtx()))) {
+			free(thread);
+			return ENOMEM;
+		}
+		if (pack->long_distance)
+			ZSTD_CCtx_setParameter((ZSTD_CCtx *) thread->wrk,
+					       ZSTD_c_enableLongDistanceMatching, 1);
 #endif
 	}
 
+	*threadptr = thread;
 	return 0;
 }
 
 void pack_thread_finish_callback(void *ptr, void *threadptr, int err)
 {
-	free(threadptr);
+	struct pack_thread_s *thread = (struct pack_thread_s *) threadptr;
+
+	if (!thread)
+		return;
+
+#ifdef __ZSTD
+	if (((pack_t) ptr)->compression == PACK_ZSTD)
+		ZSTD_freeCCtx((ZSTD_CCtx *) thread->wrk);
+	else
+#endif
+	free(thread->wrk);
+	free(thread->bitmap);
+	free(thread->buf);
+	free(thread);
+}
+
+int pack_open_callback(glc_thread_state_t *state)
+{
+	pack_t pack = (pack_t) state->ptr;
+
+	if (pack->governor.target)
+		((struct pack_thread_s *) state->threadptr)->opened =
+			glc_state_time(pack->glc);
+	return 0;
 }
 
 int pack_read_callback(glc_thread_state_t *state)
@@ -261,11 +778,56 @@ int pack_read_callback(glc_thread_state_t *state)
 	pack_t pack = (pack_t) state->ptr;
 
 	__sync_fetch_and_add(&pack->stats.unpack_size, state->read_size);
+	((struct pack_thread_s *) state->threadptr)->chunks = 0;
+
+	if ((pack->governor.target) &&
+	    (state->header.type == GLC_MESSAGE_VIDEO_FRAME)) {
+		struct pack_thread_s *thread = (struct pack_thread_s *) state->threadptr;
+		struct pack_governor_s *gov = &pack->governor;
+		glc_utime_t now = glc_state_time(pack->glc);
+		glc_utime_t time = ((glc_video_frame_header_t *) state->read_data)->time;
+		glc_utime_t age = now > time ? now - time : 0;
+
+		/*
+		 * The packetstream buffer doesn't tell how full it is, the
+		 * time frames spend in it grows with it. Frame times are
+		 * taken when the readback starts, so the age of a frame that
+		 * an idle thread got straight away is the capture delay, and
+		 * only what comes on top of it is queue time. Read callbacks
+		 * run one at a time, so gov->capture needs no lock. gov->step
+		 * is changed under gov->mutex and read atomically.
+		 */
+		if (now - thread->opened >= PACK_GOVERNOR_IDLE)
+			gov->capture = gov->capture ? (gov->capture * 7 + age) / 8 : age;
+		thread->queue = age > gov->capture ? age - gov->capture : 0;
+		if (__atomic_load_n(&gov->step, __ATOMIC_RELAXED) == gov->steps - 1) {
+			pack_governor_sample(pack, thread->queue, 0);
+			goto copy;
+		}
+	}
+
+	if (pack->keyframe_interval) {
+		((struct pack_thread_s *) state->threadptr)->delta = 0;
+
+		if (state->header.type == GLC_MESSAGE_VIDEO_FORMAT)
+			pack_video_format(pack, (glc_video_format_message_t *)
+					  state->read_data);
+		else if ((state->header.type == GLC_MESSAGE_VIDEO_FRAME) &&
+			 (!pack_delta_read(pack, state)))
+			return 0;
+	}
 
 	/* compress only audio and pictures */
 	if ((state->read_size > pack->compress_min) &&
 	    ((state->header.type == GLC_MESSAGE_VIDEO_FRAME) ||
 	     (state->header.type == GLC_MESSAGE_AUDIO_DATA))) {
+		if ((pack->chunks > 1) &&
+		    (state->header.type == GLC_MESSAGE_VIDEO_FRAME) &&
+		    (state->read_size >= 2 * PACK_CHUNK_MIN)) {
+			pack_chunked_read(pack, state);
+			return 0;
+		}
+
 		if (pack->compression == PACK_QUICKLZ) {
 #ifdef __QUICKLZ
 			state->write_size = sizeof(glc_container_message_header_t)
@@ -289,6 +851,23 @@ int pack_read_callback(glc_thread_state_t *state)
 					    + __lzjb_worstcase(state->read_size);
 #else
 			goto copy;
+#endif
+		} else if ((pack->compression == PACK_LZ4) ||
+			   (pack->compression == PACK_LZ4HC)) {
+#ifdef __LZ4
+			state->write_size = sizeof(glc_container_message_header_t)
+					    + sizeof(glc_lz4_header_t)
+					    + __lz4_worstcase(state->read_size);
+#else
+			goto copy;
+#endif
+		} else if (pack->compression == PACK_ZSTD) {
+#ifdef __ZSTD
+			state->write_size = sizeof(glc_container_message_header_t)
+					    + sizeof(glc_zstd_header_t)
+					    + __zstd_worstcase(state->read_size);
+#else
+			goto copy;
 #endif
 		} else
 			goto copy;
@@ -301,6 +880,29 @@ copy:
 	return 0;
 }
 
+int pack_write_callback(glc_thread_state_t *state)
+{
+	pack_t pack = (pack_t) state->ptr;
+	struct pack_thread_s *thread = (struct pack_thread_s *) state->threadptr;
+	glc_utime_t begin = 0;
+	int ret;
+
+	if ((pack->governor.target) &&
+	    (state->header.type == GLC_MESSAGE_VIDEO_FRAME))
+		begin = glc_time(pack->glc);
+
+	if (thread->delta)
+		ret = pack_delta_write_callback(state);
+	else if (thread->chunks)
+		ret = pack_chunked_write_callback(state);
+	else
+		ret = pack->compress_callback(state);
+
+	if ((begin) && (likely(!ret)))
+		pack_governor_sample(pack, thread->queue, glc_time(pack->glc) - begin);
+	return ret;
+}
+
 int pack_lzo_write_callback(glc_thread_state_t *state)
 {
 #ifdef __LZO
@@ -312,7 +914,8 @@ int pack_lzo_write_callback(glc_thread_state_t *state)
 	__lzo_compress((unsigned char *) state->read_data, state->read_size,
 		       (unsigned char *) &state->write_data[sizeof(glc_lzo_header_t) +
 		       					    sizeof(glc_container_message_header_t)],
-		       &compressed_size, (lzo_voidp) state->threadptr);
+		       &compressed_size,
+		       (lzo_voidp) ((struct pack_thread_s *) state->threadptr)->wrk);
 
 	lzo_header->size = (glc_size_t) state->read_size;
 	memcpy(&lzo_header->header, &state->header, sizeof(glc_message_header_t));
@@ -324,6 +927,7 @@ int pack_lzo_write_callback(glc_thread_state_t *state)
 
 	__sync_fetch_and_add(&((pack_t) state->ptr)->stats.pack_size,
 				compressed_size);
+	GLC_PROBE3(compress, GLC_MESSAGE_LZO, state->read_size, compressed_size);
 
 	return 0;
 #else
@@ -342,7 +946,8 @@ int pack_quicklz_write_callback(glc_thread_state_t *state)
 			(void *) &state->write_data[sizeof(glc_quicklz_header_t) +
 			 			    sizeof(glc_container_message_header_t)],
 			 state->read_size,
-			 (qlz_state_compress *) state->threadptr);
+			 (qlz_state_compress *)
+			 ((struct pack_thread_s *) state->threadptr)->wrk);
 
 	quicklz_header->size = (glc_size_t) state->read_size;
 	memcpy(&quicklz_header->header, &state->header, sizeof(glc_message_header_t));
@@ -354,6 +959,7 @@ int pack_quicklz_write_callback(glc_thread_state_t *state)
 
 	__sync_fetch_and_add(&((pack_t) state->ptr)->stats.pack_size,
 				compressed_size);
+	GLC_PROBE3(compress, GLC_MESSAGE_QUICKLZ, state->read_size, compressed_size);
 
 	return 0;
 #else
@@ -383,6 +989,73 @@ int pack_lzjb_write_callback(glc_thread_state_t *state)
 
 	__sync_fetch_and_add(&((pack_t) state->ptr)->stats.pack_size,
 				compressed_size);
+	GLC_PROBE3(compress, GLC_MESSAGE_LZJB, state->read_size, compressed_size);
+
+	return 0;
+#else
+	return ENOTSUP;
+#endif
+}
+
+int pack_lz4_write_callback(glc_thread_state_t *state)
+{
+#ifdef __LZ4
+	pack_t pack = (pack_t) state->ptr;
+	glc_container_message_header_t *container = (glc_container_message_header_t *) state->write_data;
+	glc_lz4_header_t *lz4_header =
+		(glc_lz4_header_t *) &state->write_data[sizeof(glc_container_message_header_t)];
+	size_t compressed_size = pack_compress(pack,
+					       (struct pack_thread_s *) state->threadptr,
+					       state->read_data, state->read_size,
+					       &state->write_data[sizeof(glc_lz4_header_t) +
+								  sizeof(glc_container_message_header_t)]);
+
+	if (unlikely(!compressed_size))
+		return EIO;
+
+	lz4_header->size = (glc_size_t) state->read_size;
+	memcpy(&lz4_header->header, &state->header, sizeof(glc_message_header_t));
+
+	container->size = compressed_size + sizeof(glc_lz4_header_t);
+	container->header.type = GLC_MESSAGE_LZ4;
+
+	state->header.type = GLC_MESSAGE_CONTAINER;
+
+	__sync_fetch_and_add(&pack->stats.pack_size, compressed_size);
+	GLC_PROBE3(compress, GLC_MESSAGE_LZ4, state->read_size, compressed_size);
+
+	return 0;
+#else
+	return ENOTSUP;
+#endif
+}
+
+int pack_zstd_write_callback(glc_thread_state_t *state)
+{
+#ifdef __ZSTD
+	pack_t pack = (pack_t) state->ptr;
+	glc_container_message_header_t *container = (glc_container_message_header_t *) state->write_data;
+	glc_zstd_header_t *zstd_header =
+		(glc_zstd_header_t *) &state->write_data[sizeof(glc_container_message_header_t)];
+	size_t compressed_size = pack_compress(pack,
+					       (struct pack_thread_s *) state->threadptr,
+					       state->read_data, state->read_size,
+					       &state->write_data[sizeof(glc_zstd_header_t) +
+								  sizeof(glc_container_message_header_t)]);
+
+	if (unlikely(!compressed_size))
+		return EIO;
+
+	zstd_header->size = (glc_size_t) state->read_size;
+	memcpy(&zstd_header->header, &state->header, sizeof(glc_message_header_t));
+
+	container->size = compressed_size + sizeof(glc_zstd_header_t);
+	container->header.type = GLC_MESSAGE_ZSTD;
+
+	state->header.type = GLC_MESSAGE_CONTAINER;
+
+	__sync_fetch_and_add(&pack->stats.pack_size, compressed_size);
+	GLC_PROBE3(compress, GLC_MESSAGE_ZSTD, state->read_size, compressed_size);
 
 	return 0;
 #else
@@ -390,6 +1063,653 @@ int pack_lzjb_write_callback(glc_thread_state_t *state)
 #endif
 }
 
+/*
+ * Every chunk is compressed to a slot sized for its worst case, the
+ * slots being closed up once they are all done.
+ */
+void pack_chunked_read(pack_t pack, glc_thread_state_t *state)
+{
+	struct pack_thread_s *thread = (struct pack_thread_s *) state->threadptr;
+	unsigned int chunks = pack->chunks;
+	size_t chunk_size;
+
+	if (chunks > state->read_size / PACK_CHUNK_MIN)
+		chunks = state->read_size / PACK_CHUNK_MIN;
+	chunk_size = (state->read_size + chunks - 1) / chunks;
+	chunk_size = (chunk_size + PACK_CHUNK_ALIGN - 1) & ~((size_t) PACK_CHUNK_ALIGN - 1);
+
+	thread->chunks     = (state->read_size + chunk_size - 1) / chunk_size;
+	thread->chunk_size = chunk_size;
+	thread->chunk_slot = pack_worstcase(pack, chunk_size);
+
+	state->write_size = sizeof(glc_container_message_header_t)
+			    + sizeof(glc_chunked_header_t)
+			    + thread->chunks * (sizeof(glc_chunk_t) + thread->chunk_slot);
+}
+
+int pack_chunked_write_callback(glc_thread_state_t *state)
+{
+	pack_t pack = (pack_t) state->ptr;
+	struct pack_thread_s *thread = (struct pack_thread_s *) state->threadptr;
+	glc_container_message_header_t *container =
+		(glc_container_message_header_t *) state->write_data;
+	glc_chunked_header_t *chunked_header =
+		(glc_chunked_header_t *) &state->write_data[sizeof(glc_container_message_header_t)];
+	glc_chunk_t *chunk = (glc_chunk_t *) &chunked_header[1];
+	char *data = (char *) &chunk[thread->chunks];
+	size_t compressed_size = 0;
+	unsigned int c;
+	int ret;
+
+	if (unlikely((ret = glc_thread_slice_chunks(state, thread->chunks))))
+		return ret;
+
+	for (c = 0; c < thread->chunks; c++) {
+		if (compressed_size != c * thread->chunk_slot)
+			memmove(&data[compressed_size], &data[c * thread->chunk_slot],
+				chunk[c].size);
+		chunk[c].offset = compressed_size;
+		compressed_size += chunk[c].size;
+	}
+
+	chunked_header->size = (glc_size_t) state->read_size;
+	memcpy(&chunked_header->header, &state->header, sizeof(glc_message_header_t));
+	chunked_header->compression = pack_message_type(pack);
+	chunked_header->chunk_size  = thread->chunk_size;
+	chunked_header->chunks      = thread->chunks;
+
+	container->size = sizeof(glc_chunked_header_t) +
+			  thread->chunks * sizeof(glc_chunk_t) + compressed_size;
+	container->header.type = GLC_MESSAGE_CHUNKED;
+
+	state->header.type = GLC_MESSAGE_CONTAINER;
+
+	__sync_fetch_and_add(&pack->stats.pack_size, compressed_size);
+	GLC_PROBE3(compress, GLC_MESSAGE_CHUNKED, state->read_size, compressed_size);
+	return 0;
+}
+
+int pack_chunked_slice_callback(glc_thread_state_t *state,
+				unsigned int from, unsigned int to)
+{
+	pack_t pack = (pack_t) state->ptr;
+	struct pack_thread_s *thread = (struct pack_thread_s *) state->threadptr;
+	struct pack_thread_s *wrk;
+	glc_chunk_t *chunk =
+		(glc_chunk_t *) &state->write_data[sizeof(glc_container_message_header_t) +
+						   sizeof(glc_chunked_header_t)];
+	char *data = (char *) &chunk[thread->chunks];
+	size_t offset, size;
+	unsigned int c;
+	int ret = 0;
+
+	/* the slice pool threads don't have a compressor of their own */
+	if (unlikely(!(wrk = pack_chunk_wrk_get(pack))))
+		return ENOMEM;
+
+	for (c = from; c < to; c++) {
+		offset = (size_t) c * thread->chunk_size;
+		size = state->read_size - offset;
+		if (size > thread->chunk_size)
+			size = thread->chunk_size;
+
+		chunk[c].size = pack_compress(pack, wrk, &state->read_data[offset], size,
+					      &data[c * thread->chunk_slot]);
+		if (unlikely(!chunk[c].size)) {
+			ret = EIO;
+			break;
+		}
+	}
+
+	pack_chunk_wrk_put(pack, wrk);
+	return ret;
+}
+
+struct pack_thread_s *pack_chunk_wrk_get(pack_t pack)
+{
+	struct pack_thread_s *wrk;
+	void *ptr;
+
+	pthread_mutex_lock(&pack->chunk_mutex);
+	if ((wrk = pack->chunk_wrk) != NULL)
+		pack->chunk_wrk = wrk->next;
+	pthread_mutex_unlock(&pack->chunk_mutex);
+
+	/* at most one per thread working on chunks at the same time */
+	if ((!wrk) && (likely(!pack_thread_create_callback(pack, &ptr))))
+		wrk = (struct pack_thread_s *) ptr;
+	return wrk;
+}
+
+void pack_chunk_wrk_put(pack_t pack, struct pack_thread_s *wrk)
+{
+	pthread_mutex_lock(&pack->chunk_mutex);
+	wrk->next = pack->chunk_wrk;
+	pack->chunk_wrk = wrk;
+	pthread_mutex_unlock(&pack->chunk_mutex);
+}
+
+size_t delta_tiles(const glc_delta_header_t *layout)
+{
+	size_t tiles = 0;
+	unsigned int p;
+
+	for (p = 0; p < layout->planes; p++)
+		tiles += (((size_t) layout->plane[p].width + layout->tile_width - 1) /
+			  layout->tile_width) *
+			 (((size_t) layout->plane[p].height + layout->tile_height - 1) /
+			  layout->tile_height);
+	return tiles;
+}
+
+/* compressed size upper bound, without the algorithm header */
+size_t pack_worstcase(pack_t pack, size_t size)
+{
+	if (pack->compression == PACK_QUICKLZ) {
+#ifdef __QUICKLZ
+		return __quicklz_worstcase(size);
+#endif
+	} else if (pack->compression == PACK_LZO) {
+#ifdef __LZO
+		return __lzo_worstcase(size);
+#endif
+	} else if (pack->compression == PACK_LZJB) {
+#ifdef __LZJB
+		return __lzjb_worstcase(size);
+#endif
+	} else if ((pack->compression == PACK_LZ4) ||
+		   (pack->compression == PACK_LZ4HC)) {
+#ifdef __LZ4
+		return __lz4_worstcase(size);
+#endif
+	} else if (pack->compression == PACK_ZSTD) {
+#ifdef __ZSTD
+		return __zstd_worstcase(size);
+#endif
+	}
+	return size;
+}
+
+size_t pack_compress(pack_t pack, struct pack_thread_s *thread,
+		     const char *from, size_t size, char *to)
+{
+	if (pack->compression == PACK_QUICKLZ) {
+#ifdef __QUICKLZ
+		return qlz_compress((const void *) from, (void *) to, size,
+				    (qlz_state_compress *) thread->wrk);
+#endif
+	} else if (pack->compression == PACK_LZO) {
+#ifdef __LZO
+		lzo_uint compressed_size;
+		__lzo_compress((const unsigned char *) from, size,
+			       (unsigned char *) to, &compressed_size,
+			       (lzo_voidp) thread->wrk);
+		return compressed_size;
+#endif
+	} else if (pack->compression == PACK_LZJB) {
+#ifdef __LZJB
+		return lzjb_compress((void *) from, to, size);
+#endif
+	} else if (pack->compression == PACK_LZ4) {
+#ifdef __LZ4
+		/* only the governor changes the acceleration */
+		return LZ4_compress_fast_extState(thread->wrk, from, to, size,
+						  __lz4_worstcase(size),
+						  pack->governor.target ?
+						  pack_level(pack) : 1);
+#endif
+	} else if (pack->compression == PACK_LZ4HC) {
+#ifdef __LZ4
+		int level = pack_level(pack);
+		return LZ4_compress_HC_extStateHC(thread->wrk, from, to, size,
+						  __lz4_worstcase(size),
+						  level ? level : LZ4HC_CLEVEL_DEFAULT);
+#endif
+	} else if (pack->compression == PACK_ZSTD) {
+#ifdef __ZSTD
+		int level = pack_level(pack);
+		size_t ret;
+
+		if (!level)
+			level = ZSTD_CLEVEL_DEFAULT;
+		if (thread->level != level) {
+			ZSTD_CCtx_setParameter((ZSTD_CCtx *) thread->wrk,
+					       ZSTD_c_compressionLevel, level);
+			thread->level = level;
+		}
+
+		ret = ZSTD_compress2((ZSTD_CCtx *) thread->wrk, to,
+					    __zstd_worstcase(size), from, size);
+		if (unlikely(ZSTD_isError(ret))) {
+			glc_log(pack->glc, GLC_ERROR, "pack", "Zstandard: %s",
+				ZSTD_getErrorName(ret));
+			return 0;
+		}
+		return ret;
+#endif
+	}
+	memcpy(to, from, size);
+	return size;
+}
+
+/* level the governor steps to, the configured one without it */
+int pack_level(pack_t pack)
+{
+	if (pack->governor.target)
+		return pack->governor.level[__atomic_load_n(&pack->governor.step,
+							    __ATOMIC_RELAXED)];
+	return pack->level;
+}
+
+void pack_governor_init(pack_t pack)
+{
+	struct pack_governor_s *gov = &pack->governor;
+	const int *faster = NULL;
+	int level = pack->level, i;
+
+	if (pack->compression == PACK_ZSTD) {
+		faster = pack_governor_zstd;
+		if (!level)
+			level = 3; /* ZSTD_CLEVEL_DEFAULT */
+	} else if (pack->compression == PACK_LZ4HC) {
+		faster = pack_governor_lz4hc;
+		if (!level)
+			level = 9; /* LZ4HC_CLEVEL_DEFAULT */
+	} else if (pack->compression == PACK_LZ4) {
+		faster = pack_governor_lz4;
+		if (level < 1)
+			level = 1;
+	}
+
+	gov->steps = 0;
+	gov->level[gov->steps++] = level;
+	for (i = 0; (faster) && (faster[i]); i++) {
+		if ((pack->compression == PACK_LZ4) ? (faster[i] > level) :
+						      (faster[i] < level))
+			gov->level[gov->steps++] = faster[i];
+	}
+
+	/* store only, frames read before the step keep the fastest level */
+	gov->level[gov->steps] = gov->level[gov->steps - 1];
+	gov->steps++;
+
+	gov->step = 0;
+	gov->latency = gov->queue = gov->compress = gov->capture = 0;
+	gov->changed = glc_time(pack->glc);
+	gov->headroom = 0;
+	gov->hold_up = PACK_GOVERNOR_HOLD_UP;
+	gov->stepped_up = 0;
+	memset(gov->frames, 0, sizeof(gov->frames));
+
+	glc_log(pack->glc, GLC_INFO, "pack",
+		"governing compression for a %.1f ms frame latency, %d steps",
+		gov->target / 1000000.0, gov->steps);
+}
+
+/*
+ * Called once per video frame. Steps down as soon as the average
+ * latency goes over the target, but only up after hold_up spent under
+ * half of it, so a game that just barely fits doesn't make it swing.
+ */
+void pack_governor_sample(pack_t pack, glc_utime_t queue, glc_utime_t compress)
+{
+	struct pack_governor_s *gov = &pack->governor;
+	glc_utime_t now = glc_time(pack->glc);
+	char desc[32];
+	int step;
+
+	pthread_mutex_lock(&gov->mutex);
+	gov->frames[gov->step]++;
+
+	if (!gov->latency) {
+		gov->queue    = queue;
+		gov->compress = compress;
+	} else {
+		gov->queue    = (gov->queue * 7 + queue) / 8;
+		gov->compress = (gov->compress * 7 + compress) / 8;
+	}
+	gov->latency = gov->queue + gov->compress;
+
+	step = gov->step;
+	if (gov->latency > gov->target) {
+		gov->headroom = 0;
+		if ((step < gov->steps - 1) &&
+		    (now - gov->changed >= PACK_GOVERNOR_HOLD_DOWN)) {
+			/* the last step up didn't hold, wait longer next time */
+			if ((gov->stepped_up) && (now - gov->changed < gov->hold_up) &&
+			    (gov->hold_up < PACK_GOVERNOR_HOLD_MAX))
+				gov->hold_up *= 2;
+			gov->stepped_up = 0;
+			step++;
+		}
+	} else if (gov->latency < gov->target / 2) {
+		if (!gov->headroom)
+			gov->headroom = now;
+		else if ((step > 0) && (now - gov->headroom >= gov->hold_up) &&
+			 (now - gov->changed >= gov->hold_up)) {
+			gov->stepped_up = 1;
+			step--;
+		}
+	} else
+		gov->headroom = 0;
+
+	if (step != gov->step) {
+		glc_log(pack->glc, GLC_PERF, "pack",
+			"governor: frame latency %.1f ms (queue %.1f ms, compress %.1f ms), "
+			"target %.1f ms, stepping %s to %s",
+			gov->latency / 1000000.0, gov->queue / 1000000.0,
+			gov->compress / 1000000.0, gov->target / 1000000.0,
+			step > gov->step ? "down" : "up",
+			pack_governor_describe(pack, step, desc, sizeof(desc)));
+		__atomic_store_n(&gov->step, step, __ATOMIC_RELAXED);
+		gov->changed = now;
+		gov->headroom = 0;
+	}
+	pthread_mutex_unlock(&gov->mutex);
+}
+
+const char *pack_governor_describe(pack_t pack, int step, char *buf, size_t size)
+{
+	int level = pack->governor.level[step];
+
+	if (step == pack->governor.steps - 1)
+		snprintf(buf, size, "store only");
+	else if (pack->compression == PACK_ZSTD)
+		snprintf(buf, size, "zstd level %d", level);
+	else if (pack->compression == PACK_LZ4HC)
+		snprintf(buf, size, "lz4hc level %d", level);
+	else if (pack->compression == PACK_LZ4)
+		snprintf(buf, size, "lz4 acceleration %d", level);
+	else if (pack->compression == PACK_LZO)
+		snprintf(buf, size, "lzo");
+	else if (pack->compression == PACK_QUICKLZ)
+		snprintf(buf, size, "quicklz");
+	else
+		snprintf(buf, size, "lzjb");
+	return buf;
+}
+
+/* message type of what pack_compress() writes, 0 if stored */
+glc_message_type_t pack_message_type(pack_t pack)
+{
+	if (pack->compression == PACK_QUICKLZ)
+		return GLC_MESSAGE_QUICKLZ;
+	else if (pack->compression == PACK_LZO)
+		return GLC_MESSAGE_LZO;
+	else if (pack->compression == PACK_LZJB)
+		return GLC_MESSAGE_LZJB;
+	else if ((pack->compression == PACK_LZ4) || (pack->compression == PACK_LZ4HC))
+		return GLC_MESSAGE_LZ4;
+	else if (pack->compression == PACK_ZSTD)
+		return GLC_MESSAGE_ZSTD;
+	return 0;
+}
+
+void pack_video_format(pack_t pack, glc_video_format_message_t *format)
+{
+	struct pack_video_s *video = pack->video_list;
+	glc_delta_header_t *layout;
+	unsigned int p;
+	int bpp;
+
+	while (video != NULL) {
+		if (video->id == format->id)
+			break;
+		video = video->next;
+	}
+
+	if (video == NULL) {
+		video = (struct pack_video_s *) calloc(1, sizeof(struct pack_video_s));
+		video->id = format->id;
+		video->next = pack->video_list;
+		pack->video_list = video;
+	}
+
+	/* new geometry, next frame is a keyframe */
+	free(video->ref);
+	video->ref = NULL;
+	video->size = 0;
+
+	layout = &video->layout;
+	memset(layout, 0, sizeof(glc_delta_header_t));
+	layout->id = format->id;
+	layout->tile_width = PACK_TILE_WIDTH;
+	layout->tile_height = PACK_TILE_HEIGHT;
+
+	if (format->format == GLC_VIDEO_YCBCR_420JPEG) {
+		/* Y' plane followed by Cb and Cr at half resolution */
+		layout->planes = 3;
+		for (p = 0; p < 3; p++) {
+			layout->plane[p].width = p ? format->width / 2 : format->width;
+			layout->plane[p].height = p ? format->height / 2 : format->height;
+			layout->plane[p].stride = layout->plane[p].width;
+		}
+	} else if ((bpp = glc_util_get_videofmt_bpp(format->format)) > 0) {
+		layout->planes = 1;
+		layout->plane[0].width = format->width * bpp;
+		layout->plane[0].height = format->height;
+		layout->plane[0].stride = layout->plane[0].width;
+		if ((format->flags & GLC_VIDEO_DWORD_ALIGNED) &&
+		    (layout->plane[0].stride % 8))
+			layout->plane[0].stride += 8 - layout->plane[0].stride % 8;
+	} else {
+		glc_log(pack->glc, GLC_WARN, "pack",
+			"video %d: unsupported format 0x%02x, not delta coding",
+			format->id, format->format);
+		return;
+	}
+
+	for (p = 0; p < layout->planes; p++)
+		video->size += (size_t) layout->plane[p].stride *
+			       layout->plane[p].height;
+}
+
+/*
+ * Called from pack_read_callback() which is serialized, so frames reach
+ * the reference in stream order. Only the bitmap is built here, tiles
+ * are gathered and compressed in parallel by pack_delta_write_callback().
+ */
+int pack_delta_read(pack_t pack, glc_thread_state_t *state)
+{
+	struct pack_thread_s *thread = (struct pack_thread_s *) state->threadptr;
+	glc_video_frame_header_t *pic_hdr = (glc_video_frame_header_t *) state->read_data;
+	const char *frame = &state->read_data[sizeof(glc_video_frame_header_t)];
+	struct pack_video_s *video = pack->video_list;
+	glc_delta_header_t *header = &thread->delta_header;
+	unsigned int tiles, changed;
+	size_t bitmap_size;
+
+	while (video != NULL) {
+		if (video->id == pic_hdr->id)
+			break;
+		video = video->next;
+	}
+
+	if ((video == NULL) || (!video->size))
+		return ENOTSUP;
+
+	if (unlikely(state->read_size - sizeof(glc_video_frame_header_t) !=
+		     video->size)) {
+		glc_log(pack->glc, GLC_WARN, "pack",
+			"video %d: frame size %zu does not match format, "
+			"not delta coding", video->id, state->read_size);
+		video->size = 0;
+		return EINVAL;
+	}
+
+	memcpy(header, &video->layout, sizeof(glc_delta_header_t));
+	tiles = delta_tiles(header);
+	header->size = state->read_size;
+	header->header.type = state->header.type;
+	header->compression = 0;
+
+	if ((video->ref == NULL) || (video->frames >= pack->keyframe_interval)) {
+		if (video->ref == NULL) {
+			if (unlikely(!(video->ref = (char *) malloc(video->size))))
+				return ENOMEM;
+		}
+		memcpy(video->ref, frame, video->size);
+		video->frames = 0;
+
+		header->flags = GLC_DELTA_KEYFRAME;
+		header->delta_size = state->read_size;
+		changed = tiles;
+	} else {
+		bitmap_size = (tiles + 7) / 8;
+		if (thread->bitmap_size < bitmap_size) {
+			free(thread->bitmap);
+			thread->bitmap = (unsigned char *) malloc(bitmap_size);
+			thread->bitmap_size = bitmap_size;
+		}
+		memset(thread->bitmap, 0, bitmap_size);
+
+		header->flags = 0;
+		header->delta_size = sizeof(glc_video_frame_header_t) + bitmap_size +
+				     pack_delta_diff(header, frame, video->ref,
+						     thread->bitmap, &changed);
+	}
+
+	video->frames++;
+	pack->tiles += tiles;
+	pack->changed_tiles += changed;
+
+	thread->delta = 1;
+	state->write_size = sizeof(glc_container_message_header_t)
+			    + sizeof(glc_delta_header_t)
+			    + pack_worstcase(pack, header->delta_size);
+	return 0;
+}
+
+/* compare every tile against the reference, updating the changed ones */
+size_t pack_delta_diff(const glc_delta_header_t *layout, const char *frame,
+		       char *ref, unsigned char *bitmap, unsigned int *changed)
+{
+	size_t offset = 0, tile, size = 0;
+	unsigned int p, x, y, row, w, h, i = 0;
+
+	*changed = 0;
+	for (p = 0; p < layout->planes; p++) {
+		const glc_delta_plane_t *plane = &layout->plane[p];
+
+		for (y = 0; y < plane->height; y += layout->tile_height) {
+			h = plane->height - y;
+			if (h > layout->tile_height)
+				h = layout->tile_height;
+
+			for (x = 0; x < plane->width; x += layout->tile_width, i++) {
+				w = plane->width - x;
+				if (w > layout->tile_width)
+					w = layout->tile_width;
+
+				tile = offset + (size_t) y * plane->stride + x;
+				for (row = 0; row < h; row++) {
+					if (memcmp(&frame[tile + row * plane->stride],
+						   &ref[tile + row * plane->stride], w))
+						break;
+				}
+				if (row == h)
+					continue;
+
+				for (; row < h; row++)
+					memcpy(&ref[tile + row * plane->stride],
+					       &frame[tile + row * plane->stride], w);
+
+				bitmap[i / 8] |= 1 << (i % 8);
+				size += (size_t) w * h;
+				(*changed)++;
+			}
+		}
+		offset += (size_t) plane->stride * plane->height;
+	}
+
+	return size;
+}
+
+void pack_delta_gather(const glc_delta_header_t *layout,
+		       const unsigned char *bitmap, const char *frame, char *to)
+{
+	size_t offset = 0, tile;
+	unsigned int p, x, y, row, w, h, i = 0;
+
+	for (p = 0; p < layout->planes; p++) {
+		const glc_delta_plane_t *plane = &layout->plane[p];
+
+		for (y = 0; y < plane->height; y += layout->tile_height) {
+			h = plane->height - y;
+			if (h > layout->tile_height)
+				h = layout->tile_height;
+
+			for (x = 0; x < plane->width; x += layout->tile_width, i++) {
+				if (!(bitmap[i / 8] & (1 << (i % 8))))
+					continue;
+
+				w = plane->width - x;
+				if (w > layout->tile_width)
+					w = layout->tile_width;
+
+				tile = offset + (size_t) y * plane->stride + x;
+				for (row = 0; row < h; row++) {
+					memcpy(to, &frame[tile + row * plane->stride], w);
+					to += w;
+				}
+			}
+		}
+		offset += (size_t) plane->stride * plane->height;
+	}
+}
+
+int pack_delta_write_callback(glc_thread_state_t *state)
+{
+	pack_t pack = (pack_t) state->ptr;
+	struct pack_thread_s *thread = (struct pack_thread_s *) state->threadptr;
+	glc_container_message_header_t *container =
+		(glc_container_message_header_t *) state->write_data;
+	glc_delta_header_t *delta_header =
+		(glc_delta_header_t *) &state->write_data[sizeof(glc_container_message_header_t)];
+	size_t bitmap_size, compressed_size;
+	const char *from;
+
+	if (thread->delta_header.flags & GLC_DELTA_KEYFRAME)
+		from = state->read_data; /* header and frame are contiguous */
+	else {
+		if (thread->buf_size < thread->delta_header.delta_size) {
+			free(thread->buf);
+			thread->buf = (char *) malloc(thread->delta_header.delta_size);
+			thread->buf_size = thread->delta_header.delta_size;
+		}
+		if (unlikely(!thread->buf))
+			return ENOMEM;
+
+		bitmap_size = (delta_tiles(&thread->delta_header) + 7) / 8;
+		memcpy(thread->buf, state->read_data, sizeof(glc_video_frame_header_t));
+		memcpy(&thread->buf[sizeof(glc_video_frame_header_t)], thread->bitmap,
+		       bitmap_size);
+		pack_delta_gather(&thread->delta_header, thread->bitmap,
+				  &state->read_data[sizeof(glc_video_frame_header_t)],
+				  &thread->buf[sizeof(glc_video_frame_header_t) + bitmap_size]);
+		from = thread->buf;
+	}
+
+	compressed_size = pack_compress(pack, thread, from,
+					thread->delta_header.delta_size,
+					&state->write_data[sizeof(glc_container_message_header_t) +
+							   sizeof(glc_delta_header_t)]);
+	if (unlikely(!compressed_size && thread->delta_header.delta_size))
+		return EIO;
+
+	memcpy(delta_header, &thread->delta_header, sizeof(glc_delta_header_t));
+	delta_header->compression = pack_message_type(pack);
+
+	container->size = compressed_size + sizeof(glc_delta_header_t);
+	container->header.type = GLC_MESSAGE_DELTA;
+
+	state->header.type = GLC_MESSAGE_CONTAINER;
+
+	__sync_fetch_and_add(&pack->stats.pack_size, compressed_size);
+	GLC_PROBE3(compress, GLC_MESSAGE_DELTA, state->read_size, compressed_size);
+	return 0;
+}
+
 int unpack_init(unpack_t *unpack, glc_t *glc)
 {
 	*unpack = (unpack_t) calloc(1, sizeof(struct unpack_s));
@@ -398,11 +1718,19 @@ int unpack_init(unpack_t *unpack, glc_t *glc)
 
 	(*unpack)->thread.flags = GLC_THREAD_WRITE | GLC_THREAD_READ;
 	(*unpack)->thread.ptr = *unpack;
+	(*unpack)->thread.thread_create_callback = &unpack_thread_create_callback;
 	(*unpack)->thread.thread_finish_callback = &unpack_thread_finish_callback;
 	(*unpack)->thread.read_callback = &unpack_read_callback;
 	(*unpack)->thread.write_callback = &unpack_write_callback;
+	(*unpack)->thread.slice_callback = &unpack_chunked_slice_callback;
 	(*unpack)->thread.finish_callback = &unpack_finish_callback;
 	(*unpack)->thread.threads = glc_threads_hint(glc);
+	(*unpack)->thread.name    = "unpack";
+	(*unpack)->thread.slice_threads = glc_slice_threads(glc);
+
+	pthread_mutex_init(&(*unpack)->video_mutex, NULL);
+	pthread_cond_init(&(*unpack)->video_cond, NULL);
+	pthread_mutex_init(&(*unpack)->chunk_mutex, NULL);
 
 #ifdef __LZO
 	lzo_init();
@@ -438,6 +1766,9 @@ int unpack_process_wait(unpack_t unpack)
 int unpack_destroy(unpack_t unpack)
 {
 	print_stats(unpack->glc, &unpack->stats);
+	pthread_cond_destroy(&unpack->video_cond);
+	pthread_mutex_destroy(&unpack->video_mutex);
+	pthread_mutex_destroy(&unpack->chunk_mutex);
 	free(unpack);
 	return 0;
 }
@@ -445,14 +1776,46 @@ int unpack_destroy(unpack_t unpack)
 void unpack_finish_callback(void *ptr, int err)
 {
 	unpack_t unpack = (unpack_t) ptr;
+	struct unpack_video_s *del;
+	struct unpack_thread_s *wrk;
 
 	if (unlikely(err))
 		glc_log(unpack->glc, GLC_ERROR, "unpack", "%s (%d)", strerror(err), err);
+
+	while (unpack->video_list != NULL) {
+		del = unpack->video_list;
+		unpack->video_list = unpack->video_list->next;
+
+		free(del->ref);
+		free(del);
+	}
+
+	while ((wrk = unpack->chunk_wrk) != NULL) {
+		unpack->chunk_wrk = wrk->next;
+		unpack_thread_finish_callback(unpack, wrk, 0);
+	}
+}
+
+int unpack_thread_create_callback(void *ptr, void **threadptr)
+{
+	if (unlikely(!(*threadptr = calloc(1, sizeof(struct unpack_thread_s)))))
+		return ENOMEM;
+	return 0;
 }
 
 void unpack_thread_finish_callback(void *ptr, void *threadptr, int err)
 {
-	free(threadptr);
+	struct unpack_thread_s *thread = (struct unpack_thread_s *) threadptr;
+
+	if (!thread)
+		return;
+
+	free(thread->qlz);
+#ifdef __ZSTD
+	ZSTD_freeDCtx((ZSTD_DCtx *) thread->dctx);
+#endif
+	free(thread->buf);
+	free(thread);
 }
 
 int unpack_read_callback(glc_thread_state_t *state)
@@ -486,6 +1849,60 @@ int unpack_read_callback(glc_thread_state_t *state)
 			GLC_ERROR, "unpack", "LZJB not supported");
 		return ENOTSUP;
 #endif
+	} else if (state->header.type == GLC_MESSAGE_LZ4) {
+#ifdef __LZ4
+		state->write_size = ((glc_lz4_header_t *) state->read_data)->size;
+		return 0;
+#else
+		glc_log(unpack->glc,
+			GLC_ERROR, "unpack", "LZ4 not supported");
+		return ENOTSUP;
+#endif
+	} else if (state->header.type == GLC_MESSAGE_ZSTD) {
+#ifdef __ZSTD
+		state->write_size = ((glc_zstd_header_t *) state->read_data)->size;
+		return 0;
+#else
+		glc_log(unpack->glc,
+			GLC_ERROR, "unpack", "Zstandard not supported");
+		return ENOTSUP;
+#endif
+	} else if (state->header.type == GLC_MESSAGE_DELTA) {
+		glc_delta_header_t *delta_header = (glc_delta_header_t *) state->read_data;
+		struct unpack_thread_s *thread = (struct unpack_thread_s *) state->threadptr;
+		struct unpack_video_s *video = unpack->video_list;
+
+		/* the write callback trusts the header from here on */
+		if (unlikely((state->read_size < sizeof(glc_delta_header_t)) ||
+			     unpack_delta_check(delta_header, state->read_size -
+							      sizeof(glc_delta_header_t)))) {
+			glc_log(unpack->glc, GLC_ERROR, "unpack", "corrupted delta packet");
+			return EINVAL;
+		}
+
+		/* frames are rebuilt in the order they are read here */
+		while (video != NULL) {
+			if (video->id == delta_header->id)
+				break;
+			video = video->next;
+		}
+
+		if (video == NULL) {
+			video = (struct unpack_video_s *) calloc(1, sizeof(struct unpack_video_s));
+			if (unlikely(!video))
+				return ENOMEM;
+			video->id = delta_header->id;
+			video->next = unpack->video_list;
+			unpack->video_list = video;
+		}
+
+		thread->video = video;
+		thread->seq = video->next_seq++;
+		state->write_size = delta_header->size;
+		return 0;
+	} else if (state->header.type == GLC_MESSAGE_CHUNKED) {
+		state->write_size = ((glc_chunked_header_t *) state->read_data)->size;
+		return 0;
 	}
 	__sync_fetch_and_add(&unpack->stats.pack_size, state->read_size);
 	__sync_fetch_and_add(&unpack->stats.unpack_size, state->read_size);
@@ -497,6 +1914,11 @@ int unpack_write_callback(glc_thread_state_t *state)
 {
 	unpack_t unpack = (unpack_t) state->ptr;
 
+	if (state->header.type == GLC_MESSAGE_DELTA)
+		return unpack_delta_write_callback(state);
+	else if (state->header.type == GLC_MESSAGE_CHUNKED)
+		return unpack_chunked_write_callback(state);
+
 	if (state->header.type == GLC_MESSAGE_LZO) {
 #ifdef __LZO
 		__sync_fetch_and_add(&unpack->stats.pack_size, state->read_size - sizeof(glc_lzo_header_t));
@@ -516,11 +1938,12 @@ int unpack_write_callback(glc_thread_state_t *state)
 					state->read_size - sizeof(glc_quicklz_header_t));
 		memcpy(&state->header, &((glc_quicklz_header_t *) state->read_data)->header,
 		       sizeof(glc_message_header_t));
-		if (!state->threadptr)
-			state->threadptr = malloc(sizeof(qlz_state_decompress));
+		struct unpack_thread_s *thread = (struct unpack_thread_s *) state->threadptr;
+		if (!thread->qlz)
+			thread->qlz = malloc(sizeof(qlz_state_decompress));
 		qlz_decompress((const void *) &state->read_data[sizeof(glc_quicklz_header_t)],
 				(void *) state->write_data,
-				(qlz_state_decompress *) state->threadptr);
+				(qlz_state_decompress *) thread->qlz);
 #else
 		return ENOTSUP;
 #endif
@@ -535,6 +1958,43 @@ int unpack_write_callback(glc_thread_state_t *state)
 				state->write_size);
 #else
 		return ENOTSUP;
+#endif
+	} else if (state->header.type == GLC_MESSAGE_LZ4) {
+#ifdef __LZ4
+		__sync_fetch_and_add(&unpack->stats.pack_size, state->read_size - sizeof(glc_lz4_header_t));
+		memcpy(&state->header, &((glc_lz4_header_t *) state->read_data)->header,
+		       sizeof(glc_message_header_t));
+		if (unlikely(LZ4_decompress_safe(&state->read_data[sizeof(glc_lz4_header_t)],
+						 state->write_data,
+						 state->read_size - sizeof(glc_lz4_header_t),
+						 state->write_size) != (int) state->write_size)) {
+			glc_log(unpack->glc, GLC_ERROR, "unpack", "corrupted LZ4 packet");
+			return EINVAL;
+		}
+#else
+		return ENOTSUP;
+#endif
+	} else if (state->header.type == GLC_MESSAGE_ZSTD) {
+#ifdef __ZSTD
+		struct unpack_thread_s *thread = (struct unpack_thread_s *) state->threadptr;
+		__sync_fetch_and_add(&unpack->stats.pack_size, state->read_size - sizeof(glc_zstd_header_t));
+		memcpy(&state->header, &((glc_zstd_header_t *) state->read_data)->header,
+		       sizeof(glc_message_header_t));
+		/* one context per thread, a packet must not cost a malloc */
+		if (!thread->dctx)
+			thread->dctx = ZSTD_createDCtx();
+		if (unlikely(!thread->dctx))
+			return ENOMEM;
+		if (unlikely(ZSTD_decompressDCtx((ZSTD_DCtx *) thread->dctx,
+						 state->write_data, state->write_size,
+						 &state->read_data[sizeof(glc_zstd_header_t)],
+						 state->read_size - sizeof(glc_zstd_header_t)) !=
+			     state->write_size)) {
+			glc_log(unpack->glc, GLC_ERROR, "unpack", "corrupted Zstandard packet");
+			return EINVAL;
+		}
+#else
+		return ENOTSUP;
 #endif
 	} else
 		return ENOTSUP;
@@ -542,6 +2002,197 @@ int unpack_write_callback(glc_thread_state_t *state)
 	return 0;
 }
 
+int unpack_delta_write_callback(glc_thread_state_t *state)
+{
+	unpack_t unpack = (unpack_t) state->ptr;
+	struct unpack_thread_s *thread = (struct unpack_thread_s *) state->threadptr;
+	struct unpack_video_s *video = thread->video;
+	glc_delta_header_t *delta_header = (glc_delta_header_t *) state->read_data;
+	const char *payload = &state->read_data[sizeof(glc_delta_header_t)];
+	size_t payload_size = state->read_size - sizeof(glc_delta_header_t);
+	size_t frame_size = delta_header->size - sizeof(glc_video_frame_header_t);
+	size_t bitmap_size;
+	struct timespec timeout;
+	char *delta;
+	int ret = 0;
+
+	__sync_fetch_and_add(&unpack->stats.pack_size, payload_size);
+
+	if (!delta_header->compression)
+		delta = (char *) payload;
+	else if (thread->buf_size >= delta_header->delta_size)
+		delta = thread->buf;
+	else {
+		free(thread->buf);
+		delta = thread->buf = (char *) malloc(delta_header->delta_size);
+		thread->buf_size = delta ? delta_header->delta_size : 0;
+		if (unlikely(!delta))
+			ret = ENOMEM;
+	}
+
+	if ((!ret) && (delta_header->compression))
+		ret = unpack_decompress(thread, delta_header->compression,
+					payload, payload_size, delta,
+					delta_header->delta_size);
+
+	/* wait for the previous frame of this stream */
+	pthread_mutex_lock(&unpack->video_mutex);
+	while ((video->done_seq != thread->seq) &&
+	       (!glc_state_test(unpack->glc, GLC_STATE_CANCEL))) {
+		clock_gettime(CLOCK_REALTIME, &timeout);
+		timeout.tv_nsec += 100000000;
+		if (timeout.tv_nsec >= 1000000000) {
+			timeout.tv_sec++;
+			timeout.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&unpack->video_cond, &unpack->video_mutex,
+				       &timeout);
+	}
+	pthread_mutex_unlock(&unpack->video_mutex);
+
+	if (unlikely(ret)) {
+		glc_log(unpack->glc, GLC_ERROR, "unpack",
+			"can't decompress delta frame using 0x%02x: %s (%d)",
+			delta_header->compression, strerror(ret), ret);
+	} else if (delta_header->flags & GLC_DELTA_KEYFRAME) {
+		if ((!video->ref) || (video->size != frame_size)) {
+			free(video->ref);
+			video->ref = (char *) malloc(frame_size);
+			video->size = video->ref ? frame_size : 0;
+		}
+		if (likely(video->ref))
+			memcpy(video->ref, &delta[sizeof(glc_video_frame_header_t)], frame_size);
+		else
+			ret = ENOMEM;
+	} else if (unlikely((!video->ref) || (video->size != frame_size))) {
+		glc_log(unpack->glc, GLC_ERROR, "unpack",
+			"video %d: delta frame without keyframe", video->id);
+		ret = EINVAL;
+	} else {
+		bitmap_size = (delta_tiles(delta_header) + 7) / 8;
+		ret = unpack_delta_scatter(delta_header,
+					   (unsigned char *) &delta[sizeof(glc_video_frame_header_t)],
+					   &delta[sizeof(glc_video_frame_header_t) + bitmap_size],
+					   delta_header->delta_size -
+					   sizeof(glc_video_frame_header_t) - bitmap_size,
+					   video->ref);
+		if (unlikely(ret)) {
+			/* the reference is damaged until the next keyframe */
+			glc_log(unpack->glc, GLC_ERROR, "unpack",
+				"video %d: corrupted delta frame", video->id);
+			video->size = 0;
+		}
+	}
+
+	/* copy out before the next frame updates the reference */
+	if (likely(!ret)) {
+		memcpy(state->write_data, delta, sizeof(glc_video_frame_header_t));
+		memcpy(&state->write_data[sizeof(glc_video_frame_header_t)],
+		       video->ref, frame_size);
+		memcpy(&state->header, &delta_header->header, sizeof(glc_message_header_t));
+	}
+
+	pthread_mutex_lock(&unpack->video_mutex);
+	video->done_seq++;
+	pthread_cond_broadcast(&unpack->video_cond);
+	pthread_mutex_unlock(&unpack->video_mutex);
+
+	if (likely(!ret))
+		__sync_fetch_and_add(&unpack->stats.unpack_size, state->write_size);
+	return ret;
+}
+
+int unpack_chunked_write_callback(glc_thread_state_t *state)
+{
+	unpack_t unpack = (unpack_t) state->ptr;
+	glc_chunked_header_t *chunked_header = (glc_chunked_header_t *) state->read_data;
+	size_t table_size;
+	int ret;
+
+	table_size = sizeof(glc_chunked_header_t) +
+		     (size_t) chunked_header->chunks * sizeof(glc_chunk_t);
+	if (unlikely((table_size > state->read_size) ||
+		     ((size_t) chunked_header->chunks * chunked_header->chunk_size <
+		      state->write_size))) {
+		glc_log(unpack->glc, GLC_ERROR, "unpack", "corrupted chunked packet");
+		return EINVAL;
+	}
+
+	__sync_fetch_and_add(&unpack->stats.pack_size, state->read_size - table_size);
+	memcpy(&state->header, &chunked_header->header, sizeof(glc_message_header_t));
+
+	if (unlikely((ret = glc_thread_slice_chunks(state, chunked_header->chunks)))) {
+		glc_log(unpack->glc, GLC_ERROR, "unpack",
+			"can't decompress chunks using 0x%02x: %s (%d)",
+			chunked_header->compression, strerror(ret), ret);
+		return ret;
+	}
+
+	__sync_fetch_and_add(&unpack->stats.unpack_size, state->write_size);
+	return 0;
+}
+
+int unpack_chunked_slice_callback(glc_thread_state_t *state,
+				  unsigned int from, unsigned int to)
+{
+	unpack_t unpack = (unpack_t) state->ptr;
+	glc_chunked_header_t *chunked_header = (glc_chunked_header_t *) state->read_data;
+	glc_chunk_t *chunk = (glc_chunk_t *) &chunked_header[1];
+	const char *data = (const char *) &chunk[chunked_header->chunks];
+	size_t data_size = state->read_size - (data - state->read_data);
+	size_t offset, size;
+	struct unpack_thread_s *wrk;
+	unsigned int c;
+	int ret = 0;
+
+	if (unlikely(!(wrk = unpack_chunk_wrk_get(unpack))))
+		return ENOMEM;
+
+	for (c = from; (c < to) && (!ret); c++) {
+		offset = (size_t) c * chunked_header->chunk_size;
+		if (unlikely((offset >= state->write_size) ||
+			     (chunk[c].offset > data_size) ||
+			     (chunk[c].size > data_size - chunk[c].offset))) {
+			ret = EINVAL;
+			break;
+		}
+
+		size = state->write_size - offset;
+		if (size > chunked_header->chunk_size)
+			size = chunked_header->chunk_size;
+
+		ret = unpack_decompress(wrk, chunked_header->compression,
+					&data[chunk[c].offset], chunk[c].size,
+					&state->write_data[offset], size);
+	}
+
+	unpack_chunk_wrk_put(unpack, wrk);
+	return ret;
+}
+
+struct unpack_thread_s *unpack_chunk_wrk_get(unpack_t unpack)
+{
+	struct unpack_thread_s *wrk;
+	void *ptr;
+
+	pthread_mutex_lock(&unpack->chunk_mutex);
+	if ((wrk = unpack->chunk_wrk) != NULL)
+		unpack->chunk_wrk = wrk->next;
+	pthread_mutex_unlock(&unpack->chunk_mutex);
+
+	if ((!wrk) && (likely(!unpack_thread_create_callback(unpack, &ptr))))
+		wrk = (struct unpack_thread_s *) ptr;
+	return wrk;
+}
+
+void unpack_chunk_wrk_put(unpack_t unpack, struct unpack_thread_s *wrk)
+{
+	pthread_mutex_lock(&unpack->chunk_mutex);
+	wrk->next = unpack->chunk_wrk;
+	unpack->chunk_wrk = wrk;
+	pthread_mutex_unlock(&unpack->chunk_mutex);
+}
+
 void print_stats(glc_t *glc, pack_stat_t *stat)
 {
 	double ratio;
@@ -34,6 +34,12 @@ typedef struct pack_s* pack_t;
 #define PACK_LZO           0x2
 /** LZJB compression */
 #define PACK_LZJB          0x3
+/** LZ4 compression */
+#define PACK_LZ4           0x4
+/** LZ4-HC compression, slow but decompressed by the LZ4 decoder */
+#define PACK_LZ4HC         0x5
+/** Zstandard compression */
+#define PACK_ZSTD          0x6
 
 /**
  * \brief unpack object
@@ -51,15 +57,46 @@ __PUBLIC int pack_init(pack_t *pack, glc_t *glc);
 /**
  * \brief set compression
  *
- * QuickLZ (PACK_QUICKLZ) and LZO (PACK_LZO) are currently supported.
- * Both are fast enough for stream compression.
- * LZO compresses marginally better but is slower. QuickLZ is default.
+ * QuickLZ (PACK_QUICKLZ), LZO (PACK_LZO), LZJB (PACK_LZJB), LZ4
+ * (PACK_LZ4), LZ4-HC (PACK_LZ4HC) and Zstandard (PACK_ZSTD) are
+ * currently supported. All but LZ4-HC are fast enough for stream
+ * compression, LZ4 being the fastest. LZ4-HC compresses better and is
+ * meant for recompressing a stream offline, its output is read by the
+ * LZ4 decoder at the same speed. Zstandard compresses much better than
+ * the others, its low levels are still fast enough for capturing.
  * \param pack pack object
  * \param compression compression algorithm
  * \return 0 on success otherwise an error code
  */
 __PUBLIC int pack_set_compression(pack_t pack, int compression);
 
+/**
+ * \brief set compression level
+ *
+ * LZ4-HC levels go from 1 to 12, Zstandard levels from 1 to 22 and
+ * below 0 for its fast modes. Higher levels are slower and compress
+ * better. LZ4 takes the level as the acceleration factor the governor
+ * starts from, higher being faster, and ignores it without a governor.
+ * Other algorithms ignore the level. The level is checked against
+ * the algorithm set by pack_set_compression().
+ * \param pack pack object
+ * \param level compression level, 0 for the default of the algorithm
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int pack_set_compression_level(pack_t pack, int level);
+
+/**
+ * \brief enable long distance matching
+ *
+ * Zstandard then looks for matches in the whole packet, which pays
+ * off on big frames with repeated content far apart, at some cost in
+ * speed and memory. Other algorithms ignore it.
+ * \param pack pack object
+ * \param long_distance 1 to enable, 0 to disable
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int pack_set_long_distance(pack_t pack, int long_distance);
+
 /**
  * \brief set compression threshold
  *
@@ -71,6 +108,62 @@ __PUBLIC int pack_set_compression(pack_t pack, int compression);
  */
 __PUBLIC int pack_set_minimum_size(pack_t pack, size_t min_size);
 
+/**
+ * \brief compress video frames in chunks
+ *
+ * Big frames are cut in up to chunks independent chunks, compressed
+ * concurrently by the pack thread and chunks - 1 slice threads, so a
+ * single frame no longer waits on one core. Chunks are at least
+ * 256 KiB, smaller frames are compressed whole. unpack decompresses
+ * them across glc_slice_threads() threads.
+ * \param pack pack object
+ * \param chunks chunks per frame, 0 or 1 disables chunking
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int pack_set_chunks(pack_t pack, unsigned int chunks);
+
+/**
+ * \brief adapt compression to a frame latency target
+ *
+ * The latency of a video frame is how long it waited in the input
+ * buffer plus how long it took to compress. When its average goes
+ * over latency, the governor steps to a faster level of the
+ * compression algorithm, and down to storing frames uncompressed,
+ * before the input buffer fills up and the capture drops frames. It
+ * steps back up after some time below half the target. Algorithms
+ * without levels only switch between compressing and storing. Every
+ * step is logged at GLC_PERF.
+ * \param pack pack object
+ * \param latency target in nanoseconds, 0 disables the governor
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int pack_set_governor(pack_t pack, glc_utime_t latency);
+
+/**
+ * \brief delta code video frames
+ *
+ * Frames are cut in tiles and only the tiles that changed since the
+ * previous frame of the same stream are compressed, along with a
+ * bitmap of them. Every keyframe_interval frames, and after a format
+ * change, the whole frame is sent. unpack rebuilds full frames.
+ * Row padding of dword aligned frames is not preserved.
+ * \param pack pack object
+ * \param keyframe_interval frames between keyframes, 0 disables delta coding
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int pack_set_delta(pack_t pack, unsigned int keyframe_interval);
+
+/**
+ * \brief get compression counters
+ *
+ * Safe to call while pack is running.
+ * \param pack pack object
+ * \param unpack_size returned bytes read from the uncompressed buffer
+ * \param pack_size returned bytes written to the compressed buffer
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int pack_get_stats(pack_t pack, glc_size_t *unpack_size, glc_size_t *pack_size);
+
 /**
  * \brief start processing threads
  *
@@ -110,7 +203,9 @@ __PUBLIC int unpack_init(unpack_t *unpack, glc_t *glc);
 /**
  * \brief start processing threads
  *
- * unpack decompresses all supported compressed messages.
+ * unpack decompresses all supported compressed messages and rebuilds
+ * delta coded frames. The chunks of a chunked message are
+ * decompressed concurrently by glc_slice_threads() threads.
  * \param unpack unpack object
  * \param from source buffer
  * \param to target buffer
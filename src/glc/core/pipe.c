@@ -38,6 +38,7 @@
 #include <glc/common/thread.h>
 #include <glc/common/util.h>
 #include <glc/common/signal.h>
+#include <glc/common/probe.h>
 #include <glc/common/optimization.h>
 
 #include <glc/core/tracker.h>
@@ -78,6 +79,11 @@ struct pipe_runtime_s
 	glc_stream_id_t id;
 	struct timespec wait_time;
 	int write_frame_ret;
+	/* copy of the last frame, written again for GLC_MESSAGE_VIDEO_REPEAT */
+	char *last_frame;
+	size_t last_frame_size;
+	size_t frame_size;
+	glc_size_t written;
 };
 
 typedef struct {
@@ -108,6 +114,7 @@ static int pipe_write_eof(sink_t sink);
 static int pipe_write_state(sink_t sink);
 static int pipe_write_process_start(sink_t sink, ps_buffer_t *from);
 static int pipe_write_process_wait(sink_t sink);
+static int pipe_get_written(sink_t sink, glc_size_t *bytes);
 static int pipe_sink_destroy(sink_t sink);
 static void close_pipe(glc_t *glc, struct pipe_runtime_s *rt);
 
@@ -122,6 +129,7 @@ static sink_ops_t pipe_sink_ops = {
 	.write_state         = pipe_write_state,
 	.write_process_start = pipe_write_process_start,
 	.write_process_wait  = pipe_write_process_wait,
+	.get_written         = pipe_get_written,
 	.destroy             = pipe_sink_destroy,
 };
 
@@ -162,6 +170,7 @@ int pipe_sink_init(sink_t *sink, glc_t *glc, const char *exec_file,
 	pipe_sink->thread.close_callback  = &pipe_close_callback;
 	pipe_sink->thread.finish_callback = &pipe_finish_callback;
 	pipe_sink->thread.threads = 1;
+	pipe_sink->thread.name    = "sink";
 
 	tracker_init(&pipe_sink->state_tracker, pipe_sink->glc);
 
@@ -362,6 +371,19 @@ static int open_pipe(pipe_sink_t *pipe_sink, glc_video_format_message_t *format,
 	frame_size = r * format->height;
 	glc_util_set_pipe_size(pipe_sink->glc,stream_pipe[1], 15*frame_size);
 
+	/* repeated frames are written again from this copy */
+	if (format->flags & GLC_VIDEO_REPEATS) {
+		pipe_sink->runtime.last_frame = (char *) malloc(frame_size);
+		if (unlikely(!pipe_sink->runtime.last_frame)) {
+			ret = ENOMEM;
+			glc_log(pipe_sink->glc, GLC_ERROR, "pipe",
+				"can't allocate the last frame copy: %s (%d)",
+				strerror(ret), ret);
+			goto err;
+		}
+		pipe_sink->runtime.last_frame_size = frame_size;
+	}
+
 	/*
 	 * Check SIGCHLD disposition and issue warning if there is a risk to interfere
 	 * with the host application.
@@ -439,6 +461,7 @@ static int open_pipe(pipe_sink_t *pipe_sink, glc_video_format_message_t *format,
 		_exit(127); /* exec failed */
 	}
 	/* else parent */
+	pipe_sink->runtime.frame_size     = frame_size;
 	pipe_sink->runtime.w_pipefd       = stream_pipe[1];
 	pipe_sink->runtime.pipe_ready     = 1;
 	pipe_sink->runtime.consumer_proc  = pid;
@@ -453,6 +476,8 @@ static int open_pipe(pipe_sink_t *pipe_sink, glc_video_format_message_t *format,
 	pthread_sigmask(SIG_SETMASK, &oset, NULL);
 	return ret;
 err:
+	free(pipe_sink->runtime.last_frame);
+	pipe_sink->runtime.last_frame = NULL;
 	close(stream_pipe[0]);
 	close(stream_pipe[1]);
 	return ret;
@@ -463,6 +488,7 @@ static int wait_pipe(pipe_sink_t *pipe_sink, int timeout_ms)
 	int ret;
 	struct epoll_event event;
 	glc_log(pipe_sink->glc, GLC_DEBUG, "pipe", "wait for pipe");
+	GLC_PROBE1(pipe_stall, timeout_ms);
 	do {
 		ret = epoll_wait(pipe_sink->runtime.epollfd, &event, 1, timeout_ms);
 	} while (unlikely(ret < 0 && errno == EINTR));
@@ -489,6 +515,7 @@ static int wait_pipe(pipe_sink_t *pipe_sink, int timeout_ms)
 			ret = 0;
 		}
 	}
+	GLC_PROBE1(pipe_ready, ret);
 	return ret;
 }
 
@@ -520,6 +547,8 @@ static int write_video_frame(pipe_sink_t *pipe_sink,
 		} else if (unlikely(ret > 0))
 				pipe_sink->runtime.pipe_ready = 0;
 	} while(ret);
+	__sync_fetch_and_add(&pipe_sink->runtime.written,
+			     pipe_sink->runtime.frame_size);
 	return 0;
 }
 
@@ -580,6 +609,24 @@ int pipe_read_callback(glc_thread_state_t *state)
 				pipe_sink->runtime.write_frame_ret = write_video_frame(pipe_sink,
 					&state->read_data[sizeof(glc_video_frame_header_t)]
 				);
+			if (pipe_sink->runtime.last_frame)
+				memcpy(pipe_sink->runtime.last_frame,
+				       &state->read_data[sizeof(glc_video_frame_header_t)],
+				       pipe_sink->runtime.last_frame_size);
+			break;
+		}
+		case GLC_MESSAGE_VIDEO_REPEAT:
+		{
+			glc_video_frame_header_t *pic_hdr =
+				(glc_video_frame_header_t *)state->read_data;
+
+			/* the pipe is opened by the first frame of the stream */
+			if (unlikely(!pipe_sink->runtime.last_frame ||
+				     pic_hdr->id != pipe_sink->runtime.id))
+				return 0;
+			if (likely(pic_hdr->time >= pipe_sink->runtime.first_frame_ts))
+				pipe_sink->runtime.write_frame_ret = write_video_frame(pipe_sink,
+					pipe_sink->runtime.last_frame);
 			break;
 		}
 		case GLC_MESSAGE_CLOSE: // noop
@@ -663,6 +710,9 @@ child_gone:
 			glcs_signal_pr_exit(glc, rt->consumer_proc, status);
 		rt->consumer_proc = 0;
 	}
+
+	free(rt->last_frame);
+	rt->last_frame = NULL;
 }
 
 /*
@@ -754,3 +804,10 @@ int pipe_write_process_wait(sink_t sink)
 	return 0;
 }
 
+int pipe_get_written(sink_t sink, glc_size_t *bytes)
+{
+	pipe_sink_t *pipe_sink = (pipe_sink_t*)sink;
+	*bytes = __sync_fetch_and_add(&pipe_sink->runtime.written, 0);
+	return 0;
+}
+
@@ -119,6 +119,8 @@ struct rgb_s {
 
 static int rgb_read_callback(glc_thread_state_t *state);
 static int rgb_write_callback(glc_thread_state_t *state);
+static int rgb_slice_callback(glc_thread_state_t *state,
+			      unsigned int from, unsigned int to);
 static void rgb_finish_callback(void *ptr, int err);
 
 static void rgbget_video_stream(rgb_t rgb, glc_stream_id_t id,
@@ -128,7 +130,8 @@ static int rgb_video_format_message(rgb_t rgb, glc_video_format_message_t *video
 
 static int rgb_init_lookup(rgb_t rgb);
 static int rgb_convert_lookup(rgb_t rgb, struct rgb_video_stream_s *ctx,
-		       unsigned char *from, unsigned char *to);
+		       unsigned char *from, unsigned char *to,
+		       unsigned int y0, unsigned int y1);
 
 int rgb_init(rgb_t *rgb, glc_t *glc)
 {
@@ -141,9 +144,12 @@ int rgb_init(rgb_t *rgb, glc_t *glc)
 	(*rgb)->thread.flags = GLC_THREAD_READ | GLC_THREAD_WRITE;
 	(*rgb)->thread.read_callback = &rgb_read_callback;
 	(*rgb)->thread.write_callback = &rgb_write_callback;
+	(*rgb)->thread.slice_callback = &rgb_slice_callback;
 	(*rgb)->thread.finish_callback = &rgb_finish_callback;
 	(*rgb)->thread.ptr = *rgb;
 	(*rgb)->thread.threads = glc_threads_hint(glc);
+	(*rgb)->thread.name    = "rgb";
+	(*rgb)->thread.slice_threads = glc_slice_threads(glc);
 
 	return 0;
 }
@@ -225,16 +231,23 @@ int rgb_read_callback(glc_thread_state_t *state)
 
 int rgb_write_callback(glc_thread_state_t *state)
 {
-	rgb_t rgb = (rgb_t) state->ptr;
 	struct rgb_video_stream_s *ctx = state->threadptr;
+	int ret;
 
 	memcpy(state->write_data, state->read_data, sizeof(glc_video_frame_header_t));
-	rgb_convert_lookup(rgb, ctx,
-		    (unsigned char *) &state->read_data[sizeof(glc_video_frame_header_t)],
-		    (unsigned char *) &state->write_data[sizeof(glc_video_frame_header_t)]);
+	ret = glc_thread_slice(state, ctx->h);
 	pthread_rwlock_unlock(&ctx->update);
 
-	return 0;
+	return ret;
+}
+
+int rgb_slice_callback(glc_thread_state_t *state,
+		       unsigned int from, unsigned int to)
+{
+	return rgb_convert_lookup(state->ptr, state->threadptr,
+		    (unsigned char *) &state->read_data[sizeof(glc_video_frame_header_t)],
+		    (unsigned char *) &state->write_data[sizeof(glc_video_frame_header_t)],
+		    from, to);
 }
 
 void rgbget_video_stream(rgb_t rgb, glc_stream_id_t id,
@@ -304,7 +317,8 @@ int rgb_init_lookup(rgb_t rgb)
 }
 
 int rgb_convert_lookup(rgb_t rgb, struct rgb_video_stream_s *video,
-		       unsigned char *from, unsigned char *to)
+		       unsigned char *from, unsigned char *to,
+		       unsigned int y0, unsigned int y1)
 {
 	unsigned int x, y, Cpix;
 	unsigned int color;
@@ -313,7 +327,7 @@ int rgb_convert_lookup(rgb_t rgb, struct rgb_video_stream_s *video,
 	Y = from;
 	Cb = &from[video->h * video->w];
 	Cr = &from[video->h * video->w + (video->h / 2) * (video->w / 2)];
-	Cpix = 0;
+	Cpix = (y0 / 2) * (video->w / 2);
 
 #define CONVERT(xadd, yrgbadd, yadd) 						\
 	color = LOOKUP_POS(Y[(x + (xadd)) + (y + (yadd)) * video->w],		\
@@ -326,7 +340,7 @@ int rgb_convert_lookup(rgb_t rgb, struct rgb_video_stream_s *video,
 		rgb->lookup_table[color + 2];
 
 	/* YCBCR_420JPEG frame dimensions are always divisible by two */
-	for (y = 0; y < video->h; y += 2) {
+	for (y = y0; y < y1; y += 2) {
 		for (x = 0; x < video->w; x += 2) {
 			CONVERT(0, -1, 0)
 			CONVERT(1, -1, 0)
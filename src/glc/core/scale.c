@@ -53,7 +53,8 @@ struct scale_video_stream_s;
 typedef void (*scale_proc)(scale_t scale,
 			   struct scale_video_stream_s *video,
 			   unsigned char *from,
-			   unsigned char *to);
+			   unsigned char *to,
+			   unsigned int y0, unsigned int y1);
 
 struct scale_video_stream_s {
 	glc_stream_id_t id;
@@ -66,6 +67,7 @@ struct scale_video_stream_s {
 	int created;
 
 	unsigned int rw, rh, rx, ry;
+	int clear;
 
 	unsigned int *pos;
 	float *factor;
@@ -88,6 +90,8 @@ struct scale_s {
 
 static int scale_read_callback(glc_thread_state_t *state);
 static int scale_write_callback(glc_thread_state_t *state);
+static int scale_slice_callback(glc_thread_state_t *state,
+				unsigned int from, unsigned int to);
 static void scale_finish_callback(void *ptr, int err);
 
 static int scale_video_format_message(scale_t scale, glc_video_format_message_t *format_message,
@@ -98,16 +102,22 @@ static int scale_generate_rgb_map(scale_t scale, struct scale_video_stream_s *vi
 static int scale_generate_ycbcr_map(scale_t scale, struct scale_video_stream_s *video);
 
 static void scale_rgb_convert(scale_t scale, struct scale_video_stream_s *video,
-		       unsigned char *from, unsigned char *to);
+		       unsigned char *from, unsigned char *to,
+		       unsigned int y0, unsigned int y1);
 static void scale_rgb_half(scale_t scale, struct scale_video_stream_s *video,
-		    unsigned char *from, unsigned char *to);
+		    unsigned char *from, unsigned char *to,
+		       unsigned int y0, unsigned int y1);
 static void scale_rgb_scale(scale_t scale, struct scale_video_stream_s *video,
-		     unsigned char *from, unsigned char *to);
+		     unsigned char *from, unsigned char *to,
+		       unsigned int y0, unsigned int y1);
 
 static void scale_ycbcr_half(scale_t scale, struct scale_video_stream_s *video,
-		      unsigned char *from, unsigned char *to);
+		      unsigned char *from, unsigned char *to,
+		       unsigned int y0, unsigned int y1);
 static void scale_ycbcr_scale(scale_t scale, struct scale_video_stream_s *video,
-		       unsigned char *from, unsigned char *to);
+		       unsigned char *from, unsigned char *to,
+		       unsigned int y0, unsigned int y1);
+static void scale_clear(struct scale_video_stream_s *video, unsigned char *to);
 
 int scale_init(scale_t *scale, glc_t *glc)
 {
@@ -118,9 +128,12 @@ int scale_init(scale_t *scale, glc_t *glc)
 	(*scale)->thread.flags = GLC_THREAD_READ | GLC_THREAD_WRITE;
 	(*scale)->thread.read_callback = &scale_read_callback;
 	(*scale)->thread.write_callback = &scale_write_callback;
+	(*scale)->thread.slice_callback = &scale_slice_callback;
 	(*scale)->thread.finish_callback = &scale_finish_callback;
 	(*scale)->thread.ptr = *scale;
 	(*scale)->thread.threads = glc_threads_hint(glc);
+	(*scale)->thread.name    = "scale";
+	(*scale)->thread.slice_threads = glc_slice_threads(glc);
 	(*scale)->scale = 1.0;
 
 	return 0;
@@ -228,15 +241,30 @@ int scale_read_callback(glc_thread_state_t *state) {
 }
 
 int scale_write_callback(glc_thread_state_t *state) {
-	scale_t scale = (scale_t) state->ptr;
 	struct scale_video_stream_s *video = state->threadptr;
+	int ret;
 
 	memcpy(state->write_data, state->read_data, sizeof(glc_video_frame_header_t));
-	video->proc(scale, video,
-		  (unsigned char *) &state->read_data[sizeof(glc_video_frame_header_t)],
-		  (unsigned char *) &state->write_data[sizeof(glc_video_frame_header_t)]);
+	if (video->clear)
+		scale_clear(video,
+			    (unsigned char *) &state->write_data[sizeof(glc_video_frame_header_t)]);
+
+	/* every proc works on rows of the scaled picture */
+	ret = glc_thread_slice(state, video->sh);
 	pthread_rwlock_unlock(&video->update);
 
+	return ret;
+}
+
+int scale_slice_callback(glc_thread_state_t *state,
+			 unsigned int from, unsigned int to)
+{
+	struct scale_video_stream_s *video = state->threadptr;
+
+	video->proc(state->ptr, video,
+		  (unsigned char *) &state->read_data[sizeof(glc_video_frame_header_t)],
+		  (unsigned char *) &state->write_data[sizeof(glc_video_frame_header_t)],
+		  from, to);
 	return 0;
 }
 
@@ -265,38 +293,36 @@ int scale_get_video_stream(scale_t scale, glc_stream_id_t id, struct scale_video
 }
 
 void scale_rgb_convert(scale_t scale, struct scale_video_stream_s *video,
-		       unsigned char *from, unsigned char *to)
+		       unsigned char *from, unsigned char *to,
+		       unsigned int y0, unsigned int y1)
 {
-	unsigned int x, y, ox, oy, op, tp;
-	unsigned int swi = video->sw * 3;
-	unsigned int shi = video->sh * 3;
-	ox = oy = 0;
+	unsigned int x, y, op, tp;
 
 	/* just convert from different bpp to 3 */
-	for (y = 0; y < shi; y += 3) {
-		for (x = 0; x < swi; x += 3) {
-			tp = x + y * video->sw;
-			op = ox + oy * video->row;
-
+	for (y = y0; y < y1; y++) {
+		tp = y * video->sw * 3;
+		op = y * video->row;
+		for (x = 0; x < video->sw; x++) {
 			to[tp + 0] = from[op + 0];
 			to[tp + 1] = from[op + 1];
 			to[tp + 2] = from[op + 2];
 
-			ox += video->bpp;
+			tp += 3;
+			op += video->bpp;
 		}
-		oy++;
-		ox = 0;
 	}
 }
 
 void scale_rgb_half(scale_t scale, struct scale_video_stream_s *video,
-		    unsigned char *from, unsigned char *to)
+		    unsigned char *from, unsigned char *to,
+		    unsigned int y0, unsigned int y1)
 {
-	unsigned int ox, oy, op1, op2, op3, op4;
+	unsigned int x, y, op1, op2, op3, op4;
 
-	for (oy = 0; oy < video->h; oy += 2) {
-		for (ox = 0; ox < video->w; ox += 2) {
-			op1 = ox * video->bpp + oy * video->row;
+	to += y0 * video->sw * 3;
+	for (y = y0; y < y1; y++) {
+		for (x = 0; x < video->sw; x++) {
+			op1 = x * 2 * video->bpp + y * 2 * video->row;
 			op2 = op1 + video->bpp;
 			op3 = op1 + video->row;
 			op4 = op2 + video->row;
@@ -319,14 +345,12 @@ void scale_rgb_half(scale_t scale, struct scale_video_stream_s *video,
 }
 
 void scale_rgb_scale(scale_t scale, struct scale_video_stream_s *video,
-		     unsigned char *from, unsigned char *to)
+		     unsigned char *from, unsigned char *to,
+		     unsigned int y0, unsigned int y1)
 {
 	unsigned int x, y, tp, sp;
 
-	if (scale->flags & SCALE_SIZE)
-		memset(to, 0, video->size);
-
-	for (y = 0; y < video->sh; y++) {
+	for (y = y0; y < y1; y++) {
 		for (x = 0; x < video->sw; x++) {
 			sp = (x + y * video->sw) * 4;
 			tp = ((x + video->rx) + (y + video->ry) * video->rw) * 3;
@@ -348,7 +372,8 @@ void scale_rgb_scale(scale_t scale, struct scale_video_stream_s *video,
 }
 
 void scale_ycbcr_half(scale_t scale, struct scale_video_stream_s *video,
-		      unsigned char *from, unsigned char *to)
+		      unsigned char *from, unsigned char *to,
+		      unsigned int y0, unsigned int y1)
 {
 	unsigned int x, y, ox, oy, cw_from, ch_from, cw_to, ch_to, op1, op2, op3, op4;
 	unsigned char *Cb_to, *Cr_to;
@@ -364,8 +389,13 @@ void scale_ycbcr_half(scale_t scale, struct scale_video_stream_s *video,
 	Cb_to = &to[video->sw * video->sh];
 	Cr_to = &Cb_to[cw_to * ch_to];
 
-	ox = oy = 0;
-	for (y = 0; y < ch_to; y++) {
+	/* y0 and y1 are even, chroma rows are half of them */
+	Cb_to += (y0 / 2) * cw_to;
+	Cr_to += (y0 / 2) * cw_to;
+
+	ox = 0;
+	oy = y0;
+	for (y = y0 / 2; y < y1 / 2; y++) {
 		for (x = 0; x < cw_to; x++) {
 			op1 = oy * cw_from + ox;
 			op2 = op1 + 1;
@@ -387,8 +417,10 @@ void scale_ycbcr_half(scale_t scale, struct scale_video_stream_s *video,
 		oy += 2;
 	}
 
-	ox = oy = 0;
-	for (y = 0; y < video->sh; y++) {
+	to += y0 * video->sw;
+	ox = 0;
+	oy = y0 * 2;
+	for (y = y0; y < y1; y++) {
 		for (x = 0; x < video->sw; x++) {
 			op1 = oy * video->w + ox;
 			op2 = op1 + 1;
@@ -408,9 +440,10 @@ void scale_ycbcr_half(scale_t scale, struct scale_video_stream_s *video,
 }
 
 void scale_ycbcr_scale(scale_t scale, struct scale_video_stream_s *video,
-		       unsigned char *from, unsigned char *to)
+		       unsigned char *from, unsigned char *to,
+		       unsigned int y0, unsigned int y1)
 {
-	unsigned int x, y, sp, cw, ch;
+	unsigned int x, y, sp, cw;
 	unsigned char *Y_to, *Cb_to, *Cr_to;
 	unsigned char *Y_from, *Cb_from, *Cr_from;
 
@@ -419,18 +452,11 @@ void scale_ycbcr_scale(scale_t scale, struct scale_video_stream_s *video,
 	Cr_from = &Cb_from[(video->w / 2) * (video->h / 2)];
 
 	cw = video->sw / 2;
-	ch = video->sh / 2;
 	Y_to = to;
 	Cb_to = &to[video->rw * video->rh];
 	Cr_to = &Cb_to[(video->rw / 2) * (video->rh / 2)];
 
-	if (scale->flags & SCALE_SIZE) {
-		memset(Y_to, 0, video->rw * video->rh);
-		memset(Cb_to, 128, (video->rw / 2) * (video->rh / 2));
-		memset(Cr_to, 128, (video->rw / 2) * (video->rh / 2));
-	}
-
-	for (y = 0; y < video->sh; y++) {
+	for (y = y0; y < y1; y++) {
 		for (x = 0; x < video->sw; x++) {
 			sp = (x + y * video->sw) * 4;
 
@@ -442,7 +468,7 @@ void scale_ycbcr_scale(scale_t scale, struct scale_video_stream_s *video,
 		}
 	}
 
-	for (y = 0; y < ch; y++) {
+	for (y = y0 / 2; y < y1 / 2; y++) {
 		for (x = 0; x < cw; x++) {
 			sp = video->sw * video->sh * 4 + (x + y * cw) * 4;
 
@@ -461,6 +487,21 @@ void scale_ycbcr_scale(scale_t scale, struct scale_video_stream_s *video,
 	}
 }
 
+void scale_clear(struct scale_video_stream_s *video, unsigned char *to)
+{
+	unsigned char *Cb_to, *Cr_to;
+
+	if (video->format == GLC_VIDEO_YCBCR_420JPEG) {
+		Cb_to = &to[video->rw * video->rh];
+		Cr_to = &Cb_to[(video->rw / 2) * (video->rh / 2)];
+
+		memset(to, 0, video->rw * video->rh);
+		memset(Cb_to, 128, (video->rw / 2) * (video->rh / 2));
+		memset(Cr_to, 128, (video->rw / 2) * (video->rh / 2));
+	} else
+		memset(to, 0, video->size);
+}
+
 int scale_video_format_message(scale_t scale,
 			       glc_video_format_message_t *format_message,
 			       glc_thread_state_t *state)
@@ -519,6 +560,7 @@ int scale_video_format_message(scale_t scale,
 	}
 
 	video->proc = NULL; /* do not try anything stupid... */
+	video->clear = 0;
 
 	if ((video->format == GLC_VIDEO_BGR) ||
 	    (video->format == GLC_VIDEO_BGRA)) {
@@ -537,6 +579,7 @@ int scale_video_format_message(scale_t scale,
 				 "scaling RGB data with factor %f (from %ux%u to %ux%u)",
 				 video->scale, video->w, video->h, video->sw, video->sh);
 			video->proc = scale_rgb_scale;
+			video->clear = scale->flags & SCALE_SIZE;
 			scale_generate_rgb_map(scale, video);
 		}
 
@@ -572,6 +615,7 @@ int scale_video_format_message(scale_t scale,
 				 "scaling Y'CbCr data with factor %f (from %ux%u to %ux%u)",
 				 video->scale, video->w, video->h, video->sw, video->sh);
 			video->proc = scale_ycbcr_scale;
+			video->clear = scale->flags & SCALE_SIZE;
 			scale_generate_ycbcr_map(scale, video);
 		}
 
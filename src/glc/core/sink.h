@@ -106,6 +106,15 @@ typedef struct
 	 * \return 0 on success otherwise an error code
 	 */
 	int (*write_process_wait)(sink_t sink);
+	/**
+	 * \brief get bytes written to the target
+	 *
+	 * Safe to call while the writing process is running.
+	 * \param sink sink object
+	 * \param bytes returned byte count since the sink was created
+	 * \return 0 on success otherwise an error code
+	 */
+	int (*get_written)(sink_t sink, glc_size_t *bytes);
 	int (*destroy)(sink_t sink);
 } sink_ops_t;
 
@@ -78,7 +78,8 @@ struct ycbcr_private_s;
 typedef void (*ycbcr_convert_proc)(ycbcr_t ycbcr,
 				   struct ycbcr_video_stream_s *video,
 				   unsigned char *from,
-				   unsigned char *to);
+				   unsigned char *to,
+				   unsigned int y0, unsigned int y1);
 
 struct ycbcr_video_stream_s {
 	glc_stream_id_t id;
@@ -104,11 +105,16 @@ struct ycbcr_s {
 	int running;
 	double scale;
 
+	/* serializes stream creation when used without the thread */
+	pthread_mutex_t video_mutex;
+
 	struct ycbcr_video_stream_s *video;
 };
 
 static int ycbcr_read_callback(glc_thread_state_t *state);
 static int ycbcr_write_callback(glc_thread_state_t *state);
+static int ycbcr_slice_callback(glc_thread_state_t *state,
+				unsigned int from, unsigned int to);
 static void ycbcr_finish_callback(void *ptr, int err);
 
 static int ycbcr_video_format_message(ycbcr_t ycbcr, glc_video_format_message_t *video_format);
@@ -117,11 +123,14 @@ static void ycbcr_get_video_stream(ycbcr_t ycbcr, glc_stream_id_t id, struct ycb
 static int ycbcr_generate_map(ycbcr_t ycbcr, struct ycbcr_video_stream_s *video);
 
 static void ycbcr_bgr_to_jpeg420(ycbcr_t ycbcr, struct ycbcr_video_stream_s *video,
-			  unsigned char *from, unsigned char *to);
+			  unsigned char *from, unsigned char *to,
+			  unsigned int y0, unsigned int y1);
 static void ycbcr_bgr_to_jpeg420_half(ycbcr_t ycbcr, struct ycbcr_video_stream_s *video,
-			       unsigned char *from, unsigned char *to);
+			       unsigned char *from, unsigned char *to,
+			       unsigned int y0, unsigned int y1);
 static void ycbcr_bgr_to_jpeg420_scale(ycbcr_t ycbcr, struct ycbcr_video_stream_s *video,
-				unsigned char *from, unsigned char *to);
+				unsigned char *from, unsigned char *to,
+				unsigned int y0, unsigned int y1);
 
 int ycbcr_init(ycbcr_t *ycbcr, glc_t *glc)
 {
@@ -132,20 +141,61 @@ int ycbcr_init(ycbcr_t *ycbcr, glc_t *glc)
 	(*ycbcr)->thread.flags = GLC_THREAD_READ | GLC_THREAD_WRITE;
 	(*ycbcr)->thread.read_callback = &ycbcr_read_callback;
 	(*ycbcr)->thread.write_callback = &ycbcr_write_callback;
+	(*ycbcr)->thread.slice_callback = &ycbcr_slice_callback;
 	(*ycbcr)->thread.finish_callback = &ycbcr_finish_callback;
 	(*ycbcr)->thread.ptr = *ycbcr;
 	(*ycbcr)->thread.threads = glc_threads_hint(glc);
+	(*ycbcr)->thread.name    = "ycbcr";
+	(*ycbcr)->thread.slice_threads = glc_slice_threads(glc);
 	(*ycbcr)->scale = 1.0;
+	pthread_mutex_init(&(*ycbcr)->video_mutex, NULL);
 
 	return 0;
 }
 
 int ycbcr_destroy(ycbcr_t ycbcr)
 {
+	/* streams are released by the thread, unless it was never started */
+	ycbcr_finish_callback(ycbcr, 0);
+	pthread_mutex_destroy(&ycbcr->video_mutex);
 	free(ycbcr);
 	return 0;
 }
 
+int ycbcr_video_format(ycbcr_t ycbcr, glc_video_format_message_t *video_format)
+{
+	int ret;
+
+	pthread_mutex_lock(&ycbcr->video_mutex);
+	ret = ycbcr_video_format_message(ycbcr, video_format);
+	pthread_mutex_unlock(&ycbcr->video_mutex);
+
+	return ret;
+}
+
+int ycbcr_convert(ycbcr_t ycbcr, glc_stream_id_t id,
+		  const unsigned char *from, unsigned char *to)
+{
+	struct ycbcr_video_stream_s *video = ycbcr->video;
+
+	while ((video != NULL) && (video->id != id))
+		video = video->next;
+	if (unlikely(video == NULL))
+		return EINVAL;
+
+	pthread_rwlock_rdlock(&video->update);
+	if (unlikely(video->convert == NULL)) {
+		pthread_rwlock_unlock(&video->update);
+		return EINVAL;
+	}
+
+	/* converters only read from the source frame */
+	video->convert(ycbcr, video, (unsigned char *) from, to, 0, video->yh);
+	pthread_rwlock_unlock(&video->update);
+
+	return 0;
+}
+
 int ycbcr_set_scale(ycbcr_t ycbcr, double scale)
 {
 	if (unlikely(scale <= 0))
@@ -232,15 +282,25 @@ int ycbcr_read_callback(glc_thread_state_t *state)
 
 int ycbcr_write_callback(glc_thread_state_t *state)
 {
-	ycbcr_t ycbcr = state->ptr;
 	struct ycbcr_video_stream_s *video = state->threadptr;
+	int ret;
 
 	memcpy(state->write_data, state->read_data, sizeof(glc_video_frame_header_t));
-	video->convert(ycbcr, video,
-		     (unsigned char *) &state->read_data[sizeof(glc_video_frame_header_t)],
-		     (unsigned char *) &state->write_data[sizeof(glc_video_frame_header_t)]);
+	ret = glc_thread_slice(state, video->yh);
 	pthread_rwlock_unlock(&video->update);
 
+	return ret;
+}
+
+int ycbcr_slice_callback(glc_thread_state_t *state,
+			 unsigned int from, unsigned int to)
+{
+	struct ycbcr_video_stream_s *video = state->threadptr;
+
+	video->convert(state->ptr, video,
+		     (unsigned char *) &state->read_data[sizeof(glc_video_frame_header_t)],
+		     (unsigned char *) &state->write_data[sizeof(glc_video_frame_header_t)],
+		     from, to);
 	return 0;
 }
 
@@ -265,8 +325,13 @@ void ycbcr_get_video_stream(ycbcr_t ycbcr, glc_stream_id_t id, struct ycbcr_vide
 	}
 }
 
+/*
+ * Converters fill Y' rows [y0, y1) and the matching chroma rows.
+ * y0 and y1 are even.
+ */
 void ycbcr_bgr_to_jpeg420(ycbcr_t ycbcr, struct ycbcr_video_stream_s *video,
-			  unsigned char *from, unsigned char *to)
+			  unsigned char *from, unsigned char *to,
+			  unsigned int y0, unsigned int y1)
 {
 	unsigned int Ypix;
 	unsigned int op1, op2, op3, op4;
@@ -275,13 +340,13 @@ void ycbcr_bgr_to_jpeg420(ycbcr_t ycbcr, struct ycbcr_video_stream_s *video,
 	unsigned char *Y, *Cb, *Cr;
 
 	Y = to;
-	Cb = &to[video->yw * video->yh];
-	Cr = &to[video->yw * video->yh + video->cw * video->ch];
+	Cb = &to[video->yw * video->yh + (y0 / 2) * video->cw];
+	Cr = &to[video->yw * video->yh + video->cw * video->ch + (y0 / 2) * video->cw];
 
-	oy = (video->h - 2) * video->row;
+	oy = (video->h - 2 - y0) * video->row;
 	ox = 0;
 
-	for (Yy = 0; Yy < video->yh; Yy += 2) {
+	for (Yy = y0; Yy < y1; Yy += 2) {
 		for (Yx = 0; Yx < video->yw; Yx += 2) {
 			op1 = ox + oy;
 			op2 = op1 + video->bpp;
@@ -326,7 +391,8 @@ void ycbcr_bgr_to_jpeg420(ycbcr_t ycbcr, struct ycbcr_video_stream_s *video,
 	Bd = (from[op1 + 0] + from[op2 + 0] + from[op3 + 0] + from[op4 + 0]) >> 2;
 
 void ycbcr_bgr_to_jpeg420_half(ycbcr_t ycbcr, struct ycbcr_video_stream_s *video,
-			       unsigned char *from, unsigned char *to)
+			       unsigned char *from, unsigned char *to,
+			       unsigned int y0, unsigned int y1)
 {
 	unsigned int Ypix;
 	unsigned int op1, op2, op3, op4;
@@ -334,13 +400,13 @@ void ycbcr_bgr_to_jpeg420_half(ycbcr_t ycbcr, struct ycbcr_video_stream_s *video
 	unsigned int ox, oy, Yy, Yx;
 	unsigned char *Cb, *Cr;
 
-	Cb = &to[video->yw * video->yh];
-	Cr = &to[video->yw * video->yh + video->cw * video->ch];
+	Cb = &to[video->yw * video->yh + (y0 / 2) * video->cw];
+	Cr = &to[video->yw * video->yh + video->cw * video->ch + (y0 / 2) * video->cw];
 
-	oy = (video->h - 4);
+	oy = (video->h - 4 - 2 * y0);
 	ox = 0;
 
-	for (Yy = 0; Yy < video->yh; Yy += 2) {
+	for (Yy = y0; Yy < y1; Yy += 2) {
 		for (Yx = 0; Yx < video->yw; Yx += 2) {
 			/* CbCr */
 			CALC_BILINEAR_RGB(video->bpp, video->bpp * 2, 1, 2)
@@ -372,7 +438,8 @@ void ycbcr_bgr_to_jpeg420_half(ycbcr_t ycbcr, struct ycbcr_video_stream_s *video
 #undef CALC_BILINEAR_RGB
 
 void ycbcr_bgr_to_jpeg420_scale(ycbcr_t ycbcr, struct ycbcr_video_stream_s *video,
-				unsigned char *from, unsigned char *to)
+				unsigned char *from, unsigned char *to,
+				unsigned int y0, unsigned int y1)
 {
 	unsigned int Cpix;
 	unsigned char *Y, *Cb, *Cr;
@@ -383,7 +450,7 @@ void ycbcr_bgr_to_jpeg420_scale(ycbcr_t ycbcr, struct ycbcr_video_stream_s *vide
 	Cb = &to[video->yw * video->yh];
 	Cr = &to[video->yw * video->yh + video->cw * video->ch];
 
-	Cpix = 0;
+	Cpix = (y0 / 2) * video->cw;
 	Cmap = video->yw * video->yh;
 
 #define CALC_Rd(m) (from[video->pos[m + 0] + 2] * video->factor[m + 0] \
@@ -404,7 +471,7 @@ void ycbcr_bgr_to_jpeg420_scale(ycbcr_t ycbcr, struct ycbcr_video_stream_s *vide
 	Gd = CALC_Bd((m) * 4); \
 	Bd = CALC_Gd((m) * 4);
 
-	for (Yy = 0; Yy < video->yh; Yy += 2) {
+	for (Yy = y0; Yy < y1; Yy += 2) {
 		for (Yx = 0; Yx < video->yw; Yx += 2) {
 			/* CbCr */
 			CALC_RdBdGd(Cmap + Cpix)
@@ -62,6 +62,35 @@ __PUBLIC int ycbcr_set_scale(ycbcr_t ycbcr, double scale);
 __PUBLIC int ycbcr_process_start(ycbcr_t ycbcr, ps_buffer_t *from,
 				 ps_buffer_t *to);
 
+/**
+ * \brief set up a stream for ycbcr_convert()
+ *
+ * This handles a video format message like the ycbcr process
+ * does. The message is updated in place to describe the
+ * converted frames and should be written instead of the
+ * original one.
+ * \param ycbcr ycbcr object
+ * \param video_format BGR or BGRA video format message
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int ycbcr_video_format(ycbcr_t ycbcr,
+				glc_video_format_message_t *video_format);
+
+/**
+ * \brief convert a single frame
+ *
+ * Converts directly from a BGR or BGRA frame to YCBCR_420JPEG,
+ * without going through a buffer and the ycbcr thread. This
+ * can be called concurrently for different streams.
+ * \param ycbcr ycbcr object
+ * \param id video stream set up with ycbcr_video_format()
+ * \param from source frame
+ * \param to destination, sized for the converted frame
+ * \return 0 on success otherwise an error code
+ */
+__PUBLIC int ycbcr_convert(ycbcr_t ycbcr, glc_stream_id_t id,
+			   const unsigned char *from, unsigned char *to);
+
 /**
  * \brief block until current process has finished
  * \param ycbcr ycbcr object
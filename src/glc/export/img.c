@@ -104,6 +104,7 @@ int img_init(img_t *img, glc_t *glc)
 	(*img)->thread.read_callback = &img_read_callback;
 	(*img)->thread.finish_callback = &img_finish_callback;
 	(*img)->thread.threads = 1;
+	(*img)->thread.name    = "export";
 
 	return 0;
 }
@@ -202,6 +203,10 @@ int img_read_callback(glc_thread_state_t *state)
 		ret = img_video_frame_message(img, (glc_video_frame_header_t *) state->read_data,
 		      (const unsigned char *) &state->read_data[sizeof(glc_video_frame_header_t)],
 			      state->read_size);
+	} else if ((state->header.type == GLC_MESSAGE_VIDEO_REPEAT) &&
+		   (img->prev_video_frame_message)) {
+		ret = img_video_frame_message(img, (glc_video_frame_header_t *) state->read_data,
+			      img->prev_video_frame_message, img->row * img->h);
 	}
 
 	return ret;
@@ -262,7 +267,8 @@ int img_video_frame_message(img_t img, glc_video_frame_header_t *pic_hdr,
 		ret = img->write_proc(img, pic, img->w, img->h, filename);
 	}
 
-	memcpy(img->prev_video_frame_message, pic, pic_size);
+	if (pic != img->prev_video_frame_message)
+		memcpy(img->prev_video_frame_message, pic, pic_size);
 
 	return ret;
 }
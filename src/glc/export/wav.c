@@ -117,6 +117,7 @@ int wav_init(wav_t *wav, glc_t *glc)
 	(*wav)->thread.read_callback = &wav_read_callback;
 	(*wav)->thread.finish_callback = &wav_finish_callback;
 	(*wav)->thread.threads = 1;
+	(*wav)->thread.name    = "export";
 
 	return 0;
 }
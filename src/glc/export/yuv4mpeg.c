@@ -62,6 +62,7 @@ struct yuv4mpeg_s {
 	unsigned int size;
 	char *prev_video_frame_message;
 	int interpolate;
+	int repeats;
 
 	const char *filename_format;
 	glc_stream_id_t id;
@@ -91,6 +92,7 @@ int yuv4mpeg_init(yuv4mpeg_t *yuv4mpeg, glc_t *glc)
 	(*yuv4mpeg)->thread.read_callback = &yuv4mpeg_read_callback;
 	(*yuv4mpeg)->thread.finish_callback = &yuv4mpeg_finish_callback;
 	(*yuv4mpeg)->thread.threads = 1;
+	(*yuv4mpeg)->thread.name    = "export";
 
 	return 0;
 }
@@ -182,6 +184,11 @@ int yuv4mpeg_read_callback(glc_thread_state_t *state)
 		return yuv4mpeg_handle_video_frame_message(yuv4mpeg,
 			(glc_video_frame_header_t *) state->read_data,
 			&state->read_data[sizeof(glc_video_frame_header_t)]);
+	else if ((state->header.type == GLC_MESSAGE_VIDEO_REPEAT) &&
+		 (yuv4mpeg->prev_video_frame_message))
+		return yuv4mpeg_handle_video_frame_message(yuv4mpeg,
+			(glc_video_frame_header_t *) state->read_data,
+			yuv4mpeg->prev_video_frame_message);
 
 	return 0;
 }
@@ -218,7 +225,9 @@ int yuv4mpeg_handle_hdr(yuv4mpeg_t yuv4mpeg, glc_video_format_message_t *video_f
 	yuv4mpeg->size = video_format->width * video_format->height +
 			 (video_format->width * video_format->height) / 2;
 
-	if (yuv4mpeg->interpolate) {
+	/* previous frame is also needed to expand repeat messages */
+	yuv4mpeg->repeats = video_format->flags & GLC_VIDEO_REPEATS;
+	if (yuv4mpeg->interpolate || yuv4mpeg->repeats) {
 		if (yuv4mpeg->prev_video_frame_message)
 			yuv4mpeg->prev_video_frame_message = (char *)
 			realloc(yuv4mpeg->prev_video_frame_message, yuv4mpeg->size);
@@ -263,7 +272,8 @@ int yuv4mpeg_handle_video_frame_message(yuv4mpeg_t yuv4mpeg, glc_video_frame_hea
 		yuv4mpeg->time += yuv4mpeg->fps_usec;
 	}
 
-	if (yuv4mpeg->interpolate)
+	if ((yuv4mpeg->interpolate || yuv4mpeg->repeats) &&
+	    (data != yuv4mpeg->prev_video_frame_message))
 		memcpy(yuv4mpeg->prev_video_frame_message, data, yuv4mpeg->size);
 
 	return 0;
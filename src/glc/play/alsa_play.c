@@ -108,6 +108,7 @@ int alsa_play_init(alsa_play_t *alsa_play, glc_t *glc)
 	(*alsa_play)->thread.finish_callback = &alsa_play_finish_callback;
 	(*alsa_play)->thread.threads = 1;
 	(*alsa_play)->thread.ask_rt  = 1;
+	(*alsa_play)->thread.name    = "alsa_play";
 
 	return 0;
 }
@@ -206,6 +206,7 @@ int demux_process_start(demux_t demux, ps_buffer_t *from)
 		return EAGAIN;
 
 	demux->from = from;
+	demux->thread.name = "demux";
 
 	return glc_simple_thread_create(demux->glc, &demux->thread,
 					demux_thread, demux);
@@ -216,6 +217,7 @@ int demux_vfilter_start(demux_t demux)
 	if (!demux->vfilter)
 		return 0;
 
+	demux->vfilter->thread.name = "demux";
 	return glc_simple_thread_create(demux->glc, &demux->vfilter->thread,
 					vfilter_thread, demux);
 }
@@ -266,6 +268,7 @@ void *demux_thread(void *argptr)
 
 		if ((msg_hdr.type == GLC_MESSAGE_CLOSE)       ||
 		    (msg_hdr.type == GLC_MESSAGE_VIDEO_FRAME) ||
+		    (msg_hdr.type == GLC_MESSAGE_VIDEO_REPEAT) ||
 		    (msg_hdr.type == GLC_MESSAGE_VIDEO_FORMAT)) {
 			if (!demux->vfilter) {
 				/* handle msg to gl_play */
@@ -378,7 +381,8 @@ int demux_video_stream_message(demux_t demux, glc_message_header_t *header,
 		return 0;
 	} else if (header->type == GLC_MESSAGE_VIDEO_FORMAT)
 		id = ((glc_video_format_message_t *) data)->id;
-	else if (header->type == GLC_MESSAGE_VIDEO_FRAME)
+	else if ((header->type == GLC_MESSAGE_VIDEO_FRAME) ||
+		 (header->type == GLC_MESSAGE_VIDEO_REPEAT))
 		id = ((glc_video_frame_header_t *) data)->id;
 	else
 		return EINVAL;
@@ -42,6 +42,7 @@
 
 #include <glc/common/glc.h>
 #include <glc/common/optimization.h>
+#include <glc/capture/gl_capture.h>
 
 #define LIB_CAPTURING    0x1
 
@@ -69,6 +70,8 @@ __PRIVATE void *wrapped_func(const char *symbol);
 __PRIVATE int start_capture();
 __PRIVATE int reload_capture();
 __PRIVATE int stop_capture();
+__PRIVATE int get_capture_stats(int *capturing, glc_size_t *unpack_size,
+				glc_size_t *pack_size, glc_size_t *written);
 /**  \} */
 
 /**
@@ -94,6 +97,8 @@ __PRIVATE int opengl_capture_stop();
 __PRIVATE int opengl_refresh_color_correction();
 __PRIVATE int opengl_close();
 __PRIVATE int opengl_push_message(glc_message_header_t *hdr, void *message, size_t message_size);
+__PRIVATE void opengl_resize_window(Display *dpy, Window window, unsigned int w, unsigned int h);
+__PRIVATE int opengl_get_stats(gl_capture_stats_t *stats, size_t *count);
 /**  \} */
 
 /**
@@ -104,6 +109,14 @@ __PRIVATE int x11_init(glc_t *glc);
 __PRIVATE int x11_close();
 /**  \} */
 
+/**
+ * \addtogroup stats
+ *  \{
+ */
+__PRIVATE int stats_init(glc_t *glc);
+__PRIVATE int stats_close();
+/**  \} */
+
 /**
  * \defgroup hooks Hooked functions
  *  \{
@@ -119,6 +132,12 @@ __PRIVATE void __opengl_glXSwapBuffers(Display *dpy, GLXDrawable drawable);
 __PRIVATE void __opengl_glFinish(void);
 __PRIVATE void __opengl_glXSwapBuffers(Display *dpy, GLXDrawable drawable);
 __PRIVATE GLXWindow __opengl_glXCreateWindow(Display *dpy, GLXFBConfig config, Window win, const int *attrib_list);
+__PRIVATE void __opengl_glReadBuffer(GLenum mode);
+__PRIVATE void __opengl_glBindFramebuffer(GLenum target, GLuint framebuffer);
+__PRIVATE void __opengl_glBindFramebufferEXT(GLenum target, GLuint framebuffer);
+__PRIVATE Bool __opengl_glXMakeCurrent(Display *dpy, GLXDrawable drawable, GLXContext ctx);
+__PRIVATE Bool __opengl_glXMakeContextCurrent(Display *dpy, GLXDrawable draw, GLXDrawable read, GLXContext ctx);
+__PRIVATE void __opengl_glXDestroyContext(Display *dpy, GLXContext ctx);
 
 __PRIVATE int __x11_XNextEvent(Display *display, XEvent *event_return);
 __PRIVATE int __x11_XPeekEvent(Display *display, XEvent *event_return);
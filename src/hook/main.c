@@ -44,6 +44,7 @@
 #include <glc/common/log.h>
 #include <glc/common/util.h>
 #include <glc/common/state.h>
+#include <glc/common/trace.h>
 #include <glc/core/pack.h>
 #include <glc/core/file.h>
 #include <glc/core/pipe.h>
@@ -58,6 +59,10 @@
 #define MAIN_SYNC                 0x20
 #define MAIN_COMPRESS_LZJB        0x40
 #define MAIN_START                0x80
+#define MAIN_COMPRESS_LZ4        0x100
+#define MAIN_COMPRESS_LZ4HC      0x200
+#define MAIN_COMPRESS_ZSTD       0x400
+#define MAIN_COMPRESS_LONG       0x800
 
 #define SINK_CB_RELOAD_ARG         (void *)0x1
 #define SINK_CB_STOP_ARG           (void *)0x2
@@ -74,6 +79,10 @@ struct main_private_s {
 	pack_t pack;
 
 	unsigned int capture_id;
+	unsigned int delta_keyframe;
+	unsigned int compress_chunks;
+	unsigned int compress_latency_ms;
+	int compress_level;
 	unsigned pipe_delay_ms;
 	const char *pipe_exec_file;
 	const char *stream_file_fmt;
@@ -137,6 +146,7 @@ void init_glc()
 		goto err;
 	if (unlikely((ret = x11_init(&mpriv.glc))))
 		goto err;
+	stats_init(&mpriv.glc); /* not critical */
 
 	glc_util_log_info(&mpriv.glc);
 
@@ -160,6 +170,7 @@ err:
 int load_environ()
 {
 	char *log_file;
+	char *trace_file;
 	char *env_val;
 
 	if ((env_val = getenv("GLC_START"))) {
@@ -224,16 +235,68 @@ int load_environ()
 				mpriv.flags |= MAIN_COMPRESS_QUICKLZ;
 			else if (!strcmp(env_val, "lzjb"))
 				mpriv.flags |= MAIN_COMPRESS_LZJB;
-			else
+			else if (!strcmp(env_val, "lz4"))
+				mpriv.flags |= MAIN_COMPRESS_LZ4;
+			else if (!strncmp(env_val, "lz4hc", 5) &&
+				 ((env_val[5] == '\0') || (env_val[5] == ':'))) {
+				mpriv.flags |= MAIN_COMPRESS_LZ4HC;
+				if (env_val[5] == ':')
+					mpriv.compress_level = atoi(&env_val[6]);
+			} else if (!strncmp(env_val, "zstd", 4) &&
+				   ((env_val[4] == '\0') || (env_val[4] == ':'))) {
+				/* zstd[:LEVEL[:long]] */
+				mpriv.flags |= MAIN_COMPRESS_ZSTD;
+				if (env_val[4] == ':')
+					mpriv.compress_level = atoi(&env_val[5]);
+				if ((env_val[4] == ':') && (env_val = strchr(&env_val[5], ':')) &&
+				    (!strcmp(&env_val[1], "long")))
+					mpriv.flags |= MAIN_COMPRESS_LONG;
+			} else
 				mpriv.flags |= MAIN_COMPRESS_NONE;
 		} else
 			mpriv.flags |= MAIN_COMPRESS_LZO;
+
+		if ((env_val = getenv("GLC_DELTA_KEYFRAME")))
+			mpriv.delta_keyframe = atoi(env_val);
+
+		if ((env_val = getenv("GLC_COMPRESS_CHUNKS")))
+			mpriv.compress_chunks = atoi(env_val);
+
+		if ((env_val = getenv("GLC_COMPRESS_LATENCY")))
+			mpriv.compress_latency_ms = atoi(env_val);
 	} else
 		 mpriv.flags |= MAIN_COMPRESS_NONE;
 
 	if ((env_val = getenv("GLC_RTPRIO")))
 		glc_set_allow_rt(&mpriv.glc, atoi(env_val));
 
+	if ((env_val = getenv("GLC_SLICE_THREADS")))
+		glc_set_slice_threads(&mpriv.glc, atoi(env_val));
+
+	if ((env_val = getenv("GLC_AFFINITY"))) {
+		if (unlikely(glc_set_affinity(&mpriv.glc, env_val)))
+			glc_log(&mpriv.glc, GLC_ERROR, "main",
+				"invalid GLC_AFFINITY '%s' - ignored", env_val);
+	}
+
+	if ((env_val = getenv("GLC_SCHED"))) {
+		if (unlikely(glc_set_sched(&mpriv.glc, env_val)))
+			glc_log(&mpriv.glc, GLC_ERROR, "main",
+				"invalid GLC_SCHED '%s' - ignored", env_val);
+	}
+
+	if ((env_val = getenv("GLC_TRACE"))) {
+		trace_file = glc_util_format_filename(env_val, 0);
+		if (unlikely(glc_trace_open(&mpriv.glc, trace_file)))
+			glc_log(&mpriv.glc, GLC_ERROR, "main",
+				"can't trace to '%s' - ignored", trace_file);
+		free(trace_file);
+	}
+
+	if ((env_val = getenv("GLC_STATS_INTERVAL")))
+		glc_set_stats_interval(&mpriv.glc,
+				       (glc_utime_t) (atof(env_val) * 1000000000.0));
+
 	/* Account for sink thread and possibly compress filter ones */
 	glc_account_threads(&mpriv.glc, 1, !(mpriv.flags & MAIN_COMPRESS_NONE));
 
@@ -474,6 +537,33 @@ err_nolock:
 	return ret;
 }
 
+/*
+ * Returns ENOENT until start_glc() has created the sink, in
+ * which case only capturing is set.
+ */
+int get_capture_stats(int *capturing, glc_size_t *unpack_size,
+		      glc_size_t *pack_size, glc_size_t *written)
+{
+	int ret = 0;
+
+	*unpack_size = *pack_size = *written = 0;
+
+	/* lib.running is only set once the sink and pack are up */
+	pthread_mutex_lock(&mpriv.capture_action_lock);
+	*capturing = (lib.flags & LIB_CAPTURING) != 0;
+	if (!lib.running) {
+		ret = ENOENT;
+		goto out;
+	}
+
+	if (!(mpriv.flags & MAIN_COMPRESS_NONE))
+		pack_get_stats(mpriv.pack, unpack_size, pack_size);
+	mpriv.sink->ops->get_written(mpriv.sink, written);
+out:
+	pthread_mutex_unlock(&mpriv.capture_action_lock);
+	return ret;
+}
+
 int start_glc()
 {
 	int ret;
@@ -517,6 +607,20 @@ int start_glc()
 			pack_set_compression(mpriv.pack, PACK_LZO);
 		else if (mpriv.flags & MAIN_COMPRESS_LZJB)
 			pack_set_compression(mpriv.pack, PACK_LZJB);
+		else if (mpriv.flags & MAIN_COMPRESS_LZ4)
+			pack_set_compression(mpriv.pack, PACK_LZ4);
+		else if (mpriv.flags & MAIN_COMPRESS_LZ4HC)
+			pack_set_compression(mpriv.pack, PACK_LZ4HC);
+		else if (mpriv.flags & MAIN_COMPRESS_ZSTD)
+			pack_set_compression(mpriv.pack, PACK_ZSTD);
+
+		pack_set_compression_level(mpriv.pack, mpriv.compress_level);
+		pack_set_long_distance(mpriv.pack, (mpriv.flags & MAIN_COMPRESS_LONG) ? 1 : 0);
+
+		pack_set_delta(mpriv.pack, mpriv.delta_keyframe);
+		pack_set_chunks(mpriv.pack, mpriv.compress_chunks);
+		pack_set_governor(mpriv.pack,
+				  (glc_utime_t) mpriv.compress_latency_ms * 1000000);
 
 		if (unlikely((ret = pack_process_start(mpriv.pack, mpriv.uncompressed,
 						       mpriv.compressed))))
@@ -558,6 +662,9 @@ void lib_close()
 
 	glc_log(&mpriv.glc, GLC_INFO, "main", "closing glc");
 
+	/* reads the objects destroyed below */
+	stats_close();
+
 	if (unlikely((ret = alsa_close())))
 		goto err;
 	if (unlikely((ret = opengl_close())))
@@ -662,6 +769,18 @@ void *wrapped_func(const char *symbol)
 		return &__opengl_glFinish;
 	else if (!strcmp(symbol, "glXCreateWindow"))
 		return &__opengl_glXCreateWindow;
+	else if (!strcmp(symbol, "glReadBuffer"))
+		return &__opengl_glReadBuffer;
+	else if (!strcmp(symbol, "glBindFramebuffer"))
+		return &__opengl_glBindFramebuffer;
+	else if (!strcmp(symbol, "glBindFramebufferEXT"))
+		return &__opengl_glBindFramebufferEXT;
+	else if (!strcmp(symbol, "glXMakeCurrent"))
+		return &__opengl_glXMakeCurrent;
+	else if (!strcmp(symbol, "glXMakeContextCurrent"))
+		return &__opengl_glXMakeContextCurrent;
+	else if (!strcmp(symbol, "glXDestroyContext"))
+		return &__opengl_glXDestroyContext;
 	else if (!strcmp(symbol, "snd_pcm_open"))
 		return &__alsa_snd_pcm_open;
 	else if (!strcmp(symbol, "snd_pcm_close"))
@@ -63,9 +63,18 @@ struct opengl_private_s {
 	void (*glFinish)(void);
 	__GLXextFuncPtr (*glXGetProcAddressARB)(const GLubyte *);
 	GLXWindow (*glXCreateWindow)(Display *, GLXFBConfig, Window, const int *);
+	void (*glReadBuffer)(GLenum);
+	void (*glBindFramebuffer)(GLenum, GLuint);
+	void (*glBindFramebufferEXT)(GLenum, GLuint);
+	Bool (*glXMakeCurrent)(Display *, GLXDrawable, GLXContext);
+	Bool (*glXMakeContextCurrent)(Display *, GLXDrawable, GLXDrawable, GLXContext);
+	void (*glXDestroyContext)(Display *, GLXContext);
 
 	int capture_glfinish;
 	int colorspace;
+	int gpu_convert;
+	int direct_convert;
+	int cpu_filter;
 	double scale_factor;
 	GLenum read_buffer;
 	double fps;
@@ -142,9 +151,39 @@ int opengl_init(glc_t *glc)
 	if ((env_val = getenv("GLC_SCALE")))
 		opengl.scale_factor = atof(env_val);
 
+	opengl.gpu_convert = 0;
+	if ((env_val = getenv("GLC_GPU_CONVERT")))
+		opengl.gpu_convert = atoi(env_val);
+
+	if (opengl.gpu_convert) {
+		gl_capture_convert_ycbcr(opengl.gl_capture,
+					 opengl.colorspace == CS_YCBCR_420JPEG);
+		gl_capture_set_scale(opengl.gl_capture, opengl.scale_factor);
+	}
+
+	opengl.direct_convert = 0;
+	if ((env_val = getenv("GLC_DIRECT_CONVERT")))
+		opengl.direct_convert = atoi(env_val) &&
+					(opengl.colorspace == CS_YCBCR_420JPEG) &&
+					!opengl.gpu_convert;
+
+	/* conversion and scaling left to a filter thread */
+	opengl.cpu_filter = !opengl.gpu_convert && !opengl.direct_convert &&
+			    ((opengl.scale_factor != 1.0) ||
+			     opengl.colorspace == CS_YCBCR_420JPEG);
+
 	if ((env_val = getenv("GLC_TRY_PBO")))
 		gl_capture_try_pbo(opengl.gl_capture, atoi(env_val));
 
+	if ((env_val = getenv("GLC_PBO_DEPTH")))
+		gl_capture_set_pbo_depth(opengl.gl_capture, atoi(env_val));
+
+	if ((env_val = getenv("GLC_READBACK_THREAD")))
+		gl_capture_readback_thread(opengl.gl_capture, atoi(env_val));
+
+	if ((env_val = getenv("GLC_SKIP_DUPLICATES")))
+		gl_capture_skip_duplicates(opengl.gl_capture, atoi(env_val));
+
 	gl_capture_set_pack_alignment(opengl.gl_capture, 8);
 	if ((env_val = getenv("GLC_CAPTURE_DWORD_ALIGNED"))) {
 		if (!atoi(env_val))
@@ -170,8 +209,7 @@ int opengl_init(glc_t *glc)
 
 	get_real_opengl();
 	/* Count host app rendering thread and possible filter threads on glcs side */
-	glc_account_threads(opengl.glc, 1, (opengl.scale_factor != 1.0) ||
-					   opengl.colorspace == CS_YCBCR_420JPEG);
+	glc_account_threads(opengl.glc, 1, opengl.cpu_filter);
 	return 0;
 }
 
@@ -183,7 +221,7 @@ int opengl_start(ps_buffer_t *buffer)
 	opengl.buffer = buffer;
 
 	/* init unscaled buffer if it is needed */
-	if ((opengl.scale_factor != 1.0) || opengl.colorspace == CS_YCBCR_420JPEG) {
+	if (opengl.cpu_filter) {
 		/* if scaling is enabled, it is faster to capture as GL_BGRA */
 		gl_capture_set_pixel_format(opengl.gl_capture, GL_BGRA);
 
@@ -207,6 +245,15 @@ int opengl_start(ps_buffer_t *buffer)
 		}
 
 		gl_capture_set_buffer(opengl.gl_capture, opengl.unscaled);
+	} else if (opengl.direct_convert) {
+		/* converted by gl_capture, right out of the PBO */
+		gl_capture_set_pixel_format(opengl.gl_capture, GL_BGRA);
+
+		ycbcr_init(&opengl.ycbcr, opengl.glc);
+		ycbcr_set_scale(opengl.ycbcr, opengl.scale_factor);
+		gl_capture_set_ycbcr(opengl.gl_capture, opengl.ycbcr);
+
+		gl_capture_set_buffer(opengl.gl_capture, opengl.buffer);
 	} else {
 		gl_capture_set_pixel_format(opengl.gl_capture,
 					    opengl.colorspace==CS_BGR?GL_BGR:GL_BGRA);
@@ -229,6 +276,9 @@ int opengl_close()
 	if (opengl.capturing)
 		gl_capture_stop(opengl.gl_capture);
 	gl_capture_destroy(opengl.gl_capture);
+	opengl.gl_capture = NULL;
+	if (opengl.direct_convert)
+		ycbcr_destroy(opengl.ycbcr);
 
 	if (opengl.unscaled) {
 		if (lib.running) {
@@ -300,6 +350,17 @@ finish:
 	return ret;
 }
 
+void opengl_resize_window(Display *dpy, Window window, unsigned int w, unsigned int h)
+{
+	if (likely(opengl.gl_capture))
+		gl_capture_resize_window(opengl.gl_capture, dpy, window, w, h);
+}
+
+int opengl_get_stats(gl_capture_stats_t *stats, size_t *count)
+{
+	return gl_capture_get_stats(opengl.gl_capture, stats, count);
+}
+
 int opengl_capture_start()
 {
 	int ret;
@@ -355,6 +416,31 @@ void get_real_opengl()
 	opengl.glXCreateWindow =
 	  (GLXWindow (*)(Display *dpy, GLXFBConfig, Window, const int *))
 	    lib.dlsym(opengl.libGL_handle, "glXCreateWindow");
+	opengl.glReadBuffer =
+	  (void (*)(GLenum))
+	    lib.dlsym(opengl.libGL_handle, "glReadBuffer");
+	if (unlikely(!opengl.glReadBuffer))
+		goto err;
+	opengl.glXMakeCurrent =
+	  (Bool (*)(Display *, GLXDrawable, GLXContext))
+	    lib.dlsym(opengl.libGL_handle, "glXMakeCurrent");
+	if (unlikely(!opengl.glXMakeCurrent))
+		goto err;
+	opengl.glXDestroyContext =
+	  (void (*)(Display *, GLXContext))
+	    lib.dlsym(opengl.libGL_handle, "glXDestroyContext");
+	if (unlikely(!opengl.glXDestroyContext))
+		goto err;
+	/* GLX 1.3 and framebuffer objects are optional */
+	opengl.glXMakeContextCurrent =
+	  (Bool (*)(Display *, GLXDrawable, GLXDrawable, GLXContext))
+	    lib.dlsym(opengl.libGL_handle, "glXMakeContextCurrent");
+	opengl.glBindFramebuffer =
+	  (void (*)(GLenum, GLuint))
+	    opengl.glXGetProcAddressARB((const GLubyte *) "glBindFramebuffer");
+	opengl.glBindFramebufferEXT =
+	  (void (*)(GLenum, GLuint))
+	    opengl.glXGetProcAddressARB((const GLubyte *) "glBindFramebufferEXT");
 	return;
 err:
 	fprintf(stderr, "(glc) can't get real OpenGL\n");
@@ -435,6 +521,117 @@ GLXWindow __opengl_glXCreateWindow(Display *dpy, GLXFBConfig config, Window win,
 	return retWin;
 }
 
+__PUBLIC void glReadBuffer(GLenum mode)
+{
+	__opengl_glReadBuffer(mode);
+}
+
+void __opengl_glReadBuffer(GLenum mode)
+{
+	INIT_GLC
+
+	opengl.glReadBuffer(mode);
+	if (likely(opengl.gl_capture))
+		gl_capture_track_read_buffer(opengl.gl_capture, mode);
+}
+
+static void opengl_track_framebuffer(GLenum target, GLuint framebuffer)
+{
+	if (likely(opengl.gl_capture) &&
+	    ((target == GL_FRAMEBUFFER) || (target == GL_READ_FRAMEBUFFER)))
+		gl_capture_track_read_framebuffer(opengl.gl_capture, framebuffer);
+}
+
+__PUBLIC void glBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	__opengl_glBindFramebuffer(target, framebuffer);
+}
+
+void __opengl_glBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	INIT_GLC
+
+	if (unlikely(!opengl.glBindFramebuffer)) {
+		glc_log(opengl.glc, GLC_ERROR, "opengl",
+			"glBindFramebuffer() not supported");
+		return;
+	}
+
+	opengl.glBindFramebuffer(target, framebuffer);
+	opengl_track_framebuffer(target, framebuffer);
+}
+
+__PUBLIC void glBindFramebufferEXT(GLenum target, GLuint framebuffer)
+{
+	__opengl_glBindFramebufferEXT(target, framebuffer);
+}
+
+void __opengl_glBindFramebufferEXT(GLenum target, GLuint framebuffer)
+{
+	INIT_GLC
+
+	if (unlikely(!opengl.glBindFramebufferEXT)) {
+		glc_log(opengl.glc, GLC_ERROR, "opengl",
+			"glBindFramebufferEXT() not supported");
+		return;
+	}
+
+	opengl.glBindFramebufferEXT(target, framebuffer);
+	opengl_track_framebuffer(target, framebuffer);
+}
+
+__PUBLIC Bool glXMakeCurrent(Display *dpy, GLXDrawable drawable, GLXContext ctx)
+{
+	return __opengl_glXMakeCurrent(dpy, drawable, ctx);
+}
+
+Bool __opengl_glXMakeCurrent(Display *dpy, GLXDrawable drawable, GLXContext ctx)
+{
+	INIT_GLC
+
+	Bool ret = opengl.glXMakeCurrent(dpy, drawable, ctx);
+	if (likely(ret && opengl.gl_capture))
+		gl_capture_track_context(opengl.gl_capture, ctx);
+	return ret;
+}
+
+__PUBLIC Bool glXMakeContextCurrent(Display *dpy, GLXDrawable draw,
+				    GLXDrawable read, GLXContext ctx)
+{
+	return __opengl_glXMakeContextCurrent(dpy, draw, read, ctx);
+}
+
+Bool __opengl_glXMakeContextCurrent(Display *dpy, GLXDrawable draw,
+				    GLXDrawable read, GLXContext ctx)
+{
+	INIT_GLC
+
+	if (unlikely(!opengl.glXMakeContextCurrent)) {
+		glc_log(opengl.glc, GLC_ERROR, "opengl",
+			"glXMakeContextCurrent() not supported");
+		return False;
+	}
+
+	Bool ret = opengl.glXMakeContextCurrent(dpy, draw, read, ctx);
+	if (likely(ret && opengl.gl_capture))
+		gl_capture_track_context(opengl.gl_capture, ctx);
+	return ret;
+}
+
+__PUBLIC void glXDestroyContext(Display *dpy, GLXContext ctx)
+{
+	__opengl_glXDestroyContext(dpy, ctx);
+}
+
+void __opengl_glXDestroyContext(Display *dpy, GLXContext ctx)
+{
+	INIT_GLC
+
+	if (likely(opengl.gl_capture))
+		gl_capture_track_destroy_context(opengl.gl_capture, ctx);
+	opengl.glXDestroyContext(dpy, ctx);
+}
+
 void opengl_capture_current()
 {
 	INIT_GLC
@@ -0,0 +1,204 @@
+/**
+ * \file hook/stats.c
+ * \brief live statistics over a UNIX socket
+ * \author Olivier Langlois <olivier@trillion01.com>
+ * \date 2014
+
+    Copyright 2014 Olivier Langlois
+
+    This file is part of glcs.
+
+    glcs is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    glcs is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with glcs.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+/**
+ * \addtogroup hook
+ *  \{
+ * \defgroup stats live statistics
+ *  \{
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <glc/common/glc.h>
+#include <glc/common/core.h>
+#include <glc/common/log.h>
+#include <glc/common/state.h>
+#include <glc/common/thread.h>
+#include <glc/common/util.h>
+
+#include "lib.h"
+
+/* video streams reported per snapshot */
+#define STATS_MAX_VIDEO 16
+
+struct stats_private_s {
+	glc_t *glc;
+	glc_simple_thread_t thread;
+	char *path;
+	int fd;
+};
+
+__PRIVATE struct stats_private_s stats = { .fd = -1 };
+
+__PRIVATE void *stats_thread(void *argptr);
+__PRIVATE void stats_write(FILE *stream);
+
+int stats_init(glc_t *glc)
+{
+	struct sockaddr_un addr;
+	char *env_val;
+	int ret;
+
+	stats.glc = glc;
+
+	if (!(env_val = getenv("GLC_STATS_SOCKET")))
+		return 0;
+
+	stats.path = glc_util_format_filename(env_val, 0);
+	if (unlikely(strlen(stats.path) >= sizeof(addr.sun_path))) {
+		ret = ENAMETOOLONG;
+		goto err;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, stats.path);
+
+	/* the pipe sink forks, don't leak the socket to its child */
+	if (unlikely((stats.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)) {
+		ret = errno;
+		goto err;
+	}
+
+	unlink(stats.path); /* left over by a process that crashed */
+	if (unlikely(bind(stats.fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) ||
+	    unlikely(listen(stats.fd, 4) < 0)) {
+		ret = errno;
+		goto err;
+	}
+
+	stats.thread.name = "stats";
+	if (unlikely((ret = glc_simple_thread_create(stats.glc, &stats.thread,
+						     stats_thread, NULL)))) {
+		unlink(stats.path);
+		goto err;
+	}
+
+	glc_log(stats.glc, GLC_INFO, "stats", "serving statistics on %s", stats.path);
+	return 0;
+err:
+	glc_log(stats.glc, GLC_ERROR, "stats", "can't serve statistics on %s: %s (%d)",
+		stats.path, strerror(ret), ret);
+	if (stats.fd >= 0)
+		close(stats.fd);
+	stats.fd = -1;
+	free(stats.path);
+	stats.path = NULL;
+	return ret;
+}
+
+int stats_close()
+{
+	if (stats.fd < 0)
+		return 0;
+
+	/* wakes up accept() */
+	shutdown(stats.fd, SHUT_RDWR);
+	glc_simple_thread_wait(stats.glc, &stats.thread);
+
+	close(stats.fd);
+	stats.fd = -1;
+	unlink(stats.path);
+	free(stats.path);
+	stats.path = NULL;
+	return 0;
+}
+
+/*
+ * Every connection gets one snapshot, then the socket is closed.
+ */
+void *stats_thread(void *argptr)
+{
+	FILE *stream;
+	int client;
+
+	while (stats.thread.running) {
+		if (unlikely((client = accept4(stats.fd, NULL, NULL, SOCK_CLOEXEC)) < 0)) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			break;
+		}
+
+		if (unlikely(!(stream = fdopen(client, "w")))) {
+			close(client);
+			continue;
+		}
+		stats_write(stream);
+		fclose(stream);
+	}
+
+	return NULL;
+}
+
+void stats_write(FILE *stream)
+{
+	gl_capture_stats_t video[STATS_MAX_VIDEO];
+	glc_size_t unpack_size, pack_size, written;
+	glc_utime_t time = glc_state_time(stats.glc);
+	size_t count = STATS_MAX_VIDEO, i;
+	int capturing, ret;
+
+	fprintf(stream, "{\"pid\":%d,\"time\":%.3f", getpid(), time / 1000000000.0);
+
+	opengl_get_stats(video, &count);
+	if (count > STATS_MAX_VIDEO)
+		count = STATS_MAX_VIDEO;
+	fprintf(stream, ",\"video\":[");
+	for (i = 0; i < count; i++)
+		fprintf(stream, "%s{\"id\":%d,\"width\":%u,\"height\":%u,"
+			"\"frames\":%u,\"captured\":%u,\"repeated\":%u,"
+			"\"dropped\":%u,\"fps\":%.2f}",
+			i ? "," : "", video[i].id, video[i].w, video[i].h,
+			video[i].frames, video[i].captured, video[i].repeated,
+			video[i].dropped, video[i].fps);
+	fprintf(stream, "]");
+
+	ret = get_capture_stats(&capturing, &unpack_size, &pack_size, &written);
+	fprintf(stream, ",\"capturing\":%s", capturing ? "true" : "false");
+
+	if (ret == ENOENT)
+		goto out; /* nothing was captured yet */
+
+	if (pack_size)
+		fprintf(stream, ",\"pack\":{\"in\":%" PRIu64 ",\"out\":%" PRIu64
+			",\"ratio\":%.3f}", unpack_size, pack_size,
+			(double) unpack_size / pack_size);
+
+	fprintf(stream, ",\"sink\":{\"written\":%" PRIu64 ",\"throughput\":%.0f}",
+		written, time ? written * 1000000000.0 / time : 0.0);
+out:
+	fprintf(stream, "}\n");
+}
+
+/**  \} */
+/**  \} */
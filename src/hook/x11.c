@@ -192,6 +192,10 @@ void x11_event(Display *dpy, XEvent *event)
 		}
 
 		x11.last_event_time = event->xkey.time;
+	} else if (event->type == ConfigureNotify) {
+		/* saves gl_capture from querying the size on every frame */
+		opengl_resize_window(dpy, event->xconfigure.window,
+				     event->xconfigure.width, event->xconfigure.height);
 	}
 }
 
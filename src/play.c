@@ -35,12 +35,13 @@
 #include <glc/common/log.h>
 #include <glc/common/util.h>
 #include <glc/common/state.h>
+#include <glc/common/trace.h>
 #include <glc/common/optimization.h>
 
 #include <glc/core/file.h>
 #include <glc/core/pack.h>
-#include <glc/core/rgb.h>
 #include <glc/core/color.h>
+#include <glc/core/convert.h>
 #include <glc/core/info.h>
 #include <glc/core/ycbcr.h>
 #include <glc/core/scale.h>
@@ -91,6 +92,8 @@ struct play_s {
 
 	int log_level;
 	int allow_rt;
+	long int slice_threads;
+	const char *trace_file;
 };
 
 int show_info_value(struct play_s *play, const char *value);
@@ -127,6 +130,8 @@ int main(int argc, char *argv[])
 		{"help",		0, NULL, 'h'},
 		{"version",		0, NULL, 'V'},
 		{"rtprio",		0, NULL, 'P'},
+		{"slice-threads",	1, NULL, 'S'},
+		{"trace",		1, NULL, 'T'},
 		{0, 0, 0, 0}
 	};
 	memset(&play, 0, sizeof(struct play_s));
@@ -145,6 +150,9 @@ int main(int argc, char *argv[])
 	play.buffer_size_arr[COMPRESSED_IDX] = 10 * 1024 * 1024;
 	play.buffer_size_arr[UNCOMPRESSED_IDX] = 10 * 1024 * 1024;
 
+	/* one thread per frame */
+	play.slice_threads = 1;
+
 	/* log to stderr */
 	play.log_level  = 0;
 	play.info_level = 1;
@@ -161,7 +169,7 @@ int main(int argc, char *argv[])
 	play.green_gamma = 1.0;
 	play.blue_gamma  = 1.0;
 
-	while ((opt = getopt_long(argc, argv, "i:a:b:p:y:o:f:r:g:l:td:c:u:s:v:hVP",
+	while ((opt = getopt_long(argc, argv, "i:a:b:p:y:o:f:r:g:l:td:c:u:s:v:S:T:hVP",
 				  long_options, &optind)) != -1) {
 		switch (opt) {
 		case 'i':
@@ -254,6 +262,14 @@ int main(int argc, char *argv[])
 		case 'P':
 			play.allow_rt = 1;
 			break;
+		case 'S':
+			play.slice_threads = atol(optarg);
+			if (play.slice_threads < 1)
+				goto usage;
+			break;
+		case 'T':
+			play.trace_file = optarg;
+			break;
 		case 'h':
 		default:
 			goto usage;
@@ -277,7 +293,10 @@ int main(int argc, char *argv[])
 	glc_state_init(&play.glc);
 	glc_log_set_level(&play.glc, play.log_level);
 	glc_set_allow_rt(&play.glc, play.allow_rt);
+	glc_set_slice_threads(&play.glc, play.slice_threads);
 	glc_util_log_version(&play.glc);
+	if (play.trace_file && unlikely(glc_trace_open(&play.glc, play.trace_file)))
+		return EXIT_FAILURE;
 
 	/* open stream file */
 	if (unlikely(file_source_init(&play.file, &play.glc)))
@@ -364,6 +383,9 @@ usage:
 	       "                             all, signature, version, flags, fps,\n"
 	       "                             pid, name, date\n"
 	       "  -P, --rtprio             use rt priority for alsa threads\n"
+	       "  -S, --slice-threads=NUM  split the rows of each frame across NUM\n"
+	       "                             threads when converting, default is 1\n"
+	       "  -T, --trace=FILE         write a Chrome trace of every frame to FILE\n"
 	       "  -v, --verbosity=LEVEL    verbosity level\n"
 	       "  -h, --help               show help\n");
 
@@ -429,11 +451,11 @@ static void destroy_buffers(ps_buffer_t *buffer_arr, unsigned nm)
 
 #define compressed_buffer   buffer_arr[0]
 #define uncompressed_buffer buffer_arr[1]
-#define rgb_buffer          buffer_arr[2]
+#define convert_buffer      buffer_arr[2]
 #define ycbcr_buffer        buffer_arr[2]
 #define color_buffer        buffer_arr[3]
 #define scale_buffer        buffer_arr[4]
-#define vfilter_in_buffer   buffer_arr[5]
+#define vfilter_in_buffer   buffer_arr[3]
 
 /*
  * Undef to use the video filter.
@@ -448,9 +470,8 @@ int play_stream(struct play_s *play)
 
 	 file -(uncompressed)->     reads data from stream file
 	 unpack -(uncompressed)->   decompresses lzo/quicklz packets
-	 rgb -(rgb)->               does conversion to BGR
-	 scale -(scale)->           does rescaling
-	 color -(color)->           applies color correction
+	 convert -(convert)->       does conversion to BGR, rescaling and
+	                            color correction in a single pass
 	 demux -(...)-> gl_play, alsa_play
 
 	 Each filter, except demux and file, has glc_threads_hint(glc) worker
@@ -458,40 +479,34 @@ int play_stream(struct play_s *play)
 	 separate buffer and _play handler for each video/audio stream.
 	*/
 #ifndef USE_VFILTER
-	ps_buffer_t buffer_arr[5];
-	unsigned nm_arr[BUFFER_SIZE_ARR_SZ] = {1, 4};
+	ps_buffer_t buffer_arr[3];
+	unsigned nm_arr[BUFFER_SIZE_ARR_SZ] = {1, 2};
 #else
-	ps_buffer_t buffer_arr[6];
-	unsigned nm_arr[BUFFER_SIZE_ARR_SZ] = {1, 5};
+	ps_buffer_t buffer_arr[4];
+	unsigned nm_arr[BUFFER_SIZE_ARR_SZ] = {1, 3};
 #endif
 	demux_t demux;
-	color_t color;
-	scale_t scale;
+	convert_t convert;
 	unpack_t unpack;
-	rgb_t rgb;
 	int ret = 0;
 
 	if (unlikely((ret = init_buffers(buffer_arr, play->buffer_size_arr, nm_arr))))
 		goto err;
 
 	/* init filters */
-	glc_account_threads(&play->glc,4,4);
+	glc_account_threads(&play->glc,4,2);
 	glc_compute_threads_hint(&play->glc);
 	if (unlikely((ret = unpack_init(&unpack, &play->glc))))
 		goto err;
-	if (unlikely((ret = rgb_init(&rgb, &play->glc))))
-		goto err;
-	if (unlikely((ret = scale_init(&scale, &play->glc))))
+	if (unlikely((ret = convert_init(&convert, &play->glc))))
 		goto err;
 	if (play->scale_width && play->scale_height)
-		scale_set_size(scale, play->scale_width, play->scale_height);
+		convert_set_size(convert, play->scale_width, play->scale_height);
 	else
-		scale_set_scale(scale, play->scale_factor);
-	if (unlikely((ret = color_init(&color, &play->glc))))
-		goto err;
+		convert_set_scale(convert, play->scale_factor);
 	if (play->override_color_correction)
-		color_override(color, play->brightness, play->contrast,
-			       play->red_gamma, play->green_gamma, play->blue_gamma);
+		convert_override(convert, play->brightness, play->contrast,
+				 play->red_gamma, play->green_gamma, play->blue_gamma);
 	if (unlikely((ret = demux_init(&demux, &play->glc))))
 		goto err;
 	demux_set_video_buffer_size(demux, play->buffer_size_arr[UNCOMPRESSED_IDX]);
@@ -500,13 +515,15 @@ int play_stream(struct play_s *play)
 
 	/* construct a pipeline for playback */
 #ifndef USE_VFILTER
-	if (unlikely((ret = rgb_process_start(rgb, &uncompressed_buffer, &rgb_buffer))))
+	if (unlikely((ret = convert_process_start(convert, &uncompressed_buffer,
+						  &convert_buffer))))
 		goto err;
-	if (unlikely((ret = demux_process_start(demux, &color_buffer))))
+	if (unlikely((ret = demux_process_start(demux, &convert_buffer))))
 		goto err;
 #else
-	demux_insert_video_filter(demux, &vfilter_in_buffer, &color_buffer);
-	if (unlikely((ret = rgb_process_start(rgb, &vfilter_in_buffer, &rgb_buffer))))
+	demux_insert_video_filter(demux, &vfilter_in_buffer, &convert_buffer);
+	if (unlikely((ret = convert_process_start(convert, &vfilter_in_buffer,
+						  &convert_buffer))))
 		goto err;
 	if (unlikely((ret = demux_process_start(demux, &uncompressed_buffer))))
 		goto err;
@@ -514,10 +531,6 @@ int play_stream(struct play_s *play)
 	if (unlikely((ret = unpack_process_start(unpack, &compressed_buffer,
 						&uncompressed_buffer))))
 		goto err;
-	if (unlikely((ret = scale_process_start(scale, &rgb_buffer, &scale_buffer))))
-		goto err;
-	if (unlikely((ret = color_process_start(color, &scale_buffer, &color_buffer))))
-		goto err;
 
 	/* the pipeline is ready - lets give it some data */
 	if (unlikely((ret = play->file->ops->read(play->file, &compressed_buffer))))
@@ -526,20 +539,14 @@ int play_stream(struct play_s *play)
 	/* we've done our part - just wait for the threads */
 	if (unlikely((ret = demux_process_wait(demux))))
 		goto err; /* wait for demux, since when it quits, others should also */
-	if (unlikely((ret = color_process_wait(color))))
-		goto err;
-	if (unlikely((ret = scale_process_wait(scale))))
-		goto err;
-	if (unlikely((ret = rgb_process_wait(rgb))))
+	if (unlikely((ret = convert_process_wait(convert))))
 		goto err;
 	if (unlikely((ret = unpack_process_wait(unpack))))
 		goto err;
 
 	/* stream processed - clean up time */
 	unpack_destroy(unpack);
-	rgb_destroy(rgb);
-	scale_destroy(scale);
-	color_destroy(color);
+	convert_destroy(convert);
 	demux_destroy(demux);
 
 	destroy_buffers(buffer_arr,sizeof(buffer_arr)/sizeof(ps_buffer_t));
@@ -619,42 +626,35 @@ int export_img(struct play_s *play)
 
 	 file -(uncompressed_buffer)->     reads data from stream file
 	 unpack -(uncompressed_buffer)->   decompresses lzo/quicklz packets
-	 rgb -(rgb)->               does conversion to BGR
-	 scale -(scale)->           does rescaling
-	 color -(color)->           applies color correction
+	 convert -(convert)->       does conversion to BGR, rescaling and
+	                            color correction in a single pass
 	 img                        writes separate image files for each frame
 	*/
 
-	ps_buffer_t buffer_arr[5];
-	unsigned nm_arr[BUFFER_SIZE_ARR_SZ] = {1, 4};
+	ps_buffer_t buffer_arr[3];
+	unsigned nm_arr[BUFFER_SIZE_ARR_SZ] = {1, 2};
 	img_t img;
-	color_t color;
-	scale_t scale;
+	convert_t convert;
 	unpack_t unpack;
-	rgb_t rgb;
 	int ret = 0;
 
 	if (unlikely((ret = init_buffers(buffer_arr, play->buffer_size_arr, nm_arr))))
 		goto err;
 
 	/* filters */
-	glc_account_threads(&play->glc,2,4);
+	glc_account_threads(&play->glc,2,2);
 	glc_compute_threads_hint(&play->glc);
 	if (unlikely((ret = unpack_init(&unpack, &play->glc))))
 		goto err;
-	if (unlikely((ret = rgb_init(&rgb, &play->glc))))
-		goto err;
-	if (unlikely((ret = scale_init(&scale, &play->glc))))
+	if (unlikely((ret = convert_init(&convert, &play->glc))))
 		goto err;
 	if (play->scale_width && play->scale_height)
-		scale_set_size(scale, play->scale_width, play->scale_height);
+		convert_set_size(convert, play->scale_width, play->scale_height);
 	else
-		scale_set_scale(scale, play->scale_factor);
-	if (unlikely((ret = color_init(&color, &play->glc))))
-		goto err;
+		convert_set_scale(convert, play->scale_factor);
 	if (play->override_color_correction)
-		color_override(color, play->brightness, play->contrast,
-			       play->red_gamma, play->green_gamma, play->blue_gamma);
+		convert_override(convert, play->brightness, play->contrast,
+				 play->red_gamma, play->green_gamma, play->blue_gamma);
 	if (unlikely((ret = img_init(&img, &play->glc))))
 		goto err;
 	img_set_filename(img, play->export_filename_format);
@@ -666,13 +666,10 @@ int export_img(struct play_s *play)
 	if (unlikely((ret = unpack_process_start(unpack, &compressed_buffer,
 						&uncompressed_buffer))))
 		goto err;
-	if (unlikely((ret = rgb_process_start(rgb, &uncompressed_buffer, &rgb_buffer))))
-		goto err;
-	if (unlikely((ret = scale_process_start(scale, &rgb_buffer, &scale_buffer))))
-		goto err;
-	if (unlikely((ret = color_process_start(color, &scale_buffer, &color_buffer))))
+	if (unlikely((ret = convert_process_start(convert, &uncompressed_buffer,
+						  &convert_buffer))))
 		goto err;
-	if (unlikely((ret = img_process_start(img, &color_buffer))))
+	if (unlikely((ret = img_process_start(img, &convert_buffer))))
 		goto err;
 
 	/* ok, read the file */
@@ -682,19 +679,13 @@ int export_img(struct play_s *play)
 	/* wait 'till its done and clean up the mess... */
 	if (unlikely((ret = img_process_wait(img))))
 		goto err;
-	if (unlikely((ret = color_process_wait(color))))
-		goto err;
-	if (unlikely((ret = scale_process_wait(scale))))
-		goto err;
-	if (unlikely((ret = rgb_process_wait(rgb))))
+	if (unlikely((ret = convert_process_wait(convert))))
 		goto err;
 	if (unlikely((ret = unpack_process_wait(unpack))))
 		goto err;
 
 	unpack_destroy(unpack);
-	rgb_destroy(rgb);
-	scale_destroy(scale);
-	color_destroy(color);
+	convert_destroy(convert);
 	img_destroy(img);
 
 	destroy_buffers(buffer_arr,sizeof(buffer_arr)/sizeof(ps_buffer_t));
@@ -712,14 +703,21 @@ int export_yuv4mpeg(struct play_s *play)
 
 	 file -(uncompressed_buffer)->     reads data from stream file
 	 unpack -(uncompressed_buffer)->   decompresses lzo/quicklz packets
-	 scale -(scale)->           does rescaling
+	 scale -(scale)->           does rescaling (if necessary)
 	 color -(color)->           applies color correction
 	 ycbcr -(ycbcr)->           does conversion to Y'CbCr (if necessary)
 	 yuv4mpeg                   writes yuv4mpeg stream
+
+	 Without resizing, scale would only turn BGRA into BGR, which
+	 color and ycbcr read just as well, so it is left out rather
+	 than copying every packet once more.
 	*/
 
 	ps_buffer_t buffer_arr[5];
-	unsigned nm_arr[BUFFER_SIZE_ARR_SZ] = {1, 4};
+	unsigned nm_arr[BUFFER_SIZE_ARR_SZ] = {1, 3};
+	ps_buffer_t *color_in = &uncompressed_buffer;
+	int use_scale = (play->scale_width && play->scale_height) ||
+			(play->scale_factor != 1);
 	yuv4mpeg_t yuv4mpeg;
 	ycbcr_t ycbcr;
 	scale_t scale;
@@ -727,22 +725,26 @@ int export_yuv4mpeg(struct play_s *play)
 	color_t color;
 	int ret = 0;
 
+	if (use_scale)
+		nm_arr[UNCOMPRESSED_IDX]++;
 	if (unlikely((ret = init_buffers(buffer_arr, play->buffer_size_arr, nm_arr))))
 		goto err;
 
 	/* initialize filters */
-	glc_account_threads(&play->glc,2,4);
+	glc_account_threads(&play->glc,2,use_scale ? 4 : 3);
 	glc_compute_threads_hint(&play->glc);
 	if (unlikely((ret = unpack_init(&unpack, &play->glc))))
 		goto err;
 	if (unlikely((ret = ycbcr_init(&ycbcr, &play->glc))))
 		goto err;
-	if (unlikely((ret = scale_init(&scale, &play->glc))))
-		goto err;
-	if (play->scale_width && play->scale_height)
-		scale_set_size(scale, play->scale_width, play->scale_height);
-	else
-		scale_set_scale(scale, play->scale_factor);
+	if (use_scale) {
+		if (unlikely((ret = scale_init(&scale, &play->glc))))
+			goto err;
+		if (play->scale_width && play->scale_height)
+			scale_set_size(scale, play->scale_width, play->scale_height);
+		else
+			scale_set_scale(scale, play->scale_factor);
+	}
 	if (unlikely((ret = color_init(&color, &play->glc))))
 		goto err;
 	if (play->override_color_correction)
@@ -759,10 +761,13 @@ int export_yuv4mpeg(struct play_s *play)
 	if (unlikely((ret = unpack_process_start(unpack, &compressed_buffer,
 						&uncompressed_buffer))))
 		goto err;
-	if (unlikely((ret = scale_process_start(scale, &uncompressed_buffer,
-						&scale_buffer))))
-		goto err;
-	if (unlikely((ret = color_process_start(color, &scale_buffer, &color_buffer))))
+	if (use_scale) {
+		if (unlikely((ret = scale_process_start(scale, &uncompressed_buffer,
+							&scale_buffer))))
+			goto err;
+		color_in = &scale_buffer;
+	}
+	if (unlikely((ret = color_process_start(color, color_in, &color_buffer))))
 		goto err;
 	if (unlikely((ret = ycbcr_process_start(ycbcr, &color_buffer, &ycbcr_buffer))))
 		goto err;
@@ -778,7 +783,7 @@ int export_yuv4mpeg(struct play_s *play)
 		goto err;
 	if (unlikely((ret = color_process_wait(color))))
 		goto err;
-	if (unlikely((ret = scale_process_wait(scale))))
+	if ((use_scale) && (unlikely((ret = scale_process_wait(scale)))))
 		goto err;
 	if (unlikely((ret = ycbcr_process_wait(ycbcr))))
 		goto err;
@@ -787,11 +792,12 @@ int export_yuv4mpeg(struct play_s *play)
 
 	unpack_destroy(unpack);
 	ycbcr_destroy(ycbcr);
-	scale_destroy(scale);
+	if (use_scale)
+		scale_destroy(scale);
 	color_destroy(color);
 	yuv4mpeg_destroy(yuv4mpeg);
 
-	destroy_buffers(buffer_arr,sizeof(buffer_arr)/sizeof(ps_buffer_t));
+	destroy_buffers(buffer_arr, nm_arr[0] + nm_arr[UNCOMPRESSED_IDX]);
 
 	return 0;
 err:
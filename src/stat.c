@@ -0,0 +1,151 @@
+/**
+ * \file stat.c
+ * \brief polls the statistics socket of a capturing process
+ * \author Olivier Langlois <olivier@trillion01.com>
+ * \date 2014
+
+    Copyright 2014 Olivier Langlois
+
+    This file is part of glcs.
+
+    glcs is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    glcs is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with glcs.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+int poll_stats(const char *path);
+int usage(const char *prog);
+
+int main(int argc, char *argv[])
+{
+	struct timespec interval = {0, 0};
+	double sec;
+	long count = -1;
+	int opt, ret;
+
+	struct option long_options[] = {
+		{"interval",		1, NULL, 'i'},
+		{"count",		1, NULL, 'n'},
+		{"help",		0, NULL, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	while ((opt = getopt_long(argc, argv, "i:n:h", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'i':
+			sec = atof(optarg);
+			if (sec <= 0)
+				goto usage;
+			interval.tv_sec  = (time_t) sec;
+			interval.tv_nsec = (long) ((sec - interval.tv_sec) * 1000000000.0);
+			break;
+		case 'n':
+			count = atol(optarg);
+			if (count < 1)
+				goto usage;
+			break;
+		case 'h':
+		default:
+			goto usage;
+		}
+	}
+
+	if (optind != argc - 1)
+		goto usage;
+
+	/* one snapshot, or until interrupted when polling */
+	if (count < 0)
+		count = (interval.tv_sec || interval.tv_nsec) ? 0 : 1;
+
+	for (;;) {
+		if ((ret = poll_stats(argv[optind])))
+			return EXIT_FAILURE;
+		if ((count) && (!--count))
+			break;
+		nanosleep(&interval, NULL);
+	}
+
+	return EXIT_SUCCESS;
+
+usage:
+	return usage(argv[0]);
+}
+
+/*
+ * The server writes one JSON snapshot per connection and closes it.
+ */
+int poll_stats(const char *path)
+{
+	struct sockaddr_un addr;
+	char buf[4096];
+	ssize_t len;
+	int fd, ret = 0;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "%s: path too long\n", path);
+		return ENAMETOOLONG;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		ret = errno;
+		fprintf(stderr, "socket: %s (%d)\n", strerror(ret), ret);
+		return ret;
+	}
+
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		ret = errno;
+		fprintf(stderr, "%s: %s (%d)\n", path, strerror(ret), ret);
+		goto out;
+	}
+
+	while ((len = read(fd, buf, sizeof(buf))) != 0) {
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = errno;
+			fprintf(stderr, "%s: %s (%d)\n", path, strerror(ret), ret);
+			break;
+		}
+		fwrite(buf, 1, len, stdout);
+	}
+	fflush(stdout);
+out:
+	close(fd);
+	return ret;
+}
+
+int usage(const char *prog)
+{
+	printf("%s [options] socket\n", prog);
+	printf("print statistics of a process capturing with GLC_STATS_SOCKET set,\n"
+	       "one JSON object per line\n"
+	       "  -i, --interval=SEC    poll every SEC seconds until interrupted\n"
+	       "  -n, --count=NUM       stop after NUM snapshots, default is 1\n"
+	       "                          or unlimited with --interval\n"
+	       "  -h, --help            show this help\n");
+	return EXIT_FAILURE;
+}